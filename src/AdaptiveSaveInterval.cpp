@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "AdaptiveSaveInterval.h"
+#include <algorithm>
+
+// The weight of the newest sample in the moving average, a higher value
+// responds faster to a city that is growing.
+static constexpr double SampleWeight = 0.3;
+
+AdaptiveSaveInterval::AdaptiveSaveInterval()
+	: stallBudget(0.02),
+	  minimumInterval(0),
+	  maximumInterval(INT64_MAX),
+	  averageSaveMilliseconds(0),
+	  hasSamples(false)
+{
+}
+
+void AdaptiveSaveInterval::Configure(
+	double stallBudgetPercent,
+	int64_t minimumIntervalMilliseconds,
+	int64_t maximumIntervalMilliseconds)
+{
+	stallBudget = std::clamp(stallBudgetPercent / 100.0, 0.001, 0.5);
+	minimumInterval = minimumIntervalMilliseconds;
+	maximumInterval = std::max(minimumIntervalMilliseconds, maximumIntervalMilliseconds);
+}
+
+void AdaptiveSaveInterval::Reset()
+{
+	averageSaveMilliseconds = 0;
+	hasSamples = false;
+}
+
+bool AdaptiveSaveInterval::HasSamples() const
+{
+	return hasSamples;
+}
+
+void AdaptiveSaveInterval::AddSample(int64_t saveMilliseconds)
+{
+	const double sample = static_cast<double>(std::max<int64_t>(saveMilliseconds, 0));
+
+	if (hasSamples)
+	{
+		averageSaveMilliseconds += SampleWeight * (sample - averageSaveMilliseconds);
+	}
+	else
+	{
+		averageSaveMilliseconds = sample;
+		hasSamples = true;
+	}
+}
+
+int64_t AdaptiveSaveInterval::GetEstimatedSaveMilliseconds() const
+{
+	return static_cast<int64_t>(averageSaveMilliseconds + 0.5);
+}
+
+int64_t AdaptiveSaveInterval::GetIntervalMilliseconds(int64_t defaultIntervalMilliseconds) const
+{
+	if (!hasSamples)
+	{
+		return std::clamp(defaultIntervalMilliseconds, minimumInterval, maximumInterval);
+	}
+
+	// The fraction of the play time used by saving is save / (interval + save),
+	// keeping that at or below the budget gives interval >= save * (1 - budget) / budget.
+	const double interval = averageSaveMilliseconds * (1.0 - stallBudget) / stallBudget;
+
+	const int64_t intervalMilliseconds = static_cast<int64_t>(std::min(interval, static_cast<double>(maximumInterval)));
+
+	return std::clamp(intervalMilliseconds, minimumInterval, maximumInterval);
+}
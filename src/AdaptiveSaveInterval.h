@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+
+// Derives the auto-save interval from a stall budget.
+//
+// The game cannot be played while it is saving, the stall budget is the largest
+// percentage of the play time that auto-saving is allowed to use. The interval is
+// computed from a moving average of the measured save times so that a city that
+// takes longer to save is saved less often, and it is bounded by a minimum and
+// maximum interval.
+class AdaptiveSaveInterval
+{
+public:
+
+	AdaptiveSaveInterval();
+
+	void Configure(
+		double stallBudgetPercent,
+		int64_t minimumIntervalMilliseconds,
+		int64_t maximumIntervalMilliseconds);
+
+	// Discards the save time samples, this is called when a different city is saved.
+	void Reset();
+
+	bool HasSamples() const;
+
+	void AddSample(int64_t saveMilliseconds);
+
+	// Gets the average save time.
+	int64_t GetEstimatedSaveMilliseconds() const;
+
+	// Gets the interval for the current save time estimate, or the specified
+	// default interval if there are no samples.
+	int64_t GetIntervalMilliseconds(int64_t defaultIntervalMilliseconds) const;
+
+private:
+
+	double stallBudget;
+	int64_t minimumInterval;
+	int64_t maximumInterval;
+	double averageSaveMilliseconds;
+	bool hasSamples;
+};
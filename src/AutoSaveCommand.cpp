@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "AutoSaveCommand.h"
+#include <charconv>
+#include <vector>
+
+namespace
+{
+	bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			char x = a[i];
+			char y = b[i];
+
+			if (x >= 'A' && x <= 'Z')
+			{
+				x = static_cast<char>(x - 'A' + 'a');
+			}
+
+			if (y >= 'A' && y <= 'Z')
+			{
+				y = static_cast<char>(y - 'A' + 'a');
+			}
+
+			if (x != y)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::vector<std::string_view> SplitWords(std::string_view text)
+	{
+		std::vector<std::string_view> words;
+
+		size_t start = 0;
+
+		while (start < text.size())
+		{
+			while (start < text.size() && (text[start] == ' ' || text[start] == '\t'))
+			{
+				start++;
+			}
+
+			size_t end = start;
+
+			while (end < text.size() && text[end] != ' ' && text[end] != '\t')
+			{
+				end++;
+			}
+
+			if (end > start)
+			{
+				words.push_back(text.substr(start, end - start));
+			}
+
+			start = end;
+		}
+
+		return words;
+	}
+}
+
+bool AutoSaveCommandParser::Parse(std::string_view cheatString, AutoSaveCommand& command, std::string& error)
+{
+	command = AutoSaveCommand{ AutoSaveCommandType::Help, 0 };
+	error.clear();
+
+	std::vector<std::string_view> words = SplitWords(cheatString);
+
+	// The first word is the cheat name.
+	if (words.empty() || !EqualsIgnoreCase(words[0], CheatName))
+	{
+		error = "The command does not start with AutoSave.";
+		return false;
+	}
+
+	if (words.size() == 1 || EqualsIgnoreCase(words[1], "help"))
+	{
+		return true;
+	}
+
+	const std::string_view name = words[1];
+	const size_t argumentCount = words.size() - 2;
+
+	if (EqualsIgnoreCase(name, "interval"))
+	{
+		int value = 0;
+
+		if (argumentCount != 1)
+		{
+			error = "The interval command requires the number of minutes.";
+			return false;
+		}
+
+		const std::string_view argument = words[2];
+		const std::from_chars_result result = std::from_chars(argument.data(), argument.data() + argument.size(), value);
+
+		if (result.ec != std::errc() || result.ptr != argument.data() + argument.size())
+		{
+			error = "The interval must be a whole number of minutes.";
+			return false;
+		}
+
+		command.type = AutoSaveCommandType::Interval;
+		command.value = value;
+		return true;
+	}
+
+	if (argumentCount != 0)
+	{
+		error = "The ";
+		error.append(name);
+		error.append(" command does not have any arguments.");
+		return false;
+	}
+
+	if (EqualsIgnoreCase(name, "now"))
+	{
+		command.type = AutoSaveCommandType::SaveNow;
+	}
+	else if (EqualsIgnoreCase(name, "pause"))
+	{
+		command.type = AutoSaveCommandType::Pause;
+	}
+	else if (EqualsIgnoreCase(name, "resume"))
+	{
+		command.type = AutoSaveCommandType::Resume;
+	}
+	else if (EqualsIgnoreCase(name, "stats"))
+	{
+		command.type = AutoSaveCommandType::Stats;
+	}
+	else if (EqualsIgnoreCase(name, "history"))
+	{
+		command.type = AutoSaveCommandType::History;
+	}
+	else if (EqualsIgnoreCase(name, "restore"))
+	{
+		command.type = AutoSaveCommandType::Restore;
+	}
+	else
+	{
+		error = "Unknown command: ";
+		error.append(name);
+		return false;
+	}
+
+	return true;
+}
+
+const char* AutoSaveCommandParser::GetHelpText()
+{
+	return
+		"AutoSave now - Saves the city as soon as it can be saved.\n"
+		"AutoSave pause - Defers the auto-saves until AutoSave resume is used.\n"
+		"AutoSave resume - Resumes the auto-saves.\n"
+		"AutoSave stats - Shows the save metrics and the time until the next save.\n"
+		"AutoSave interval <minutes> - Changes the save interval until the game is restarted or the settings are reloaded.\n"
+		"AutoSave history - Shows the recent auto-saves of the current city from the backup catalog.\n"
+		"AutoSave restore - Rebuilds the newest deduplicated backup of the city as a save file in its backup folder.";
+}
@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+enum class AutoSaveCommandType
+{
+	Help,
+	// Saves the city as soon as it can be saved.
+	SaveNow,
+	// Defers the auto-saves until the resume command is used.
+	Pause,
+	Resume,
+	// Shows the save metrics and the time until the next save.
+	Stats,
+	// Changes the save interval for the current session, the value is in minutes.
+	Interval,
+	// Shows the recent auto-saves of the current city from the backup catalog.
+	History,
+	// Rebuilds the newest deduplicated backup of the current city as a save file in its backup folder.
+	Restore,
+};
+
+struct AutoSaveCommand
+{
+	AutoSaveCommandType type;
+	int value;
+};
+
+// Parses the commands that are entered in the game's cheat code box.
+//
+// The cheat string is the full text that was entered, e.g. "AutoSave interval 10".
+// The command names are not case sensitive. A cheat with no command shows the help text.
+class AutoSaveCommandParser
+{
+public:
+
+	// The cheat code that is registered with the game.
+	static constexpr std::string_view CheatName = "AutoSave";
+	static constexpr uint32_t CheatID = 0x6b2f8a41;
+
+	static bool Parse(std::string_view cheatString, AutoSaveCommand& command, std::string& error);
+
+	static const char* GetHelpText();
+};
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "BackgroundTaskQueue.h"
+#include "Logger.h"
+#include <Windows.h>
+
+BackgroundTaskQueue::BackgroundTaskQueue() : thread(), mutex(), condition(), tasks(), running(false)
+{
+}
+
+BackgroundTaskQueue::~BackgroundTaskQueue()
+{
+	Stop();
+}
+
+void BackgroundTaskQueue::Start()
+{
+	if (!thread.joinable())
+	{
+		thread = std::jthread([this](std::stop_token stopToken) { ThreadProc(stopToken); });
+
+		std::lock_guard<std::mutex> lock(mutex);
+		running = true;
+	}
+}
+
+void BackgroundTaskQueue::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+
+	if (thread.joinable())
+	{
+		thread.request_stop();
+		thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	tasks.clear();
+}
+
+bool BackgroundTaskQueue::IsRunning() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return running;
+}
+
+void BackgroundTaskQueue::QueueTask(Task&& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!running)
+		{
+			return;
+		}
+
+		tasks.push_back(std::move(task));
+	}
+	condition.notify_one();
+}
+
+void BackgroundTaskQueue::ThreadProc(std::stop_token stopToken)
+{
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+	while (!stopToken.stop_requested())
+	{
+		Task task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if (!condition.wait(lock, stopToken, [this] { return !tasks.empty(); }))
+			{
+				break;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		// An exception would terminate the game if it escaped from the thread.
+		try
+		{
+			task(stopToken);
+		}
+		catch (const std::exception& ex)
+		{
+			Logger::GetInstance().WriteLineFormatted(
+				LogLevel::Error,
+				"A background task failed: %s",
+				ex.what());
+		}
+	}
+}
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+// Runs the post-save tasks on a single background thread, in the order they were queued.
+class BackgroundTaskQueue
+{
+public:
+
+	typedef std::function<void(std::stop_token)> Task;
+
+	BackgroundTaskQueue();
+	~BackgroundTaskQueue();
+
+	void Start();
+
+	// Stops the background thread, the task that is currently running is asked to stop
+	// and the tasks that have not started are discarded.
+	void Stop();
+
+	bool IsRunning() const;
+
+	// Adds a task to the queue, this method does not wait for the task to start.
+	// It can be called from other threads, the task is discarded if the queue is not running.
+	void QueueTask(Task&& task);
+
+private:
+
+	void ThreadProc(std::stop_token stopToken);
+
+	std::jthread thread;
+	mutable std::mutex mutex;
+	std::condition_variable_any condition;
+	std::deque<Task> tasks;
+	// Guarded by mutex, the thread is only started and stopped by the thread that owns the queue.
+	bool running;
+};
+
@@ -0,0 +1,379 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "BackupCatalog.h"
+#include "zlib.h"
+#include <cstddef>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr uint32_t CatalogSignature = 0x54414341; // ACAT
+static constexpr uint32_t CatalogVersion = 1;
+static constexpr uint64_t RecordSize = sizeof(BackupCatalogRecord);
+
+namespace
+{
+	struct CatalogHeader
+	{
+		uint32_t signature;
+		uint32_t version;
+		uint32_t headerSize;
+		uint32_t recordSize;
+		// The number of records that have been committed, the file
+		// can contain a partially written record after the last one.
+		uint64_t recordCount;
+		uint8_t reserved[40];
+	};
+
+	static_assert(sizeof(CatalogHeader) == 64);
+
+	// A catalog or journal file that is opened for reading and writing.
+	class CatalogFile
+	{
+	public:
+
+		CatalogFile()
+			:
+#ifdef _WIN32
+			  handle(INVALID_HANDLE_VALUE)
+#else
+			  fileDescriptor(-1)
+#endif
+		{
+		}
+
+		~CatalogFile()
+		{
+#ifdef _WIN32
+			if (handle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(handle);
+			}
+#else
+			if (fileDescriptor >= 0)
+			{
+				close(fileDescriptor);
+			}
+#endif
+		}
+
+		CatalogFile(const CatalogFile&) = delete;
+		CatalogFile& operator=(const CatalogFile&) = delete;
+
+		// Opens the file, it is created if it does not exist.
+		bool Open(const std::filesystem::path& path)
+		{
+#ifdef _WIN32
+			handle = CreateFileW(
+				path.c_str(),
+				GENERIC_READ | GENERIC_WRITE,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				nullptr,
+				OPEN_ALWAYS,
+				FILE_ATTRIBUTE_NORMAL,
+				nullptr);
+
+			return handle != INVALID_HANDLE_VALUE;
+#else
+			fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+			return fileDescriptor >= 0;
+#endif
+		}
+
+		// Waits until the other processes have released the lock.
+		bool Lock()
+		{
+#ifdef _WIN32
+			// Byte range locks are mandatory on Windows, the lock is placed past the end
+			// of the file so that it does not prevent the file from being read.
+			OVERLAPPED overlapped{};
+			overlapped.OffsetHigh = 0x80000000;
+
+			return LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != FALSE;
+#else
+			return flock(fileDescriptor, LOCK_EX) == 0;
+#endif
+		}
+
+		uint64_t GetSize() const
+		{
+#ifdef _WIN32
+			LARGE_INTEGER size{};
+
+			return GetFileSizeEx(handle, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+#else
+			struct stat fileStatus {};
+
+			return fstat(fileDescriptor, &fileStatus) == 0 ? static_cast<uint64_t>(fileStatus.st_size) : 0;
+#endif
+		}
+
+		bool Read(uint64_t offset, void* data, size_t length)
+		{
+#ifdef _WIN32
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(offset & 0xffffffff);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+			DWORD bytesRead = 0;
+
+			return ReadFile(handle, data, static_cast<DWORD>(length), &bytesRead, &overlapped) && bytesRead == length;
+#else
+			return pread(fileDescriptor, data, length, static_cast<off_t>(offset)) == static_cast<ssize_t>(length);
+#endif
+		}
+
+		bool Write(uint64_t offset, const void* data, size_t length)
+		{
+#ifdef _WIN32
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(offset & 0xffffffff);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+			DWORD bytesWritten = 0;
+
+			return WriteFile(handle, data, static_cast<DWORD>(length), &bytesWritten, &overlapped) && bytesWritten == length;
+#else
+			return pwrite(fileDescriptor, data, length, static_cast<off_t>(offset)) == static_cast<ssize_t>(length);
+#endif
+		}
+
+		// Waits until the data that has been written is on the disk.
+		bool Flush()
+		{
+#ifdef _WIN32
+			return FlushFileBuffers(handle) != FALSE;
+#else
+			return fsync(fileDescriptor) == 0;
+#endif
+		}
+
+		bool Truncate(uint64_t size)
+		{
+#ifdef _WIN32
+			FILE_END_OF_FILE_INFO info{};
+			info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+
+			return SetFileInformationByHandle(handle, FileEndOfFileInfo, &info, sizeof(info)) != FALSE;
+#else
+			return ftruncate(fileDescriptor, static_cast<off_t>(size)) == 0;
+#endif
+		}
+
+	private:
+
+#ifdef _WIN32
+		HANDLE handle;
+#else
+		int fileDescriptor;
+#endif
+	};
+
+	uint32_t ComputeChecksum(const BackupCatalogRecord& record)
+	{
+		const uLong crc = crc32(0L, Z_NULL, 0);
+
+		return static_cast<uint32_t>(crc32(
+			crc,
+			reinterpret_cast<const Bytef*>(&record),
+			static_cast<uInt>(offsetof(BackupCatalogRecord, checksum))));
+	}
+
+	bool IsHeaderValid(const CatalogHeader& header)
+	{
+		return header.signature == CatalogSignature
+			&& header.version == CatalogVersion
+			&& header.headerSize == sizeof(CatalogHeader)
+			&& header.recordSize == RecordSize;
+	}
+
+	bool WriteRecord(CatalogFile& catalog, CatalogHeader& header, const BackupCatalogRecord& record)
+	{
+		// The record is written before the header, a crash between the two writes
+		// leaves a record after the committed records that is overwritten by the next append.
+		if (!catalog.Write(sizeof(CatalogHeader) + (record.sequence * RecordSize), &record, sizeof(record))
+			|| !catalog.Flush())
+		{
+			return false;
+		}
+
+		header.recordCount = record.sequence + 1;
+
+		return catalog.Write(0, &header, sizeof(header)) && catalog.Flush();
+	}
+
+	// Replays a record that was journaled but not committed to the catalog.
+	bool ReplayJournal(CatalogFile& journal, CatalogFile& catalog, CatalogHeader& header)
+	{
+		if (journal.GetSize() == 0)
+		{
+			return true;
+		}
+
+		BackupCatalogRecord record{};
+
+		// A journal with an invalid record was not completely written,
+		// the catalog has not been changed and the journal is discarded.
+		if (journal.GetSize() == sizeof(record)
+			&& journal.Read(0, &record, sizeof(record))
+			&& BackupCatalog::IsRecordValid(record)
+			&& record.sequence == header.recordCount)
+		{
+			if (!WriteRecord(catalog, header, record))
+			{
+				return false;
+			}
+		}
+
+		return journal.Truncate(0) && journal.Flush();
+	}
+}
+
+BackupCatalog::BackupCatalog()
+	: file(),
+	  recordsView()
+{
+}
+
+bool BackupCatalog::Open(const std::filesystem::path& folder)
+{
+	Close();
+
+	if (!file.Open(folder / CatalogFileName) || file.GetSize() < sizeof(CatalogHeader))
+	{
+		Close();
+		return false;
+	}
+
+	CatalogHeader header{};
+
+	{
+		const MemoryMappedView headerView = file.MapView(0, sizeof(CatalogHeader));
+
+		if (!headerView.IsValid())
+		{
+			Close();
+			return false;
+		}
+
+		std::memcpy(&header, headerView.GetData().data(), sizeof(header));
+	}
+
+	if (!IsHeaderValid(header))
+	{
+		Close();
+		return false;
+	}
+
+	const uint64_t availableRecords = (file.GetSize() - sizeof(CatalogHeader)) / RecordSize;
+	const uint64_t recordCount = std::min(header.recordCount, availableRecords);
+
+	recordsView = file.MapView(sizeof(CatalogHeader), static_cast<size_t>(recordCount * RecordSize));
+
+	if (!recordsView.IsValid())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void BackupCatalog::Close()
+{
+	recordsView = MemoryMappedView();
+	file.Close();
+}
+
+std::span<const BackupCatalogRecord> BackupCatalog::GetRecords() const
+{
+	const std::span<const uint8_t> data = recordsView.GetData();
+
+	// The records start at a multiple of their alignment from the start of the mapped
+	// view, so they are used in place.
+	return std::span<const BackupCatalogRecord>(
+		reinterpret_cast<const BackupCatalogRecord*>(data.data()),
+		data.size() / RecordSize);
+}
+
+bool BackupCatalog::Append(const std::filesystem::path& folder, BackupCatalogRecord& record)
+{
+	CatalogFile journal;
+
+	// The journal lock is held until the journal is closed,
+	// it serializes the appends from all of the game instances.
+	if (!journal.Open(folder / JournalFileName) || !journal.Lock())
+	{
+		return false;
+	}
+
+	CatalogFile catalog;
+
+	if (!catalog.Open(folder / CatalogFileName))
+	{
+		return false;
+	}
+
+	CatalogHeader header{};
+
+	if (catalog.GetSize() < sizeof(header))
+	{
+		header.signature = CatalogSignature;
+		header.version = CatalogVersion;
+		header.headerSize = sizeof(CatalogHeader);
+		header.recordSize = RecordSize;
+		header.recordCount = 0;
+
+		if (!catalog.Write(0, &header, sizeof(header)) || !catalog.Flush())
+		{
+			return false;
+		}
+	}
+	else if (!catalog.Read(0, &header, sizeof(header)) || !IsHeaderValid(header))
+	{
+		return false;
+	}
+
+	if (!ReplayJournal(journal, catalog, header))
+	{
+		return false;
+	}
+
+	record.sequence = header.recordCount;
+	record.checksum = ComputeChecksum(record);
+
+	if (!journal.Write(0, &record, sizeof(record)) || !journal.Flush())
+	{
+		return false;
+	}
+
+	if (!WriteRecord(catalog, header, record))
+	{
+		// The journal is kept, the record will be replayed by the next append.
+		return false;
+	}
+
+	return journal.Truncate(0) && journal.Flush();
+}
+
+bool BackupCatalog::IsRecordValid(const BackupCatalogRecord& record)
+{
+	return record.checksum == ComputeChecksum(record);
+}
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "MemoryMappedFile.h"
+#include "Sha256.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdint.h>
+#include <string_view>
+
+enum class BackupVerificationStatus : uint32_t
+{
+	NotVerified = 0,
+	Valid = 1,
+	Invalid = 2,
+};
+
+// A fixed size catalog record that describes one auto-save generation.
+// The strings are zero padded and truncated to fit their field.
+struct BackupCatalogRecord
+{
+	// The index of the record in the catalog.
+	uint64_t sequence;
+	// The UTC time that the city was saved, in seconds since 1970-01-01.
+	int64_t time;
+	uint64_t fileSize;
+	uint32_t citySerialNumber;
+	int32_t population;
+	BackupVerificationStatus verificationStatus;
+	uint32_t flags;
+	Sha256Digest contentHash;
+	char cityName[64];
+	char regionName[32];
+	// The in-game date in the YYYY-MM-DD format.
+	char simDate[16];
+	// The name of the saved file.
+	char fileName[64];
+	uint32_t reserved;
+	// The CRC-32 of the preceding fields, a record with an invalid
+	// checksum was not completely written.
+	uint32_t checksum;
+};
+
+static_assert(sizeof(BackupCatalogRecord) == 256);
+
+// A persistent catalog of the auto-save generations for all cities.
+//
+// The catalog is an append-only file of fixed size records that is mapped into
+// memory when it is read, the records are used in place without being parsed.
+// A record is written to a journal file before it is appended to the catalog,
+// if the game exits while the record is being appended the journal is replayed
+// by the next append. The journal file is locked while a record is appended,
+// this allows multiple game instances to share the same catalog.
+class BackupCatalog
+{
+public:
+
+	static constexpr uint32_t FastSaveFlag = 1 << 0;
+
+	static constexpr std::string_view CatalogFileName = "BackupCatalog.dat";
+	static constexpr std::string_view JournalFileName = "BackupCatalog.journal";
+
+	BackupCatalog();
+
+	// Maps the records in the catalog, the records that are appended
+	// after the catalog has been opened are not visible until it is reopened.
+	bool Open(const std::filesystem::path& folder);
+
+	void Close();
+
+	// The records from oldest to newest, the data is valid until the catalog is closed.
+	std::span<const BackupCatalogRecord> GetRecords() const;
+
+	// Appends the record to the catalog in the specified folder, the catalog is
+	// created if it does not exist. The sequence and checksum are set by this method.
+	static bool Append(const std::filesystem::path& folder, BackupCatalogRecord& record);
+
+	static bool IsRecordValid(const BackupCatalogRecord& record);
+
+	template <size_t N>
+	static void SetText(char (&field)[N], std::string_view value)
+	{
+		const size_t length = std::min(value.size(), N - 1);
+
+		std::memcpy(field, value.data(), length);
+		std::memset(field + length, 0, N - length);
+	}
+
+	template <size_t N>
+	static std::string_view GetText(const char (&field)[N])
+	{
+		size_t length = 0;
+
+		while (length < N && field[length] != '\0')
+		{
+			length++;
+		}
+
+		return std::string_view(field, length);
+	}
+
+private:
+
+	MemoryMappedFile file;
+	MemoryMappedView recordsView;
+};
@@ -0,0 +1,420 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "BackupRetention.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+
+static constexpr int64_t SecondsPerHour = 60 * 60;
+static constexpr int64_t SecondsPerDay = 24 * SecondsPerHour;
+static constexpr int64_t SecondsPerWeek = 7 * SecondsPerDay;
+
+namespace
+{
+	struct RetentionTier
+	{
+		// The tier applies to the backups that are younger than this age.
+		int64_t maximumAge;
+		// One backup is kept for each bucket, 0 keeps every backup.
+		int64_t bucketSize;
+	};
+
+	// The bucket sizes are multiples of each other, so the backup that is kept
+	// for a bucket was also kept by the previous tier.
+	constexpr std::array<RetentionTier, 4> RetentionTiers =
+	{
+		RetentionTier{ SecondsPerHour, 0 },
+		RetentionTier{ SecondsPerDay, SecondsPerHour },
+		RetentionTier{ 30 * SecondsPerDay, SecondsPerDay },
+		RetentionTier{ std::numeric_limits<int64_t>::max(), SecondsPerWeek },
+	};
+
+	// The file system clock epoch can be after the backup times, so the
+	// division is rounded towards negative infinity.
+	int64_t GetBucket(int64_t time, int64_t bucketSize)
+	{
+		int64_t bucket = time / bucketSize;
+
+		if ((time % bucketSize) < 0)
+		{
+			bucket--;
+		}
+
+		return bucket;
+	}
+
+	int64_t GetTimeInSeconds(std::filesystem::file_time_type time)
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+	}
+}
+
+BackupRetention::BackupRetention()
+	: indexRootFolder(),
+	  loaded(false),
+	  cities(),
+	  pruneGenerations(false),
+	  cityQuotaBytes(0),
+	  totalQuotaBytes(0)
+{
+}
+
+void BackupRetention::SetPolicy(bool pruneGenerations, uint64_t cityQuotaBytes, uint64_t totalQuotaBytes)
+{
+	this->pruneGenerations = pruneGenerations;
+	this->cityQuotaBytes = cityQuotaBytes;
+	this->totalQuotaBytes = totalQuotaBytes;
+}
+
+bool BackupRetention::IsEnabled() const
+{
+	return pruneGenerations || cityQuotaBytes > 0 || totalQuotaBytes > 0;
+}
+
+void BackupRetention::Load(const std::filesystem::path& rootFolder)
+{
+	if (loaded && indexRootFolder == rootFolder)
+	{
+		return;
+	}
+
+	Reset();
+
+	indexRootFolder = rootFolder;
+	loaded = true;
+
+	// The backups are in <root>\<region>\<city>, each of the folders is listed
+	// once without descending into the other folders in the city folder.
+	// The error_code overloads are used because this runs on a background thread,
+	// a folder that cannot be listed is skipped.
+	const std::filesystem::directory_iterator end;
+	std::error_code regionError;
+
+	for (std::filesystem::directory_iterator regionIt(rootFolder, regionError);
+		 !regionError && regionIt != end;
+		 regionIt.increment(regionError))
+	{
+		std::error_code typeError;
+
+		if (!regionIt->is_directory(typeError))
+		{
+			continue;
+		}
+
+		std::error_code cityError;
+
+		for (std::filesystem::directory_iterator cityIt(regionIt->path(), cityError);
+			 !cityError && cityIt != end;
+			 cityIt.increment(cityError))
+		{
+			if (!cityIt->is_directory(typeError))
+			{
+				continue;
+			}
+
+			CityBackups& backups = cities[cityIt->path()];
+			std::error_code fileError;
+
+			for (std::filesystem::directory_iterator fileIt(cityIt->path(), fileError);
+				 !fileError && fileIt != end;
+				 fileIt.increment(fileError))
+			{
+				if (!fileIt->is_regular_file(typeError) || !IsBackupFile(fileIt->path()))
+				{
+					continue;
+				}
+
+				std::error_code timeError;
+				const std::filesystem::file_time_type lastWriteTime = fileIt->last_write_time(timeError);
+
+				std::error_code sizeError;
+				const uintmax_t size = fileIt->file_size(sizeError);
+
+				if (!timeError && !sizeError)
+				{
+					AddCityBackup(backups, Backup{ fileIt->path(), GetTimeInSeconds(lastWriteTime), size, true });
+				}
+			}
+
+			if (backups.empty())
+			{
+				cities.erase(cityIt->path());
+			}
+		}
+	}
+}
+
+void BackupRetention::Reset()
+{
+	indexRootFolder.clear();
+	loaded = false;
+	cities.clear();
+}
+
+void BackupRetention::AddBackup(const std::filesystem::path& path, int64_t time)
+{
+	AddCityBackup(cities[path.parent_path()], Backup{ path, time, 0, false });
+}
+
+BackupPruneResult BackupRetention::Prune(int64_t now, std::stop_token stopToken)
+{
+	BackupPruneResult result{};
+
+	for (auto& [folder, backups] : cities)
+	{
+		RefreshSizes(backups);
+
+		if (pruneGenerations)
+		{
+			std::vector<int64_t> times;
+			times.reserve(backups.size());
+
+			for (const Backup& backup : backups)
+			{
+				times.push_back(backup.time);
+			}
+
+			const std::vector<bool> keep = SelectGenerations(times, now);
+
+			// The backups are deleted from newest to oldest so that the indices stay valid.
+			for (size_t i = keep.size(); i-- > 0;)
+			{
+				if (stopToken.stop_requested())
+				{
+					return result;
+				}
+
+				if (!keep[i])
+				{
+					DeleteBackup(backups, i, result);
+				}
+			}
+		}
+
+		if (cityQuotaBytes > 0)
+		{
+			uint64_t citySize = GetCitySize(backups);
+
+			// The newest backup is never deleted.
+			while (citySize > cityQuotaBytes && backups.size() > 1)
+			{
+				if (stopToken.stop_requested())
+				{
+					return result;
+				}
+
+				const uint64_t size = backups.front().size;
+
+				DeleteBackup(backups, 0, result);
+				citySize -= size;
+			}
+		}
+	}
+
+	if (totalQuotaBytes > 0)
+	{
+		uint64_t totalSize = GetTotalSize();
+
+		while (totalSize > totalQuotaBytes)
+		{
+			if (stopToken.stop_requested())
+			{
+				return result;
+			}
+
+			// Finds the oldest backup that is not the newest backup of its city.
+			CityBackups* oldestCity = nullptr;
+
+			for (auto& [folder, backups] : cities)
+			{
+				if (backups.size() > 1 && (!oldestCity || backups.front().time < oldestCity->front().time))
+				{
+					oldestCity = &backups;
+				}
+			}
+
+			if (!oldestCity)
+			{
+				break;
+			}
+
+			const uint64_t size = oldestCity->front().size;
+
+			DeleteBackup(*oldestCity, 0, result);
+			totalSize -= size;
+		}
+	}
+
+	std::erase_if(cities, [](const auto& item) { return item.second.empty(); });
+
+	result.totalBytes = GetTotalSize();
+
+	return result;
+}
+
+std::vector<bool> BackupRetention::SelectGenerations(const std::vector<int64_t>& times, int64_t now)
+{
+	std::vector<bool> keep(times.size(), false);
+	std::array<int64_t, RetentionTiers.size()> lastBucket{};
+	std::array<bool, RetentionTiers.size()> hasLastBucket{};
+
+	// The backups are visited from newest to oldest, the first backup
+	// that is seen in a bucket is the newest backup in that bucket.
+	for (size_t i = times.size(); i-- > 0;)
+	{
+		const int64_t age = std::max<int64_t>(now - times[i], 0);
+
+		for (size_t tier = 0; tier < RetentionTiers.size(); tier++)
+		{
+			if (age >= RetentionTiers[tier].maximumAge)
+			{
+				continue;
+			}
+
+			const int64_t bucketSize = RetentionTiers[tier].bucketSize;
+
+			if (bucketSize == 0)
+			{
+				keep[i] = true;
+			}
+			else
+			{
+				const int64_t bucket = GetBucket(times[i], bucketSize);
+
+				if (!hasLastBucket[tier] || lastBucket[tier] != bucket)
+				{
+					keep[i] = true;
+					lastBucket[tier] = bucket;
+					hasLastBucket[tier] = true;
+				}
+			}
+			break;
+		}
+	}
+
+	return keep;
+}
+
+int64_t BackupRetention::GetFileSystemTime()
+{
+	return GetTimeInSeconds(std::filesystem::file_time_type::clock::now());
+}
+
+void BackupRetention::AddCityBackup(CityBackups& backups, Backup&& backup)
+{
+	auto existing = std::find_if(
+		backups.begin(),
+		backups.end(),
+		[&](const Backup& item) { return item.path == backup.path; });
+
+	if (existing != backups.end())
+	{
+		// The index was loaded after the backup was queued.
+		if (!existing->sizeKnown && backup.sizeKnown)
+		{
+			existing->size = backup.size;
+			existing->sizeKnown = true;
+		}
+		return;
+	}
+
+	auto position = std::upper_bound(
+		backups.begin(),
+		backups.end(),
+		backup.time,
+		[](int64_t time, const Backup& item) { return time < item.time; });
+
+	backups.insert(position, std::move(backup));
+}
+
+void BackupRetention::RefreshSizes(CityBackups& backups)
+{
+	for (size_t i = backups.size(); i-- > 0;)
+	{
+		Backup& backup = backups[i];
+
+		if (backup.sizeKnown)
+		{
+			continue;
+		}
+
+		std::error_code ec;
+		const uintmax_t size = std::filesystem::file_size(backup.path, ec);
+
+		if (!ec)
+		{
+			backup.size = size;
+			backup.sizeKnown = true;
+		}
+		else
+		{
+			// The backups are added after their compression has completed,
+			// the file was deleted or the compression failed.
+			backups.erase(backups.begin() + i);
+		}
+	}
+}
+
+void BackupRetention::DeleteBackup(CityBackups& backups, size_t index, BackupPruneResult& result)
+{
+	const Backup& backup = backups[index];
+
+	std::error_code ec;
+	std::filesystem::remove(backup.path, ec);
+
+	if (ec)
+	{
+		// The backup is left on the disk and removed from the index, it will be
+		// pruned again the next time the index is loaded.
+		result.failedCount++;
+	}
+	else
+	{
+		result.deletedCount++;
+		result.deletedBytes += backup.size;
+	}
+
+	backups.erase(backups.begin() + index);
+}
+
+uint64_t BackupRetention::GetTotalSize() const
+{
+	uint64_t total = 0;
+
+	for (const auto& [folder, backups] : cities)
+	{
+		total += GetCitySize(backups);
+	}
+
+	return total;
+}
+
+uint64_t BackupRetention::GetCitySize(const CityBackups& backups)
+{
+	uint64_t size = 0;
+
+	for (const Backup& backup : backups)
+	{
+		size += backup.size;
+	}
+
+	return size;
+}
+
+bool BackupRetention::IsBackupFile(const std::filesystem::path& path)
+{
+	const std::string fileName = path.filename().string();
+
+	return fileName.size() > BackupExtension.size() && fileName.ends_with(BackupExtension);
+}
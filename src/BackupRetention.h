@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <map>
+#include <stdint.h>
+#include <stop_token>
+#include <string_view>
+#include <vector>
+
+struct BackupPruneResult
+{
+	size_t deletedCount;
+	uint64_t deletedBytes;
+	// The backups that could not be deleted, e.g. because they are open in another program.
+	size_t failedCount;
+	// The size of the backups that remain in the index.
+	uint64_t totalBytes;
+};
+
+// Deletes old compressed backups on a grandfather-father-son schedule and
+// keeps their size under the per-city and total quotas.
+//
+// The backups are tracked in an in-memory index, the backup folder is only listed
+// once when the index is loaded and the new backups are added as they are compressed.
+// The times are in seconds of the file system clock, see GetFileSystemTime.
+//
+// This class is not thread-safe, it is only used from the background task thread.
+class BackupRetention
+{
+public:
+
+	static constexpr std::string_view BackupExtension = ".sc4.gz";
+
+	BackupRetention();
+
+	// Sets the retention policy, a quota of 0 does not limit the size.
+	void SetPolicy(bool pruneGenerations, uint64_t cityQuotaBytes, uint64_t totalQuotaBytes);
+
+	bool IsEnabled() const;
+
+	// Builds the index from the backups in the city folders of the root folder,
+	// this does nothing if the index has already been loaded from the same folder.
+	void Load(const std::filesystem::path& rootFolder);
+
+	// Discards the index, the next call to Load will list the backup folder again.
+	void Reset();
+
+	// Adds a backup that has been compressed, its size is read when the backups are pruned.
+	void AddBackup(const std::filesystem::path& path, int64_t time);
+
+	// Deletes the backups that are not kept by the retention policy.
+	BackupPruneResult Prune(int64_t now, std::stop_token stopToken);
+
+	// Selects the backups that are kept by the grandfather-father-son schedule.
+	// The times must be sorted from oldest to newest, the newest backup in each
+	// hour, day or week bucket is kept.
+	static std::vector<bool> SelectGenerations(const std::vector<int64_t>& times, int64_t now);
+
+	static int64_t GetFileSystemTime();
+
+private:
+
+	struct Backup
+	{
+		std::filesystem::path path;
+		int64_t time;
+		uint64_t size;
+		bool sizeKnown;
+	};
+
+	// The backups for one city, sorted from oldest to newest.
+	typedef std::vector<Backup> CityBackups;
+
+	void AddCityBackup(CityBackups& backups, Backup&& backup);
+
+	void RefreshSizes(CityBackups& backups);
+
+	void DeleteBackup(CityBackups& backups, size_t index, BackupPruneResult& result);
+
+	uint64_t GetTotalSize() const;
+
+	static uint64_t GetCitySize(const CityBackups& backups);
+
+	static bool IsBackupFile(const std::filesystem::path& path);
+
+	std::filesystem::path indexRootFolder;
+	bool loaded;
+	std::map<std::filesystem::path, CityBackups> cities;
+	bool pruneGenerations;
+	uint64_t cityQuotaBytes;
+	uint64_t totalQuotaBytes;
+};
@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "CityChangeTracker.h"
+
+CityChangeTracker::CityChangeTracker()
+	: savedSimDateNumber(0),
+	  savedSimTime(0),
+	  // The city is treated as changed until the first reset, a save
+	  // is never skipped when the state of the city is unknown.
+	  changed(true)
+{
+}
+
+void CityChangeTracker::Reset(int32_t simDateNumber, int32_t simTime)
+{
+	savedSimDateNumber = simDateNumber;
+	savedSimTime = simTime;
+	changed = false;
+}
+
+void CityChangeTracker::MarkChanged()
+{
+	changed = true;
+}
+
+void CityChangeTracker::Update(int32_t simDateNumber, int32_t simTime)
+{
+	if (simDateNumber != savedSimDateNumber || simTime != savedSimTime)
+	{
+		changed = true;
+	}
+}
+
+bool CityChangeTracker::IsChanged() const
+{
+	return changed;
+}
@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+
+// Tracks whether the city has changed since it was last saved.
+//
+// The game does not expose a modified flag, so a change is detected from the
+// simulation date or time advancing since the last save, or from the notification
+// messages that the game sends when a building or network is placed or removed.
+// The simulation only advances while the game is not paused, this allows the
+// auto-save to be skipped for a city that was left paused or has not been edited.
+class CityChangeTracker
+{
+public:
+
+	CityChangeTracker();
+
+	// Sets the simulation date and time of the city when it was loaded or saved.
+	void Reset(int32_t simDateNumber, int32_t simTime);
+
+	// Called when a notification message shows that the city was edited.
+	void MarkChanged();
+
+	// Compares the simulation date and time with the values from the last reset.
+	void Update(int32_t simDateNumber, int32_t simTime);
+
+	bool IsChanged() const;
+
+private:
+
+	int32_t savedSimDateNumber;
+	int32_t savedSimTime;
+	bool changed;
+};
@@ -0,0 +1,482 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "CompressionPipeline.h"
+#include "EventLog.h"
+#include "Logger.h"
+#include "Stopwatch.h"
+#include <algorithm>
+#include <fstream>
+#include <Windows.h>
+#include "zlib.h"
+
+// The block size and count limit the pipeline to approximately 12 MB of memory,
+// an input and output buffer is allocated for each block.
+static constexpr size_t kBlockSize = 1024 * 1024;
+static constexpr size_t kMaxBlocksInFlight = 6;
+static constexpr uint32_t kMaxWorkerThreads = 4;
+
+static constexpr int kCompressionLevel = 6;
+// Adding 16 to the window bits makes zlib write a gzip header and trailer.
+static constexpr int kGzipWindowBits = 15 + 16;
+static constexpr int kMemoryLevel = 8;
+
+namespace
+{
+	bool GetFileStamp(const std::filesystem::path& path, uintmax_t& size, std::filesystem::file_time_type& lastWriteTime)
+	{
+		std::error_code ec;
+
+		size = std::filesystem::file_size(path, ec);
+
+		if (!ec)
+		{
+			lastWriteTime = std::filesystem::last_write_time(path, ec);
+		}
+
+		return !ec;
+	}
+}
+
+CompressionPipeline::CompressionPipeline()
+	: coordinatorThread(),
+	  workerThreads(),
+	  pendingJob(),
+	  stopRequested(false),
+	  blockQueue(),
+	  blocks(),
+	  stopWorkers(false)
+{
+}
+
+CompressionPipeline::~CompressionPipeline()
+{
+	Stop();
+}
+
+void CompressionPipeline::Start(uint32_t workerThreadCount)
+{
+	if (coordinatorThread.joinable())
+	{
+		return;
+	}
+
+	if (workerThreadCount == 0)
+	{
+		// Leave one core for the game.
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+
+		workerThreadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	workerThreadCount = std::min(workerThreadCount, kMaxWorkerThreads);
+
+	stopRequested = false;
+	stopWorkers = false;
+
+	for (uint32_t i = 0; i < workerThreadCount; i++)
+	{
+		workerThreads.emplace_back(&CompressionPipeline::WorkerThreadProc, this);
+	}
+
+	coordinatorThread = std::thread(&CompressionPipeline::CoordinatorThreadProc, this);
+}
+
+void CompressionPipeline::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopRequested = true;
+		pendingJob.reset();
+	}
+	jobCondition.notify_all();
+	blockDoneCondition.notify_all();
+
+	if (coordinatorThread.joinable())
+	{
+		coordinatorThread.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(blockMutex);
+		stopWorkers = true;
+	}
+	blockQueuedCondition.notify_all();
+
+	for (std::thread& thread : workerThreads)
+	{
+		thread.join();
+	}
+
+	workerThreads.clear();
+	blockQueue.clear();
+	blocks.clear();
+}
+
+void CompressionPipeline::QueueFile(
+	const std::filesystem::path& source,
+	const std::filesystem::path& destination,
+	CompletionCallback&& onCompleted)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+
+		if (stopRequested || !coordinatorThread.joinable())
+		{
+			return;
+		}
+
+		pendingJob = Job{ source, destination, std::move(onCompleted) };
+	}
+	jobCondition.notify_one();
+}
+
+void CompressionPipeline::CoordinatorThreadProc()
+{
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+
+			jobCondition.wait(lock, [this] { return stopRequested || pendingJob.has_value(); });
+
+			if (stopRequested)
+			{
+				break;
+			}
+
+			job = std::move(pendingJob.value());
+			pendingJob.reset();
+		}
+
+		Stopwatch stopwatch;
+		stopwatch.Start();
+
+		// The block buffers are only allocated while a file is being compressed,
+		// the game is a 32-bit process and its address space is limited.
+		blocks.resize(kMaxBlocksInFlight);
+
+		for (Block& block : blocks)
+		{
+			block.input.resize(kBlockSize);
+			block.inputLength = 0;
+			block.output.resize(compressBound(static_cast<uLong>(kBlockSize)) + 32);
+			block.outputLength = 0;
+			block.state = BlockState::Free;
+			block.failed = false;
+		}
+
+		bool result = CompressFile(job);
+
+		{
+			std::lock_guard<std::mutex> lock(blockMutex);
+			blocks.clear();
+			blocks.shrink_to_fit();
+		}
+
+		stopwatch.Stop();
+
+		if (result)
+		{
+			Logger::GetInstance().WriteLineFormatted(
+				LogLevel::Info,
+				"Compressed backup written in %lld ms: %s",
+				stopwatch.ElapsedMilliseconds(),
+				job.destination.filename().string().c_str());
+		}
+
+		EventRecord record;
+		record.event = "compress";
+		record.durationMilliseconds = stopwatch.ElapsedMilliseconds();
+		record.result = result ? "ok" : "failed";
+		record.detail = job.destination.filename().string();
+
+		if (result)
+		{
+			std::error_code ec;
+			const uintmax_t compressedSize = std::filesystem::file_size(job.destination, ec);
+
+			if (!ec)
+			{
+				record.bytes = static_cast<int64_t>(compressedSize);
+			}
+		}
+
+		EventLog::GetInstance().Write(record);
+
+		if (job.onCompleted && !IsStopRequested())
+		{
+			job.onCompleted();
+		}
+	}
+}
+
+void CompressionPipeline::WorkerThreadProc()
+{
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+	z_stream stream{};
+
+	const bool initialized = deflateInit2(
+		&stream,
+		kCompressionLevel,
+		Z_DEFLATED,
+		kGzipWindowBits,
+		kMemoryLevel,
+		Z_DEFAULT_STRATEGY) == Z_OK;
+
+	while (true)
+	{
+		size_t blockIndex = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(blockMutex);
+
+			blockQueuedCondition.wait(lock, [this] { return stopWorkers || !blockQueue.empty(); });
+
+			if (stopWorkers)
+			{
+				break;
+			}
+
+			blockIndex = blockQueue.front();
+			blockQueue.pop_front();
+		}
+
+		Block& block = blocks[blockIndex];
+
+		bool failed = true;
+
+		// Each block is written as a complete gzip member, a gzip file can
+		// contain multiple members that are decompressed as one stream.
+		if (initialized && deflateReset(&stream) == Z_OK)
+		{
+			stream.next_in = block.input.data();
+			stream.avail_in = static_cast<uInt>(block.inputLength);
+			stream.next_out = block.output.data();
+			stream.avail_out = static_cast<uInt>(block.output.size());
+
+			if (deflate(&stream, Z_FINISH) == Z_STREAM_END)
+			{
+				block.outputLength = block.output.size() - stream.avail_out;
+				failed = false;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(blockMutex);
+			block.failed = failed;
+			block.state = BlockState::Done;
+		}
+		blockDoneCondition.notify_all();
+	}
+
+	if (initialized)
+	{
+		deflateEnd(&stream);
+	}
+}
+
+bool CompressionPipeline::CompressFile(const Job& job)
+{
+	Logger& logger = Logger::GetInstance();
+
+	// The source is the save file in the region folder, the game can save over it
+	// while it is being compressed.
+	uintmax_t sourceSize = 0;
+	std::filesystem::file_time_type sourceWriteTime;
+
+	std::ifstream input(job.source, std::ifstream::in | std::ifstream::binary);
+
+	if (!input || !GetFileStamp(job.source, sourceSize, sourceWriteTime))
+	{
+		logger.WriteLineFormatted(
+			LogLevel::Error,
+			"Failed to open the file to compress: %s",
+			job.source.string().c_str());
+		return false;
+	}
+
+	// The backup is written to a temporary file that is renamed when it is complete,
+	// this ensures that a partial backup cannot be mistaken for a complete one.
+	std::filesystem::path tempPath = job.destination;
+	tempPath += ".partial";
+
+	std::ofstream output(tempPath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+	if (!output)
+	{
+		logger.WriteLineFormatted(
+			LogLevel::Error,
+			"Failed to create the compressed backup: %s",
+			tempPath.string().c_str());
+		return false;
+	}
+
+	uint64_t nextBlockToRead = 0;
+	uint64_t nextBlockToWrite = 0;
+	bool endOfFile = false;
+	bool result = true;
+
+	while (!endOfFile || nextBlockToWrite < nextBlockToRead)
+	{
+		if (IsStopRequested())
+		{
+			result = false;
+			break;
+		}
+
+		if (!endOfFile && (nextBlockToRead - nextBlockToWrite) < blocks.size())
+		{
+			const size_t blockIndex = static_cast<size_t>(nextBlockToRead % blocks.size());
+			Block& block = blocks[blockIndex];
+
+			input.read(reinterpret_cast<char*>(block.input.data()), kBlockSize);
+			block.inputLength = static_cast<size_t>(input.gcount());
+
+			if (input.bad())
+			{
+				logger.WriteLine(LogLevel::Error, "An error occurred when reading the file to compress.");
+				result = false;
+				break;
+			}
+
+			if (block.inputLength < kBlockSize)
+			{
+				endOfFile = true;
+			}
+
+			if (block.inputLength > 0)
+			{
+				{
+					std::lock_guard<std::mutex> lock(blockMutex);
+					block.state = BlockState::Queued;
+					blockQueue.push_back(blockIndex);
+				}
+				blockQueuedCondition.notify_one();
+
+				nextBlockToRead++;
+			}
+		}
+		else
+		{
+			Block& block = blocks[static_cast<size_t>(nextBlockToWrite % blocks.size())];
+
+			{
+				std::unique_lock<std::mutex> lock(blockMutex);
+
+				blockDoneCondition.wait(lock, [&block] { return block.state == BlockState::Done; });
+			}
+
+			if (block.failed)
+			{
+				logger.WriteLine(LogLevel::Error, "Failed to compress a block of the save file.");
+				result = false;
+			}
+			else
+			{
+				output.write(reinterpret_cast<const char*>(block.output.data()), block.outputLength);
+
+				if (!output)
+				{
+					logger.WriteLine(LogLevel::Error, "An error occurred when writing the compressed backup.");
+					result = false;
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(blockMutex);
+				block.state = BlockState::Free;
+			}
+			nextBlockToWrite++;
+
+			if (!result)
+			{
+				break;
+			}
+		}
+	}
+
+	WaitForBlocksInFlight(nextBlockToWrite, nextBlockToRead);
+
+	if (result && nextBlockToRead == 0)
+	{
+		logger.WriteLine(LogLevel::Error, "The file to compress is empty.");
+		result = false;
+	}
+
+	if (result)
+	{
+		uintmax_t size = 0;
+		std::filesystem::file_time_type writeTime;
+
+		if (!GetFileStamp(job.source, size, writeTime) || size != sourceSize || writeTime != sourceWriteTime)
+		{
+			logger.WriteLineFormatted(
+				LogLevel::Error,
+				"The file was saved over while it was being compressed, the backup was discarded: %s",
+				job.source.filename().string().c_str());
+			result = false;
+		}
+	}
+
+	output.close();
+
+	std::error_code ec;
+
+	if (result)
+	{
+		std::filesystem::rename(tempPath, job.destination, ec);
+
+		if (ec)
+		{
+			logger.WriteLineFormatted(
+				LogLevel::Error,
+				"Failed to rename the compressed backup: %s",
+				ec.message().c_str());
+			result = false;
+		}
+	}
+
+	if (!result)
+	{
+		std::filesystem::remove(tempPath, ec);
+	}
+
+	return result;
+}
+
+void CompressionPipeline::WaitForBlocksInFlight(uint64_t nextBlockToWrite, uint64_t nextBlockToRead)
+{
+	// The workers may still be using blocks that were queued before the
+	// compression was stopped, we have to wait for them before the buffers
+	// can be released.
+	std::unique_lock<std::mutex> lock(blockMutex);
+
+	for (uint64_t i = nextBlockToWrite; i < nextBlockToRead; i++)
+	{
+		Block& block = blocks[static_cast<size_t>(i % blocks.size())];
+
+		blockDoneCondition.wait(lock, [&block] { return block.state != BlockState::Queued; });
+		block.state = BlockState::Free;
+	}
+}
+
+bool CompressionPipeline::IsStopRequested()
+{
+	std::lock_guard<std::mutex> lock(jobMutex);
+	return stopRequested;
+}
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Compresses completed save files on background threads.
+//
+// The file is read in fixed size blocks that are compressed in parallel and written
+// in order as independent gzip members, the output can be decompressed by any gzip tool.
+// Only a fixed number of blocks are in flight at a time, so the memory usage does not
+// depend on the size of the save file.
+class CompressionPipeline
+{
+public:
+
+	// Called on the pipeline thread after the destination file has been closed.
+	typedef std::function<void()> CompletionCallback;
+
+	CompressionPipeline();
+	~CompressionPipeline();
+
+	void Start(uint32_t workerThreadCount);
+
+	void Stop();
+
+	// Queues a file to be compressed, this method does not wait for the compression to start.
+	// If a file is already waiting to be compressed, it is replaced with the new file and
+	// its callback is not called. The callback is called when the compression succeeds
+	// or fails, but not if the pipeline is stopped first.
+	void QueueFile(
+		const std::filesystem::path& source,
+		const std::filesystem::path& destination,
+		CompletionCallback&& onCompleted);
+
+private:
+
+	enum class BlockState
+	{
+		Free = 0,
+		Queued,
+		Done
+	};
+
+	struct Block
+	{
+		std::vector<uint8_t> input;
+		size_t inputLength;
+		std::vector<uint8_t> output;
+		size_t outputLength;
+		BlockState state;
+		bool failed;
+	};
+
+	struct Job
+	{
+		std::filesystem::path source;
+		std::filesystem::path destination;
+		CompletionCallback onCompleted;
+	};
+
+	void CoordinatorThreadProc();
+
+	void WorkerThreadProc();
+
+	bool CompressFile(const Job& job);
+
+	void WaitForBlocksInFlight(uint64_t nextBlockToWrite, uint64_t nextBlockToRead);
+
+	bool IsStopRequested();
+
+	std::thread coordinatorThread;
+	std::vector<std::thread> workerThreads;
+
+	std::mutex jobMutex;
+	std::condition_variable jobCondition;
+	std::optional<Job> pendingJob;
+	bool stopRequested;
+
+	std::mutex blockMutex;
+	std::condition_variable blockQueuedCondition;
+	std::condition_variable blockDoneCondition;
+	std::deque<size_t> blockQueue;
+	std::vector<Block> blocks;
+	bool stopWorkers;
+};
+
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "DBPFReader.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t DBPFSignature = 0x46504244; // DBPF
+static constexpr uint32_t IndexEntrySize = 20;
+
+namespace
+{
+	uint32_t ReadUInt32(const uint8_t* data)
+	{
+		uint32_t value = 0;
+		std::memcpy(&value, data, sizeof(value));
+
+		return value;
+	}
+}
+
+DBPFReader::DBPFReader()
+	: file(),
+	  errorMessage(""),
+	  indexOffset(0),
+	  indexSize(0),
+	  entries()
+{
+}
+
+bool DBPFReader::Open(const std::filesystem::path& path)
+{
+	Close();
+
+	if (!file.Open(path))
+	{
+		return SetError("Failed to open the DBPF file.");
+	}
+
+	if (file.GetSize() < HeaderSize)
+	{
+		return SetError("The DBPF file is too small to contain a header.");
+	}
+
+	uint32_t entryCount = 0;
+
+	{
+		const MemoryMappedView headerView = file.MapView(0, HeaderSize);
+
+		if (!headerView.IsValid())
+		{
+			return SetError("Failed to map the DBPF header.");
+		}
+
+		const uint8_t* header = headerView.GetData().data();
+
+		const uint32_t signature = ReadUInt32(header);
+		const uint32_t majorVersion = ReadUInt32(header + 4);
+		const uint32_t minorVersion = ReadUInt32(header + 8);
+		const uint32_t indexMajorVersion = ReadUInt32(header + 32);
+		entryCount = ReadUInt32(header + 36);
+		indexOffset = ReadUInt32(header + 40);
+		indexSize = ReadUInt32(header + 44);
+
+		// SimCity 4 uses version 1.0 with version 7.0 index entries.
+		if (signature != DBPFSignature || majorVersion != 1 || minorVersion != 0 || indexMajorVersion != 7)
+		{
+			return SetError("The file is not a SimCity 4 DBPF file.");
+		}
+	}
+
+	if (static_cast<uint64_t>(entryCount) * IndexEntrySize != indexSize)
+	{
+		return SetError("The DBPF index size does not match the entry count.");
+	}
+
+	if (indexOffset < HeaderSize || static_cast<uint64_t>(indexOffset) + indexSize > file.GetSize())
+	{
+		return SetError("The DBPF index is outside of the file.");
+	}
+
+	const MemoryMappedView indexView = file.MapView(indexOffset, indexSize);
+
+	if (!indexView.IsValid())
+	{
+		return SetError("Failed to map the DBPF index.");
+	}
+
+	const uint8_t* indexData = indexView.GetData().data();
+
+	entries.reserve(entryCount);
+
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		const uint8_t* data = indexData + (static_cast<size_t>(i) * IndexEntrySize);
+
+		DBPFIndexEntry entry{};
+		entry.type = ReadUInt32(data);
+		entry.group = ReadUInt32(data + 4);
+		entry.instance = ReadUInt32(data + 8);
+		entry.offset = ReadUInt32(data + 12);
+		entry.size = ReadUInt32(data + 16);
+
+		if (static_cast<uint64_t>(entry.offset) + entry.size > file.GetSize())
+		{
+			return SetError("A DBPF index entry is outside of the file.");
+		}
+
+		entries.push_back(entry);
+	}
+
+	std::sort(
+		entries.begin(),
+		entries.end(),
+		[](const DBPFIndexEntry& a, const DBPFIndexEntry& b) { return a.offset < b.offset; });
+
+	return true;
+}
+
+void DBPFReader::Close()
+{
+	file.Close();
+	errorMessage = "";
+	indexOffset = 0;
+	indexSize = 0;
+	entries.clear();
+}
+
+const char* DBPFReader::GetErrorMessage() const
+{
+	return errorMessage;
+}
+
+uint64_t DBPFReader::GetFileSize() const
+{
+	return file.GetSize();
+}
+
+uint32_t DBPFReader::GetIndexOffset() const
+{
+	return indexOffset;
+}
+
+uint32_t DBPFReader::GetIndexSize() const
+{
+	return indexSize;
+}
+
+const std::vector<DBPFIndexEntry>& DBPFReader::GetEntries() const
+{
+	return entries;
+}
+
+MemoryMappedView DBPFReader::MapEntry(const DBPFIndexEntry& entry) const
+{
+	return file.MapView(entry.offset, entry.size);
+}
+
+MemoryMappedView DBPFReader::MapRange(uint64_t offset, size_t length) const
+{
+	return file.MapView(offset, length);
+}
+
+bool DBPFReader::SetError(const char* message)
+{
+	file.Close();
+	errorMessage = message;
+	indexOffset = 0;
+	indexSize = 0;
+	entries.clear();
+
+	return false;
+}
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "MemoryMappedFile.h"
+#include <filesystem>
+#include <stdint.h>
+#include <vector>
+
+struct DBPFIndexEntry
+{
+	uint32_t type;
+	uint32_t group;
+	uint32_t instance;
+	uint32_t offset;
+	uint32_t size;
+};
+
+// Reads a SimCity 4 DBPF file using memory mapped views.
+//
+// Only the header and index are read when the file is opened, the entry data
+// is accessed through views of the mapping without being copied.
+// This class does not depend on the game or Windows, and it does not write to
+// the log. The reason for a failure is available from GetErrorMessage.
+class DBPFReader
+{
+public:
+
+	static constexpr uint32_t HeaderSize = 96;
+
+	DBPFReader();
+
+	// Opens the file and validates the header and index table.
+	bool Open(const std::filesystem::path& path);
+
+	void Close();
+
+	const char* GetErrorMessage() const;
+
+	uint64_t GetFileSize() const;
+
+	uint32_t GetIndexOffset() const;
+
+	uint32_t GetIndexSize() const;
+
+	// The index entries sorted by their offset in the file.
+	const std::vector<DBPFIndexEntry>& GetEntries() const;
+
+	// Maps the data for the specified entry.
+	MemoryMappedView MapEntry(const DBPFIndexEntry& entry) const;
+
+	// Maps the specified range of the file.
+	MemoryMappedView MapRange(uint64_t offset, size_t length) const;
+
+private:
+
+	bool SetError(const char* message);
+
+	MemoryMappedFile file;
+	const char* errorMessage;
+	uint32_t indexOffset;
+	uint32_t indexSize;
+	std::vector<DBPFIndexEntry> entries;
+};
+
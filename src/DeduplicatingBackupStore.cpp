@@ -0,0 +1,589 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "DeduplicatingBackupStore.h"
+#include "DBPFReader.h"
+#include "Logger.h"
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+
+static constexpr std::string_view ObjectsFolderName = "Objects";
+static constexpr std::string_view GenerationsFolderName = "Generations";
+static constexpr std::string_view ManifestExtension = ".manifest";
+
+static constexpr uint32_t ManifestSignature = 0x4D445341; // ASDM
+static constexpr uint32_t ManifestVersion = 1;
+// The signature, version, file size and extent count.
+static constexpr uint64_t ManifestHeaderSize = 20;
+// The TGI, offset, size and SHA-256 digest of an extent.
+static constexpr uint64_t ManifestExtentSize = 52;
+
+namespace
+{
+	template<typename T> bool ReadValue(std::ifstream& stream, T& value)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template<typename T> void WriteValue(std::ofstream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	bool WriteFileAtomic(const std::filesystem::path& path, const void* data, size_t length)
+	{
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp";
+
+		{
+			std::ofstream stream(tempPath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+			if (!stream)
+			{
+				return false;
+			}
+
+			stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(length));
+
+			if (!stream)
+			{
+				stream.close();
+
+				std::error_code ec;
+				std::filesystem::remove(tempPath, ec);
+				return false;
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+
+		return !ec;
+	}
+}
+
+DeduplicatingBackupStore::DeduplicatingBackupStore()
+	: storeFolder(),
+	  generations(),
+	  objectReferenceCounts(),
+	  sha256()
+{
+}
+
+bool DeduplicatingBackupStore::AddGeneration(
+	const std::filesystem::path& folder,
+	const std::filesystem::path& saveFilePath,
+	const std::string& generationName,
+	std::stop_token stopToken)
+{
+	Logger& logger = Logger::GetInstance();
+
+	if (!sha256.IsValid())
+	{
+		logger.WriteLine(LogLevel::Error, "The SHA-256 hash provider is not available.");
+		return false;
+	}
+
+	if (!LoadStore(folder))
+	{
+		return false;
+	}
+
+	DBPFReader reader;
+
+	if (!reader.Open(saveFilePath))
+	{
+		logger.WriteLineFormatted(
+			LogLevel::Error,
+			"Failed to read the save file: %s",
+			reader.GetErrorMessage());
+		return false;
+	}
+
+	// Split the file into extents that cover every byte, the entries are
+	// sorted by offset and any space between them becomes an untyped extent.
+	std::vector<ManifestExtent> extents;
+	extents.reserve((reader.GetEntries().size() * 2) + 1);
+
+	uint64_t position = 0;
+
+	for (const DBPFIndexEntry& entry : reader.GetEntries())
+	{
+		if (entry.size == 0)
+		{
+			continue;
+		}
+
+		if (entry.offset < position)
+		{
+			logger.WriteLine(LogLevel::Error, "The save file has overlapping DBPF entries, it cannot be deduplicated.");
+			return false;
+		}
+
+		if (entry.offset > position)
+		{
+			extents.push_back(ManifestExtent{ 0, 0, 0, static_cast<uint32_t>(position), static_cast<uint32_t>(entry.offset - position), Sha256Digest{} });
+		}
+
+		extents.push_back(ManifestExtent{ entry.type, entry.group, entry.instance, entry.offset, entry.size, Sha256Digest{} });
+		position = static_cast<uint64_t>(entry.offset) + entry.size;
+	}
+
+	if (position < reader.GetFileSize())
+	{
+		extents.push_back(ManifestExtent{ 0, 0, 0, static_cast<uint32_t>(position), static_cast<uint32_t>(reader.GetFileSize() - position), Sha256Digest{} });
+	}
+
+	std::unordered_set<Sha256Digest, Sha256DigestHasher> newObjects;
+	uint64_t bytesWritten = 0;
+
+	for (ManifestExtent& extent : extents)
+	{
+		if (stopToken.stop_requested())
+		{
+			RemoveObjects(newObjects);
+			return false;
+		}
+
+		// The extent is hashed and written directly from the mapped view.
+		const MemoryMappedView view = reader.MapRange(extent.offset, extent.size);
+
+		if (!view.IsValid())
+		{
+			logger.WriteLine(LogLevel::Error, "Failed to map a DBPF entry from the save file.");
+			RemoveObjects(newObjects);
+			return false;
+		}
+
+		const std::span<const uint8_t> data = view.GetData();
+
+		const uint32_t tgi[3] = { extent.type, extent.group, extent.instance };
+
+		if (!sha256.Update(tgi, sizeof(tgi))
+			|| !sha256.Update(data.data(), data.size())
+			|| !sha256.Finish(extent.digest))
+		{
+			logger.WriteLine(LogLevel::Error, "Failed to hash a DBPF entry.");
+			RemoveObjects(newObjects);
+			return false;
+		}
+
+		if (!objectReferenceCounts.contains(extent.digest) && !newObjects.contains(extent.digest))
+		{
+			const std::filesystem::path objectPath = GetObjectPath(extent.digest);
+
+			std::error_code ec;
+			std::filesystem::create_directories(objectPath.parent_path(), ec);
+
+			if (ec || !WriteFileAtomic(objectPath, data.data(), data.size()))
+			{
+				logger.WriteLineFormatted(
+					LogLevel::Error,
+					"Failed to write the backup object: %s",
+					objectPath.string().c_str());
+				RemoveObjects(newObjects);
+				return false;
+			}
+
+			newObjects.insert(extent.digest);
+			bytesWritten += extent.size;
+		}
+	}
+
+	const uint64_t fileSize = reader.GetFileSize();
+	reader.Close();
+
+	// Two saves in the same second would have the same generation name, the
+	// later generation is given a suffix instead of replacing the manifest.
+	std::string uniqueGenerationName = generationName;
+
+	for (int suffix = 2; std::binary_search(generations.begin(), generations.end(), uniqueGenerationName); suffix++)
+	{
+		uniqueGenerationName = generationName + "-" + std::to_string(suffix);
+	}
+
+	if (!WriteManifest(GetManifestPath(uniqueGenerationName), fileSize, extents))
+	{
+		logger.WriteLine(LogLevel::Error, "Failed to write the backup generation manifest.");
+		RemoveObjects(newObjects);
+		return false;
+	}
+
+	for (const ManifestExtent& extent : extents)
+	{
+		objectReferenceCounts[extent.digest]++;
+	}
+
+	generations.push_back(uniqueGenerationName);
+	std::sort(generations.begin(), generations.end());
+
+	logger.WriteLineFormatted(
+		LogLevel::Info,
+		"Deduplicated backup %s: %zu of %zu extents were new, %llu bytes written.",
+		uniqueGenerationName.c_str(),
+		newObjects.size(),
+		extents.size(),
+		bytesWritten);
+
+	return true;
+}
+
+void DeduplicatingBackupStore::CollectGarbage(size_t maxGenerations)
+{
+	Logger& logger = Logger::GetInstance();
+
+	size_t removedGenerations = 0;
+	size_t removedObjects = 0;
+
+	while (generations.size() > maxGenerations)
+	{
+		const std::filesystem::path manifestPath = GetManifestPath(generations.front());
+
+		uint64_t fileSize = 0;
+		std::vector<ManifestExtent> extents;
+
+		if (ReadManifest(manifestPath, fileSize, extents))
+		{
+			for (const ManifestExtent& extent : extents)
+			{
+				auto it = objectReferenceCounts.find(extent.digest);
+
+				if (it != objectReferenceCounts.end())
+				{
+					if (--it->second == 0)
+					{
+						std::error_code ec;
+						std::filesystem::remove(GetObjectPath(extent.digest), ec);
+						objectReferenceCounts.erase(it);
+						removedObjects++;
+					}
+				}
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::remove(manifestPath, ec);
+
+		generations.erase(generations.begin());
+		removedGenerations++;
+	}
+
+	if (removedGenerations > 0)
+	{
+		logger.WriteLineFormatted(
+			LogLevel::Info,
+			"Removed %zu backup generation(s) and %zu unreferenced object(s).",
+			removedGenerations,
+			removedObjects);
+	}
+}
+
+std::string DeduplicatingBackupStore::GetNewestGeneration(const std::filesystem::path& folder)
+{
+	if (!LoadStore(folder) || generations.empty())
+	{
+		return std::string();
+	}
+
+	return generations.back();
+}
+
+bool DeduplicatingBackupStore::RestoreGeneration(
+	const std::filesystem::path& folder,
+	const std::string& generationName,
+	const std::filesystem::path& destination)
+{
+	Logger& logger = Logger::GetInstance();
+
+	if (!LoadStore(folder))
+	{
+		return false;
+	}
+
+	uint64_t fileSize = 0;
+	std::vector<ManifestExtent> extents;
+
+	if (!ReadManifest(GetManifestPath(generationName), fileSize, extents))
+	{
+		logger.WriteLineFormatted(LogLevel::Error, "Failed to read the manifest for %s.", generationName.c_str());
+		return false;
+	}
+
+	std::filesystem::path tempPath = destination;
+	tempPath += ".tmp";
+
+	bool result = true;
+
+	{
+		std::ofstream output(tempPath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+		if (!output)
+		{
+			logger.WriteLine(LogLevel::Error, "Failed to create the restored save file.");
+			return false;
+		}
+
+		std::vector<char> buffer;
+		uint64_t position = 0;
+
+		for (const ManifestExtent& extent : extents)
+		{
+			if (extent.offset != position)
+			{
+				logger.WriteLine(LogLevel::Error, "The backup manifest does not cover the whole file.");
+				result = false;
+				break;
+			}
+
+			std::ifstream object(GetObjectPath(extent.digest), std::ifstream::in | std::ifstream::binary);
+
+			buffer.resize(extent.size);
+
+			if (!object || !object.read(buffer.data(), buffer.size()))
+			{
+				logger.WriteLineFormatted(
+					LogLevel::Error,
+					"The backup object %s is missing or damaged.",
+					extent.digest.ToString().c_str());
+				result = false;
+				break;
+			}
+
+			output.write(buffer.data(), buffer.size());
+			position += extent.size;
+		}
+
+		if (result && (position != fileSize || !output))
+		{
+			logger.WriteLine(LogLevel::Error, "Failed to write the restored save file.");
+			result = false;
+		}
+	}
+
+	std::error_code ec;
+
+	if (result)
+	{
+		std::filesystem::rename(tempPath, destination, ec);
+		result = !ec;
+	}
+	else
+	{
+		std::filesystem::remove(tempPath, ec);
+	}
+
+	return result;
+}
+
+bool DeduplicatingBackupStore::LoadStore(const std::filesystem::path& folder)
+{
+	if (storeFolder == folder)
+	{
+		return true;
+	}
+
+	storeFolder.clear();
+	generations.clear();
+	objectReferenceCounts.clear();
+
+	std::error_code ec;
+	std::filesystem::create_directories(folder / ObjectsFolderName, ec);
+
+	if (!ec)
+	{
+		std::filesystem::create_directories(folder / GenerationsFolderName, ec);
+	}
+
+	if (ec)
+	{
+		Logger::GetInstance().WriteLineFormatted(
+			LogLevel::Error,
+			"Failed to create the backup store folders: %s",
+			ec.message().c_str());
+		return false;
+	}
+
+	// The reference counts are rebuilt from the generation manifests, this
+	// only reads the generations folder and never scans the object folders.
+	// The error_code overloads are used because this runs on a background thread.
+	std::filesystem::directory_iterator it(folder / GenerationsFolderName, ec);
+
+	for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+	{
+		const std::filesystem::path& path = it->path();
+		std::error_code typeError;
+
+		if (it->is_regular_file(typeError) && path.extension() == ManifestExtension)
+		{
+			uint64_t fileSize = 0;
+			std::vector<ManifestExtent> extents;
+
+			if (ReadManifest(path, fileSize, extents))
+			{
+				for (const ManifestExtent& extent : extents)
+				{
+					objectReferenceCounts[extent.digest]++;
+				}
+
+				generations.push_back(path.stem().string());
+			}
+			else
+			{
+				Logger::GetInstance().WriteLineFormatted(
+					LogLevel::Error,
+					"Ignoring the invalid backup manifest: %s",
+					path.filename().string().c_str());
+			}
+		}
+	}
+
+	std::sort(generations.begin(), generations.end());
+	storeFolder = folder;
+
+	return true;
+}
+
+void DeduplicatingBackupStore::RemoveObjects(const std::unordered_set<Sha256Digest, Sha256DigestHasher>& objects) const
+{
+	// The objects that were written for a generation that could not be added are not
+	// referenced by any manifest, the garbage collection would never delete them.
+	for (const Sha256Digest& digest : objects)
+	{
+		std::error_code ec;
+		std::filesystem::remove(GetObjectPath(digest), ec);
+	}
+}
+
+std::filesystem::path DeduplicatingBackupStore::GetObjectPath(const Sha256Digest& digest) const
+{
+	const std::string name = digest.ToString();
+
+	// The objects are spread over 256 sub-folders to keep the folder sizes reasonable.
+	std::filesystem::path path = storeFolder;
+	path /= ObjectsFolderName;
+	path /= name.substr(0, 2);
+	path /= name;
+
+	return path;
+}
+
+std::filesystem::path DeduplicatingBackupStore::GetManifestPath(const std::string& generationName) const
+{
+	std::filesystem::path path = storeFolder;
+	path /= GenerationsFolderName;
+	path /= generationName;
+	path += ManifestExtension;
+
+	return path;
+}
+
+bool DeduplicatingBackupStore::ReadManifest(
+	const std::filesystem::path& path,
+	uint64_t& fileSize,
+	std::vector<ManifestExtent>& extents)
+{
+	std::ifstream stream(path, std::ifstream::in | std::ifstream::binary);
+
+	if (!stream)
+	{
+		return false;
+	}
+
+	uint32_t signature = 0;
+	uint32_t version = 0;
+	uint32_t extentCount = 0;
+
+	if (!ReadValue(stream, signature)
+		|| !ReadValue(stream, version)
+		|| !ReadValue(stream, fileSize)
+		|| !ReadValue(stream, extentCount)
+		|| signature != ManifestSignature
+		|| version != ManifestVersion)
+	{
+		return false;
+	}
+
+	// A damaged manifest could otherwise make the game allocate up to 200 GB.
+	std::error_code ec;
+	const uintmax_t manifestSize = std::filesystem::file_size(path, ec);
+
+	if (ec || manifestSize < ManifestHeaderSize || static_cast<uint64_t>(extentCount) * ManifestExtentSize > manifestSize - ManifestHeaderSize)
+	{
+		return false;
+	}
+
+	extents.clear();
+	extents.reserve(extentCount);
+
+	for (uint32_t i = 0; i < extentCount; i++)
+	{
+		ManifestExtent extent{};
+
+		if (!ReadValue(stream, extent.type)
+			|| !ReadValue(stream, extent.group)
+			|| !ReadValue(stream, extent.instance)
+			|| !ReadValue(stream, extent.offset)
+			|| !ReadValue(stream, extent.size)
+			|| !stream.read(reinterpret_cast<char*>(extent.digest.bytes.data()), extent.digest.bytes.size()))
+		{
+			return false;
+		}
+
+		extents.push_back(extent);
+	}
+
+	return true;
+}
+
+bool DeduplicatingBackupStore::WriteManifest(
+	const std::filesystem::path& path,
+	uint64_t fileSize,
+	const std::vector<ManifestExtent>& extents)
+{
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream stream(tempPath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+		if (!stream)
+		{
+			return false;
+		}
+
+		WriteValue(stream, ManifestSignature);
+		WriteValue(stream, ManifestVersion);
+		WriteValue(stream, fileSize);
+		WriteValue(stream, static_cast<uint32_t>(extents.size()));
+
+		for (const ManifestExtent& extent : extents)
+		{
+			WriteValue(stream, extent.type);
+			WriteValue(stream, extent.group);
+			WriteValue(stream, extent.instance);
+			WriteValue(stream, extent.offset);
+			WriteValue(stream, extent.size);
+			stream.write(reinterpret_cast<const char*>(extent.digest.bytes.data()), extent.digest.bytes.size());
+		}
+
+		if (!stream)
+		{
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, path, ec);
+
+	return !ec;
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "Sha256.h"
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A content-addressed backup store for the DBPF entries of a city's save file.
+//
+// Each DBPF entry is stored as an object named by the SHA-256 hash of its
+// type, group, instance and data, objects that are already in the store are
+// not written again. A generation is a small manifest that lists the objects
+// in file order, the parts of the file that are not entries (the header, index
+// and any unused space) are stored as objects with a TGI of zero.
+//
+// This class is not thread-safe, it is only used from the background task thread.
+class DeduplicatingBackupStore
+{
+public:
+
+	DeduplicatingBackupStore();
+
+	// Adds the save file to the store as a new generation.
+	bool AddGeneration(
+		const std::filesystem::path& folder,
+		const std::filesystem::path& saveFilePath,
+		const std::string& generationName,
+		std::stop_token stopToken);
+
+	// Removes the oldest generations until at most maxGenerations remain, and deletes
+	// the objects that are no longer referenced by any generation.
+	void CollectGarbage(size_t maxGenerations);
+
+	// Gets the name of the newest generation in the store,
+	// or an empty string if the store does not have any generations.
+	std::string GetNewestGeneration(const std::filesystem::path& folder);
+
+	// Rebuilds the save file for the specified generation.
+	bool RestoreGeneration(
+		const std::filesystem::path& folder,
+		const std::string& generationName,
+		const std::filesystem::path& destination);
+
+private:
+
+	struct ManifestExtent
+	{
+		uint32_t type;
+		uint32_t group;
+		uint32_t instance;
+		uint32_t offset;
+		uint32_t size;
+		Sha256Digest digest;
+	};
+
+	bool LoadStore(const std::filesystem::path& folder);
+
+	void RemoveObjects(const std::unordered_set<Sha256Digest, Sha256DigestHasher>& objects) const;
+
+	std::filesystem::path GetObjectPath(const Sha256Digest& digest) const;
+
+	std::filesystem::path GetManifestPath(const std::string& generationName) const;
+
+	static bool ReadManifest(
+		const std::filesystem::path& path,
+		uint64_t& fileSize,
+		std::vector<ManifestExtent>& extents);
+
+	static bool WriteManifest(
+		const std::filesystem::path& path,
+		uint64_t fileSize,
+		const std::vector<ManifestExtent>& extents);
+
+	std::filesystem::path storeFolder;
+	// The generation names sorted from oldest to newest.
+	std::vector<std::string> generations;
+	std::unordered_map<Sha256Digest, uint32_t, Sha256DigestHasher> objectReferenceCounts;
+	Sha256 sha256;
+};
+
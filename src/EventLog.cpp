@@ -0,0 +1,313 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "EventLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <vector>
+#include <Windows.h>
+
+namespace
+{
+	// The game uses the ANSI code page for the city names and file paths,
+	// the JSON Lines file is UTF-8.
+	std::string ConvertAnsiToUtf8(std::string_view value)
+	{
+		if (value.empty() || value.size() > static_cast<size_t>(std::numeric_limits<int>::max()))
+		{
+			return std::string();
+		}
+
+		const int ansiLength = static_cast<int>(value.size());
+		const int wideLength = MultiByteToWideChar(CP_ACP, 0, value.data(), ansiLength, nullptr, 0);
+
+		if (wideLength <= 0)
+		{
+			return std::string();
+		}
+
+		std::vector<wchar_t> wide(static_cast<size_t>(wideLength));
+
+		if (MultiByteToWideChar(CP_ACP, 0, value.data(), ansiLength, wide.data(), wideLength) != wideLength)
+		{
+			return std::string();
+		}
+
+		const int utf8Length = WideCharToMultiByte(CP_UTF8, 0, wide.data(), wideLength, nullptr, 0, nullptr, nullptr);
+
+		if (utf8Length <= 0)
+		{
+			return std::string();
+		}
+
+		std::string utf8(static_cast<size_t>(utf8Length), '\0');
+
+		if (WideCharToMultiByte(CP_UTF8, 0, wide.data(), wideLength, utf8.data(), utf8Length, nullptr, nullptr) != utf8Length)
+		{
+			return std::string();
+		}
+
+		return utf8;
+	}
+
+	void AppendJsonString(std::string& json, std::string_view value)
+	{
+		json.push_back('"');
+
+		std::string utf8;
+
+		if (std::any_of(value.begin(), value.end(), [](char c) { return static_cast<unsigned char>(c) >= 0x80; }))
+		{
+			// The non-ASCII characters of a string that cannot be converted are written
+			// as question marks, the file is always valid UTF-8.
+			utf8 = ConvertAnsiToUtf8(value);
+
+			if (!utf8.empty())
+			{
+				value = utf8;
+			}
+		}
+
+		const bool isUtf8 = !utf8.empty();
+
+		for (char c : value)
+		{
+			const unsigned char ch = static_cast<unsigned char>(c);
+
+			switch (c)
+			{
+			case '"':
+				json.append("\\\"");
+				break;
+			case '\\':
+				json.append("\\\\");
+				break;
+			case '\n':
+				json.append("\\n");
+				break;
+			case '\r':
+				json.append("\\r");
+				break;
+			case '\t':
+				json.append("\\t");
+				break;
+			default:
+				if (ch < 0x20)
+				{
+					char escape[8]{};
+					std::snprintf(escape, sizeof(escape), "\\u%04x", ch);
+					json.append(escape);
+				}
+				else if (ch >= 0x80 && !isUtf8)
+				{
+					json.push_back('?');
+				}
+				else
+				{
+					json.push_back(c);
+				}
+				break;
+			}
+		}
+
+		json.push_back('"');
+	}
+
+	void AppendStringField(std::string& json, std::string_view name, std::string_view value)
+	{
+		json.append(",\"");
+		json.append(name);
+		json.append("\":");
+		AppendJsonString(json, value);
+	}
+
+	void AppendNumberField(std::string& json, std::string_view name, int64_t value)
+	{
+		json.append(",\"");
+		json.append(name);
+		json.append("\":");
+		json.append(std::to_string(value));
+	}
+
+	std::string GetUtcTimeStamp()
+	{
+		using namespace std::chrono;
+
+		const auto now = floor<seconds>(system_clock::now());
+		const auto days = floor<std::chrono::days>(now);
+		const year_month_day date(days);
+		const hh_mm_ss time(now - days);
+
+		char buffer[64]{};
+
+		std::snprintf(
+			buffer,
+			sizeof(buffer),
+			"%04d-%02u-%02uT%02d:%02d:%02dZ",
+			static_cast<int>(date.year()),
+			static_cast<unsigned>(date.month()),
+			static_cast<unsigned>(date.day()),
+			static_cast<int>(time.hours().count()),
+			static_cast<int>(time.minutes().count()),
+			static_cast<int>(time.seconds().count()));
+
+		return std::string(buffer);
+	}
+}
+
+EventLog& EventLog::GetInstance()
+{
+	static EventLog eventLog;
+
+	return eventLog;
+}
+
+EventLog::EventLog()
+	: initialized(false),
+	  filePath(),
+	  maxFileBytes(0),
+	  currentFileBytes(0),
+	  file(),
+	  mutex()
+{
+}
+
+void EventLog::Init(const std::filesystem::path& path, uint64_t maxTotalBytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (initialized || maxTotalBytes == 0)
+	{
+		return;
+	}
+
+	filePath = path;
+	maxFileBytes = maxTotalBytes / FileCount;
+
+	std::error_code ec;
+	const uintmax_t existingSize = std::filesystem::file_size(filePath, ec);
+	currentFileBytes = ec ? 0 : static_cast<uint64_t>(existingSize);
+
+	// Unlike the plugin log, the event log is not truncated when the game starts.
+	file.open(filePath, std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+
+	initialized = static_cast<bool>(file);
+}
+
+bool EventLog::IsEnabled() const
+{
+	return initialized;
+}
+
+void EventLog::Write(const EventRecord& record)
+{
+	if (!initialized)
+	{
+		return;
+	}
+
+	std::string line;
+	line.reserve(256);
+
+	line.append("{\"time\":");
+	AppendJsonString(line, GetUtcTimeStamp());
+	AppendStringField(line, "event", record.event);
+
+	if (!record.city.empty())
+	{
+		AppendStringField(line, "city", record.city);
+	}
+
+	if (!record.simDate.empty())
+	{
+		AppendStringField(line, "simDate", record.simDate);
+	}
+
+	if (record.durationMilliseconds >= 0)
+	{
+		AppendNumberField(line, "durationMs", record.durationMilliseconds);
+	}
+
+	if (record.deferredMilliseconds >= 0)
+	{
+		AppendNumberField(line, "deferredMs", record.deferredMilliseconds);
+	}
+
+	if (record.bytes >= 0)
+	{
+		AppendNumberField(line, "bytes", record.bytes);
+	}
+
+	if (!record.result.empty())
+	{
+		AppendStringField(line, "result", record.result);
+	}
+
+	if (!record.detail.empty())
+	{
+		AppendStringField(line, "detail", record.detail);
+	}
+
+	line.append("}\n");
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (currentFileBytes > 0 && currentFileBytes + line.size() > maxFileBytes)
+	{
+		Rotate();
+	}
+
+	if (file)
+	{
+		file.write(line.data(), static_cast<std::streamsize>(line.size()));
+		// The events are infrequent, each one is flushed so that it is not lost if the game crashes.
+		file.flush();
+		currentFileBytes += line.size();
+	}
+}
+
+std::filesystem::path EventLog::GetRotatedFilePath(int index) const
+{
+	// SC4AutoSave.events.jsonl becomes SC4AutoSave.events.1.jsonl
+	std::filesystem::path path = filePath.parent_path();
+	path /= filePath.stem();
+	path += ".";
+	path += std::to_string(index);
+	path += filePath.extension();
+
+	return path;
+}
+
+void EventLog::Rotate()
+{
+	file.close();
+
+	std::error_code ec;
+	std::filesystem::remove(GetRotatedFilePath(FileCount - 1), ec);
+
+	for (int i = FileCount - 2; i >= 1; i--)
+	{
+		const std::filesystem::path source = GetRotatedFilePath(i);
+
+		if (std::filesystem::exists(source, ec))
+		{
+			std::filesystem::rename(source, GetRotatedFilePath(i + 1), ec);
+		}
+	}
+
+	std::filesystem::rename(filePath, GetRotatedFilePath(1), ec);
+
+	file.open(filePath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+	currentFileBytes = 0;
+}
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+struct EventRecord
+{
+	// The event name, e.g. save or verify.
+	std::string_view event;
+	std::string city;
+	std::string simDate;
+	// The optional fields are omitted when they are negative or empty.
+	int64_t durationMilliseconds = -1;
+	int64_t deferredMilliseconds = -1;
+	int64_t bytes = -1;
+	// ok or failed.
+	std::string_view result;
+	std::string detail;
+};
+
+// Writes the auto-save events to a JSON Lines file that is kept across sessions.
+//
+// Each line is a JSON object with the UTC time and the fields of an EventRecord.
+// When the file reaches its size limit it is renamed and a new file is started,
+// the oldest file is deleted so that the files never use more than the total size
+// limit. The class is thread-safe, the background tasks also write events.
+class EventLog
+{
+public:
+
+	static EventLog& GetInstance();
+
+	// Opens the event log for appending, a maxTotalBytes value of 0 disables the log.
+	void Init(const std::filesystem::path& path, uint64_t maxTotalBytes);
+
+	bool IsEnabled() const;
+
+	void Write(const EventRecord& record);
+
+private:
+
+	static constexpr int FileCount = 5;
+
+	EventLog();
+
+	std::filesystem::path GetRotatedFilePath(int index) const;
+
+	void Rotate();
+
+	bool initialized;
+	std::filesystem::path filePath;
+	uint64_t maxFileBytes;
+	uint64_t currentFileBytes;
+	std::ofstream file;
+	std::mutex mutex;
+};
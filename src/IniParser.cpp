@@ -0,0 +1,396 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "IniParser.h"
+#include <algorithm>
+#include <bitset>
+#include <charconv>
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+	bool IsWhiteSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+	}
+
+	std::string_view Trim(std::string_view value)
+	{
+		while (!value.empty() && IsWhiteSpace(value.front()))
+		{
+			value.remove_prefix(1);
+		}
+
+		while (!value.empty() && IsWhiteSpace(value.back()))
+		{
+			value.remove_suffix(1);
+		}
+
+		return value;
+	}
+
+	bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			char x = a[i];
+			char y = b[i];
+
+			if (x >= 'A' && x <= 'Z')
+			{
+				x = static_cast<char>(x - 'A' + 'a');
+			}
+
+			if (y >= 'A' && y <= 'Z')
+			{
+				y = static_cast<char>(y - 'A' + 'a');
+			}
+
+			if (x != y)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void AddError(std::string& errors, size_t lineNumber, const char* format, ...)
+	{
+		char buffer[512]{};
+
+		if (lineNumber > 0)
+		{
+			std::snprintf(buffer, sizeof(buffer), "Line %zu: ", lineNumber);
+			errors.append(buffer);
+		}
+
+		va_list args;
+		va_start(args, format);
+
+		std::vsnprintf(buffer, sizeof(buffer), format, args);
+
+		va_end(args);
+
+		errors.append(buffer);
+		errors.push_back('\n');
+	}
+
+	bool ParseBool(std::string_view text, bool& value)
+	{
+		if (EqualsIgnoreCase(text, "true") || text == "1")
+		{
+			value = true;
+			return true;
+		}
+		else if (EqualsIgnoreCase(text, "false") || text == "0")
+		{
+			value = false;
+			return true;
+		}
+
+		return false;
+	}
+
+	template<typename T>
+	bool ParseNumber(std::string_view text, T& value)
+	{
+		if (!text.empty() && text.front() == '+')
+		{
+			text.remove_prefix(1);
+		}
+
+		const char* const end = text.data() + text.size();
+		const std::from_chars_result result = std::from_chars(text.data(), end, value);
+
+		return result.ec == std::errc() && result.ptr == end;
+	}
+
+	// Returns false if the value cannot be parsed, the range is checked separately.
+	bool ParseValue(const IniKeyDefinition& key, std::string_view text, double& numericValue)
+	{
+		if (bool* const* pBool = std::get_if<bool*>(&key.value))
+		{
+			return ParseBool(text, **pBool);
+		}
+		else if (int* const* pInt = std::get_if<int*>(&key.value))
+		{
+			int value = 0;
+
+			if (!ParseNumber(text, value))
+			{
+				return false;
+			}
+
+			**pInt = value;
+			numericValue = value;
+		}
+		else if (double* const* pDouble = std::get_if<double*>(&key.value))
+		{
+			double value = 0;
+
+			if (!ParseNumber(text, value))
+			{
+				return false;
+			}
+
+			**pDouble = value;
+			numericValue = value;
+		}
+		else if (std::string* const* pString = std::get_if<std::string*>(&key.value))
+		{
+			(*pString)->assign(text);
+		}
+		else if (std::filesystem::path* const* pPath = std::get_if<std::filesystem::path*>(&key.value))
+		{
+			**pPath = std::filesystem::path(text);
+		}
+
+		return true;
+	}
+
+	bool IsNumeric(const IniKeyDefinition& key)
+	{
+		return std::holds_alternative<int*>(key.value) || std::holds_alternative<double*>(key.value);
+	}
+
+	const char* GetTypeName(const IniKeyDefinition& key)
+	{
+		if (std::holds_alternative<bool*>(key.value))
+		{
+			return "true or false";
+		}
+		else if (std::holds_alternative<int*>(key.value))
+		{
+			return "a whole number";
+		}
+		else
+		{
+			return "a number";
+		}
+	}
+}
+
+bool IniParser::SetDefaults(std::span<const IniKeyDefinition> schema)
+{
+	bool result = true;
+
+	for (const IniKeyDefinition& key : schema)
+	{
+		double numericValue = 0;
+
+		if (!ParseValue(key, key.defaultValue, numericValue))
+		{
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+bool IniParser::ParseSection(
+	std::string_view text,
+	std::string_view sectionName,
+	std::span<const IniKeyDefinition> schema,
+	std::string& errors)
+{
+	if (schema.size() > MaxKeyCount)
+	{
+		AddError(errors, 0, "The %.*s section has too many keys.", static_cast<int>(sectionName.size()), sectionName.data());
+		return false;
+	}
+
+	// Skip the UTF-8 byte order mark.
+	if (text.starts_with("\xEF\xBB\xBF"))
+	{
+		text.remove_prefix(3);
+	}
+
+	std::bitset<MaxKeyCount> keysSeen;
+	bool inSection = false;
+	bool foundSection = false;
+	size_t lineNumber = 0;
+	const size_t errorsLength = errors.size();
+
+	while (!text.empty())
+	{
+		const size_t lineEnd = text.find('\n');
+		const std::string_view line = Trim(text.substr(0, lineEnd));
+
+		text.remove_prefix(lineEnd == std::string_view::npos ? text.size() : lineEnd + 1);
+		lineNumber++;
+
+		if (line.empty() || line.front() == ';' || line.front() == '#')
+		{
+			continue;
+		}
+
+		if (line.front() == '[')
+		{
+			if (line.back() != ']')
+			{
+				AddError(errors, lineNumber, "The section name %.*s is missing the closing bracket.", static_cast<int>(line.size()), line.data());
+				inSection = false;
+				continue;
+			}
+
+			inSection = Trim(line.substr(1, line.size() - 2)) == sectionName;
+
+			if (inSection)
+			{
+				if (foundSection)
+				{
+					AddError(errors, lineNumber, "The %.*s section appears more than once.", static_cast<int>(sectionName.size()), sectionName.data());
+				}
+
+				foundSection = true;
+			}
+
+			continue;
+		}
+
+		if (!inSection)
+		{
+			continue;
+		}
+
+		const size_t separator = line.find('=');
+
+		if (separator == std::string_view::npos)
+		{
+			AddError(errors, lineNumber, "%.*s is not a key=value pair.", static_cast<int>(line.size()), line.data());
+			continue;
+		}
+
+		const std::string_view name = Trim(line.substr(0, separator));
+		const std::string_view value = Trim(line.substr(separator + 1));
+
+		size_t keyIndex = 0;
+
+		while (keyIndex < schema.size() && schema[keyIndex].name != name)
+		{
+			keyIndex++;
+		}
+
+		if (keyIndex == schema.size())
+		{
+			AddError(errors, lineNumber, "%.*s is not a recognized setting.", static_cast<int>(name.size()), name.data());
+			continue;
+		}
+
+		if (keysSeen.test(keyIndex))
+		{
+			AddError(errors, lineNumber, "%.*s appears more than once.", static_cast<int>(name.size()), name.data());
+			continue;
+		}
+
+		keysSeen.set(keyIndex);
+
+		const IniKeyDefinition& key = schema[keyIndex];
+		double numericValue = 0;
+
+		if (!ParseValue(key, value, numericValue))
+		{
+			AddError(
+				errors,
+				lineNumber,
+				"The %.*s value must be %s.",
+				static_cast<int>(name.size()),
+				name.data(),
+				GetTypeName(key));
+		}
+		else if (IsNumeric(key) && (numericValue < key.minimum || numericValue > key.maximum))
+		{
+			if (std::holds_alternative<int*>(key.value))
+			{
+				AddError(
+					errors,
+					lineNumber,
+					"The %.*s value must be between %.0f and %.0f.",
+					static_cast<int>(name.size()),
+					name.data(),
+					key.minimum,
+					key.maximum);
+			}
+			else
+			{
+				AddError(
+					errors,
+					lineNumber,
+					"The %.*s value must be between %g and %g.",
+					static_cast<int>(name.size()),
+					name.data(),
+					key.minimum,
+					key.maximum);
+			}
+		}
+	}
+
+	if (!foundSection)
+	{
+		AddError(errors, 0, "The %.*s section is missing.", static_cast<int>(sectionName.size()), sectionName.data());
+	}
+
+	return errors.size() == errorsLength;
+}
+
+void IniParser::GetSectionNames(std::string_view text, std::vector<std::string_view>& names)
+{
+	while (!text.empty())
+	{
+		const size_t lineEnd = text.find('\n');
+		const std::string_view line = Trim(text.substr(0, lineEnd));
+
+		text.remove_prefix(lineEnd == std::string_view::npos ? text.size() : lineEnd + 1);
+
+		if (line.size() >= 2 && line.front() == '[' && line.back() == ']')
+		{
+			const std::string_view name = Trim(line.substr(1, line.size() - 2));
+
+			if (std::find(names.begin(), names.end(), name) == names.end())
+			{
+				names.push_back(name);
+			}
+		}
+	}
+}
+
+bool IniParser::ReadFile(const std::filesystem::path& path, std::string& text)
+{
+	std::ifstream stream(path, std::ifstream::in | std::ifstream::binary);
+
+	if (!stream)
+	{
+		return false;
+	}
+
+	stream.seekg(0, std::ios::end);
+	const std::streamoff length = stream.tellg();
+	stream.seekg(0, std::ios::beg);
+
+	if (length < 0)
+	{
+		return false;
+	}
+
+	text.resize(static_cast<size_t>(length));
+	stream.read(text.data(), length);
+
+	return stream.gcount() == length;
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// The value that an INI key is written to, the pointer type determines how the value is parsed.
+using IniValuePointer = std::variant<bool*, int*, double*, std::string*, std::filesystem::path*>;
+
+// Describes a key in an INI section.
+// The minimum and maximum are inclusive and only apply to numeric values.
+struct IniKeyDefinition
+{
+	std::string_view name;
+	IniValuePointer value;
+	std::string_view defaultValue;
+	double minimum;
+	double maximum;
+};
+
+// A single-pass parser for the keys in one section of an INI file.
+//
+// The text is parsed in place, the only memory that is allocated is for
+// the string values and the error messages. Parsing continues after an error
+// so that every problem in the file is reported at once, each error starts
+// with the line number.
+class IniParser
+{
+public:
+
+	// The largest number of keys that can be in a schema.
+	static constexpr size_t MaxKeyCount = 64;
+
+	// Sets each value to its default.
+	static bool SetDefaults(std::span<const IniKeyDefinition> schema);
+
+	// Parses the keys in the specified section, the other sections are ignored.
+	// Keys that are not in the file keep their current value.
+	// Returns false if any errors were found, the errors are separated by new lines.
+	static bool ParseSection(
+		std::string_view text,
+		std::string_view sectionName,
+		std::span<const IniKeyDefinition> schema,
+		std::string& errors);
+
+	// Gets the name of each section in the text, a section that appears more than once is only listed once.
+	// The names refer to the text and are only valid while it is unchanged.
+	static void GetSectionNames(std::string_view text, std::vector<std::string_view>& names);
+
+	// Reads the file into the text buffer.
+	static bool ReadFile(const std::filesystem::path& path, std::string& text);
+};
@@ -0,0 +1,32 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "LocalTime.h"
+
+// The FILETIME epoch is January 1, 1601 and it uses 100 nanosecond units.
+static constexpr int64_t UnixEpochInFileTimeUnits = 116444736000000000LL;
+static constexpr int64_t FileTimeUnitsPerSecond = 10000000LL;
+
+bool UnixTimeToLocalTime(int64_t unixSeconds, SYSTEMTIME& localTime)
+{
+	ULARGE_INTEGER value{};
+	value.QuadPart = static_cast<ULONGLONG>((unixSeconds * FileTimeUnitsPerSecond) + UnixEpochInFileTimeUnits);
+
+	FILETIME fileTime{};
+	fileTime.dwLowDateTime = value.LowPart;
+	fileTime.dwHighDateTime = value.HighPart;
+
+	SYSTEMTIME systemTime{};
+
+	return FileTimeToSystemTime(&fileTime, &systemTime)
+		&& SystemTimeToTzSpecificLocalTime(nullptr, &systemTime, &localTime);
+}
@@ -0,0 +1,18 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <Windows.h>
+
+// Converts a time in seconds since the Unix epoch to the local time zone.
+bool UnixTimeToLocalTime(int64_t unixSeconds, SYSTEMTIME& localTime);
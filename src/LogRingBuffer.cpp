@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "LogRingBuffer.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+LogRingBuffer::LogRingBuffer(size_t capacity)
+	: slots(),
+	  mask(0),
+	  enqueuePosition(0),
+	  dequeuePosition(0)
+{
+	const size_t slotCount = std::bit_ceil(std::max<size_t>(capacity, 2));
+
+	slots = std::make_unique<Slot[]>(slotCount);
+	mask = slotCount - 1;
+
+	for (size_t i = 0; i < slotCount; i++)
+	{
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+bool LogRingBuffer::TryPush(int64_t timestamp, uint32_t level, const char* text, size_t length)
+{
+	Slot* slot = nullptr;
+	size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		slot = &slots[position & mask];
+
+		const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+		if (difference == 0)
+		{
+			if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The slot has not been consumed since the previous lap, the queue is full.
+			return false;
+		}
+		else
+		{
+			position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	LogRecord& record = slot->record;
+
+	record.timestamp = timestamp;
+	record.level = level;
+	record.length = static_cast<uint32_t>(std::min(length, LogRecord::MaxTextLength));
+	std::memcpy(record.text, text, record.length);
+
+	slot->sequence.store(position + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool LogRingBuffer::IsEmpty() const
+{
+	const size_t position = dequeuePosition.load(std::memory_order_relaxed);
+	const size_t sequence = slots[position & mask].sequence.load(std::memory_order_acquire);
+
+	return sequence != position + 1;
+}
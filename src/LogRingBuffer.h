@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+struct LogRecord
+{
+	static constexpr size_t MaxTextLength = 1024 - 16;
+
+	// The time that the record was written, in seconds since the Unix epoch.
+	int64_t timestamp;
+	uint32_t level;
+	uint32_t length;
+	char text[MaxTextLength];
+};
+
+// A bounded lock-free queue of log records.
+//
+// Any number of threads can add records, a single writer thread removes them.
+// The records are stored in a fixed array of slots that is allocated once, each
+// slot has a sequence number that tells the producers and the consumer whether
+// the slot is free or filled, this is the design from Dmitry Vyukov's bounded
+// MPMC queue. A producer never waits, TryPush fails if the queue is full.
+class LogRingBuffer
+{
+public:
+
+	// The capacity is rounded up to a power of 2.
+	explicit LogRingBuffer(size_t capacity);
+
+	LogRingBuffer(const LogRingBuffer&) = delete;
+	LogRingBuffer& operator=(const LogRingBuffer&) = delete;
+
+	// Adds a record, text that is longer than LogRecord::MaxTextLength is truncated.
+	// Returns false if the queue is full.
+	bool TryPush(int64_t timestamp, uint32_t level, const char* text, size_t length);
+
+	// Removes the oldest record and passes it to the specified function.
+	// Returns false if the queue is empty.
+	template<typename Func> bool TryConsume(Func&& func)
+	{
+		Slot* slot = nullptr;
+		size_t position = dequeuePosition.load(std::memory_order_relaxed);
+
+		for (;;)
+		{
+			slot = &slots[position & mask];
+
+			const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+			if (difference == 0)
+			{
+				if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		func(static_cast<const LogRecord&>(slot->record));
+
+		// Mark the slot as free for the producer that will wrap around to it.
+		slot->sequence.store(position + mask + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool IsEmpty() const;
+
+private:
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		LogRecord record;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+	// The producer and consumer positions are on separate cache lines.
+	alignas(64) std::atomic<size_t> enqueuePosition;
+	alignas(64) std::atomic<size_t> dequeuePosition;
+};
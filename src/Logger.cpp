@@ -11,18 +11,28 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "Logger.h"
+#include "LocalTime.h"
+#include <chrono>
+#include <cstring>
+#include <thread>
 #include <Windows.h>
 
+// The queue holds 256 messages of up to 1 KB, about 256 KB in total.
+static constexpr size_t AsyncQueueCapacity = 256;
+
+// The file is flushed at most once per second unless an error message is written.
+static constexpr DWORD FlushIntervalInMilliseconds = 1000;
+
 namespace
 {
-	std::string GetTimeStamp()
+	std::string GetTimeStamp(const SYSTEMTIME* pTime = nullptr)
 	{
 		char buffer[1024]{};
 
 		GetTimeFormatA(
 			LOCALE_USER_DEFAULT,
 			0,
-			nullptr,
+			pTime,
 			nullptr,
 			buffer,
 			_countof(buffer));
@@ -38,6 +48,12 @@ namespace
 		return time;
 	}
 
+	int64_t GetUnixTimeSeconds()
+	{
+		return std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
 #ifdef _DEBUG
 	void PrintLineToDebugOutput(const char* timeStamp, const char* line)
 	{
@@ -55,12 +71,27 @@ Logger& Logger::GetInstance()
     return logger;
 }
 
-Logger::Logger() : initialized(false), logFile(), logLevel(LogLevel::Error)
+Logger::Logger()
+	: initialized(false),
+	  logFile(),
+	  logLevel(LogLevel::Error),
+	  writeMutex(),
+	  asyncQueue(),
+	  asyncEnabled(false),
+	  stopWriter(false),
+	  writerSleeping(false),
+	  droppedMessageCount(0),
+	  activeProducerCount(0),
+	  wakeEvent(nullptr),
+	  writerThread(),
+	  cachedTimeStampSecond(-1),
+	  cachedTimeStamp()
 {
 }
 
 Logger::~Logger()
 {
+	StopAsyncWriter();
 	initialized = false;
 }
 
@@ -84,6 +115,8 @@ void Logger::WriteLogFileHeader(const char* const text)
 {
 	if (initialized && logFile)
 	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+
 		logFile << text << std::endl;
 	}
 }
@@ -95,7 +128,7 @@ void Logger::WriteLine(LogLevel level, const char* const message)
 		return;
 	}
 
-	WriteLineCore(message);
+	WriteLineCore(level, message);
 }
 
 void Logger::WriteLineFormatted(LogLevel level, const char* const format, ...)
@@ -123,22 +156,235 @@ void Logger::WriteLineFormatted(LogLevel level, const char* const format, ...)
 
 		std::vsnprintf(buffer.get(), formattedStringLengthWithNull, format, args);
 
-		WriteLineCore(buffer.get());
+		WriteLineCore(level, buffer.get());
 	}
 
 	va_end(args);
 }
 
-void Logger::WriteLineCore(const char* const message)
+void Logger::StartAsyncWriter()
 {
-	if (initialized && logFile)
+	if (!initialized || !logFile || writerThread.joinable())
+	{
+		return;
+	}
+
+	wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+	if (!wakeEvent)
+	{
+		return;
+	}
+
+	asyncQueue = std::make_unique<LogRingBuffer>(AsyncQueueCapacity);
+	stopWriter = false;
+	writerSleeping = false;
+	droppedMessageCount = 0;
+	cachedTimeStampSecond = -1;
+
+	writerThread = std::thread(&Logger::WriterThreadProc, this);
+	asyncEnabled = true;
+}
+
+void Logger::StopAsyncWriter()
+{
+	if (!writerThread.joinable())
+	{
+		return;
+	}
+
+	// New messages are written synchronously while the writer thread
+	// finishes the messages that are already in the queue.
+	asyncEnabled = false;
+
+	// A caller that saw the asynchronous mode enabled may still be adding a message,
+	// the queue and event must not be released until it has finished.
+	while (activeProducerCount.load(std::memory_order_seq_cst) != 0)
+	{
+		std::this_thread::yield();
+	}
+
+	stopWriter = true;
+	SetEvent(wakeEvent);
+
+	writerThread.join();
+
+	CloseHandle(wakeEvent);
+	wakeEvent = nullptr;
+	asyncQueue.reset();
+}
+
+void Logger::WriteLineCore(LogLevel level, const char* const message)
+{
+	if (!initialized || !logFile)
 	{
-		std::string timeStamp = GetTimeStamp();
+		return;
+	}
+
+	// The count is incremented before the mode is checked, StopAsyncWriter clears the
+	// mode before it reads the count, so it either sees this call or this call sees
+	// the mode disabled.
+	activeProducerCount.fetch_add(1, std::memory_order_seq_cst);
+
+	if (asyncEnabled)
+	{
+		if (asyncQueue->TryPush(GetUnixTimeSeconds(), static_cast<uint32_t>(level), message, std::strlen(message)))
+		{
+			// The writer thread is only woken when it is waiting, the fence orders
+			// this check with the writer's check of the queue before it waits.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (writerSleeping)
+			{
+				SetEvent(wakeEvent);
+			}
+		}
+		else
+		{
+			// The queue is full, the message is dropped instead of blocking
+			// the caller. The writer reports the number of dropped messages.
+			droppedMessageCount.fetch_add(1, std::memory_order_seq_cst);
+
+			if (writerSleeping)
+			{
+				SetEvent(wakeEvent);
+			}
+		}
+
+		activeProducerCount.fetch_sub(1, std::memory_order_seq_cst);
+		return;
+	}
+
+	activeProducerCount.fetch_sub(1, std::memory_order_seq_cst);
+
+	std::string timeStamp = GetTimeStamp();
 
 #ifdef _DEBUG
-		PrintLineToDebugOutput(timeStamp.c_str(), message);
+	PrintLineToDebugOutput(timeStamp.c_str(), message);
 #endif // _DEBUG
 
-		logFile << timeStamp << message << std::endl;
+	// The background save processing threads can also write to the log.
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	logFile << timeStamp << message << std::endl;
+}
+
+void Logger::WriterThreadProc()
+{
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+	ULONGLONG lastFlushTime = GetTickCount64();
+	bool flushPending = false;
+
+	for (;;)
+	{
+		if (DrainQueue())
+		{
+			flushPending = true;
+		}
+
+		if (flushPending && (GetTickCount64() - lastFlushTime) >= FlushIntervalInMilliseconds)
+		{
+			std::lock_guard<std::mutex> lock(writeMutex);
+
+			logFile.flush();
+			lastFlushTime = GetTickCount64();
+			flushPending = false;
+		}
+
+		if (stopWriter)
+		{
+			break;
+		}
+
+		writerSleeping = true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// Check the queue again after setting the flag, a producer that added a
+		// message before it saw the flag would not have signaled the event.
+		if (asyncQueue->IsEmpty() && droppedMessageCount.load(std::memory_order_relaxed) == 0 && !stopWriter)
+		{
+			WaitForSingleObject(wakeEvent, flushPending ? FlushIntervalInMilliseconds : INFINITE);
+		}
+
+		writerSleeping = false;
 	}
-}
\ No newline at end of file
+
+	// The queue is drained again in case a message was added after the last drain.
+	DrainQueue();
+
+	std::lock_guard<std::mutex> lock(writeMutex);
+	logFile.flush();
+}
+
+bool Logger::DrainQueue()
+{
+	bool wroteMessages = false;
+	bool flushNow = false;
+
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	while (asyncQueue->TryConsume(
+		[&](const LogRecord& record)
+		{
+			const std::string& timeStamp = GetCachedTimeStamp(record.timestamp);
+
+#ifdef _DEBUG
+			std::string line(record.text, record.length);
+			PrintLineToDebugOutput(timeStamp.c_str(), line.c_str());
+#endif // _DEBUG
+
+			logFile << timeStamp;
+			logFile.write(record.text, record.length);
+			logFile << '\n';
+
+			if (record.level == static_cast<uint32_t>(LogLevel::Error))
+			{
+				flushNow = true;
+			}
+		}))
+	{
+		wroteMessages = true;
+	}
+
+	const uint32_t droppedMessages = droppedMessageCount.exchange(0, std::memory_order_relaxed);
+
+	if (droppedMessages > 0)
+	{
+		logFile << GetCachedTimeStamp(GetUnixTimeSeconds())
+			<< droppedMessages
+			<< " log message(s) were dropped because the log queue was full.\n";
+		wroteMessages = true;
+	}
+
+	// Errors are flushed immediately so that they are not lost if the game crashes.
+	if (flushNow)
+	{
+		logFile.flush();
+	}
+
+	return wroteMessages;
+}
+
+const std::string& Logger::GetCachedTimeStamp(int64_t timestamp)
+{
+	// Formatting the time is relatively expensive, the string is reused
+	// for all of the messages that were written in the same second.
+	if (timestamp != cachedTimeStampSecond)
+	{
+		SYSTEMTIME localTime{};
+
+		if (UnixTimeToLocalTime(timestamp, localTime))
+		{
+			cachedTimeStamp = GetTimeStamp(&localTime);
+		}
+		else
+		{
+			cachedTimeStamp = GetTimeStamp();
+		}
+
+		cachedTimeStampSecond = timestamp;
+	}
+
+	return cachedTimeStamp;
+}
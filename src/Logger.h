@@ -11,8 +11,14 @@
 ////////////////////////////////////////////////////////////////////////
 
 #pragma once
+#include "LogRingBuffer.h"
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 
 enum class LogLevel : int32_t
 {
@@ -38,15 +44,44 @@ public:
 
 	void WriteLineFormatted(LogLevel level, const char* const format, ...);
 
+	// Starts the asynchronous mode.
+	// The callers add the log messages to a fixed size lock-free queue and a background
+	// thread writes them to the file, messages are dropped if the queue is full.
+	void StartAsyncWriter();
+
+	// Stops the asynchronous mode, this waits until all of the queued messages
+	// have been written to the file.
+	void StopAsyncWriter();
+
 private:
 
 	Logger();
 	~Logger();
 
-	void WriteLineCore(const char* const message);
+	void WriteLineCore(LogLevel level, const char* const message);
+
+	void WriterThreadProc();
+
+	// Writes the queued messages, returns true if any messages were written.
+	bool DrainQueue();
+
+	const std::string& GetCachedTimeStamp(int64_t timestamp);
 
 	bool initialized;
 	LogLevel logLevel;
 	std::ofstream logFile;
+	std::mutex writeMutex;
+	std::unique_ptr<LogRingBuffer> asyncQueue;
+	std::atomic<bool> asyncEnabled;
+	std::atomic<bool> stopWriter;
+	std::atomic<bool> writerSleeping;
+	std::atomic<uint32_t> droppedMessageCount;
+	// The number of callers that are adding a message to the asynchronous queue.
+	std::atomic<uint32_t> activeProducerCount;
+	void* wakeEvent;
+	std::thread writerThread;
+	// Only used by the writer thread.
+	int64_t cachedTimeStampSecond;
+	std::string cachedTimeStamp;
 };
 
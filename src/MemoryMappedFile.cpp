@@ -0,0 +1,306 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "MemoryMappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	uint64_t GetAllocationGranularity()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info{};
+		GetSystemInfo(&info);
+
+		return info.dwAllocationGranularity;
+#else
+		const long pageSize = sysconf(_SC_PAGESIZE);
+
+		return pageSize > 0 ? static_cast<uint64_t>(pageSize) : 4096;
+#endif
+	}
+
+	void UnmapView(void* mappingBase, size_t mappingLength)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mappingBase);
+#else
+		munmap(mappingBase, mappingLength);
+#endif
+	}
+}
+
+MemoryMappedView::MemoryMappedView()
+	: mappingBase(nullptr),
+	  mappingLength(0),
+	  data(nullptr),
+	  length(0),
+	  valid(false)
+{
+}
+
+MemoryMappedView::MemoryMappedView(void* mappingBase, size_t mappingLength, const uint8_t* data, size_t length)
+	: mappingBase(mappingBase),
+	  mappingLength(mappingLength),
+	  data(data),
+	  length(length),
+	  valid(true)
+{
+}
+
+MemoryMappedView::~MemoryMappedView()
+{
+	Release();
+}
+
+MemoryMappedView::MemoryMappedView(MemoryMappedView&& other) noexcept
+	: mappingBase(std::exchange(other.mappingBase, nullptr)),
+	  mappingLength(std::exchange(other.mappingLength, 0)),
+	  data(std::exchange(other.data, nullptr)),
+	  length(std::exchange(other.length, 0)),
+	  valid(std::exchange(other.valid, false))
+{
+}
+
+MemoryMappedView& MemoryMappedView::operator=(MemoryMappedView&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+
+		mappingBase = std::exchange(other.mappingBase, nullptr);
+		mappingLength = std::exchange(other.mappingLength, 0);
+		data = std::exchange(other.data, nullptr);
+		length = std::exchange(other.length, 0);
+		valid = std::exchange(other.valid, false);
+	}
+
+	return *this;
+}
+
+bool MemoryMappedView::IsValid() const
+{
+	return valid;
+}
+
+std::span<const uint8_t> MemoryMappedView::GetData() const
+{
+	return std::span<const uint8_t>(data, length);
+}
+
+void MemoryMappedView::Release()
+{
+	if (mappingBase)
+	{
+		UnmapView(mappingBase, mappingLength);
+		mappingBase = nullptr;
+	}
+
+	mappingLength = 0;
+	data = nullptr;
+	length = 0;
+	valid = false;
+}
+
+MemoryMappedFile::MemoryMappedFile()
+	:
+#ifdef _WIN32
+	  fileHandle(INVALID_HANDLE_VALUE),
+	  mappingHandle(nullptr),
+#else
+	  fileDescriptor(-1),
+#endif
+	  size(0),
+	  allocationGranularity(GetAllocationGranularity())
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	Close();
+}
+
+bool MemoryMappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+#ifdef _WIN32
+	// FILE_FLAG_SEQUENTIAL_SCAN makes the cache manager read ahead more aggressively.
+	// Sharing the file for writing does not allow it to be changed while it is mapped,
+	// Windows fails those writes with ERROR_USER_MAPPED_FILE and POSIX systems raise
+	// SIGBUS when a mapped file is truncated. The caller must ensure that the file is
+	// not written while it is open, the auto-save tasks read a copy of the city file.
+	HANDLE file = CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	size = static_cast<uint64_t>(fileSize.QuadPart);
+
+	if (size > 0)
+	{
+		mappingHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!mappingHandle)
+		{
+			Close();
+			return false;
+		}
+	}
+#else
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStatus {};
+
+	if (fstat(fd, &fileStatus) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	fileDescriptor = fd;
+	size = static_cast<uint64_t>(fileStatus.st_size);
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	return true;
+}
+
+void MemoryMappedFile::Close()
+{
+#ifdef _WIN32
+	if (mappingHandle)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = nullptr;
+	}
+
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (fileDescriptor >= 0)
+	{
+		close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+#endif
+
+	size = 0;
+}
+
+bool MemoryMappedFile::IsOpen() const
+{
+#ifdef _WIN32
+	return fileHandle != INVALID_HANDLE_VALUE;
+#else
+	return fileDescriptor >= 0;
+#endif
+}
+
+uint64_t MemoryMappedFile::GetSize() const
+{
+	return size;
+}
+
+MemoryMappedView MemoryMappedFile::MapView(uint64_t offset, size_t length) const
+{
+	if (!IsOpen() || offset > size || length > size - offset)
+	{
+		return MemoryMappedView();
+	}
+
+	if (length == 0)
+	{
+		// An empty range is valid, but it does not need a mapping.
+		return MemoryMappedView(nullptr, 0, nullptr, 0);
+	}
+
+	// The start of a view must be aligned to the allocation granularity.
+	const uint64_t alignedOffset = offset - (offset % allocationGranularity);
+	const size_t offsetInView = static_cast<size_t>(offset - alignedOffset);
+	const size_t mappingLength = offsetInView + length;
+
+#ifdef _WIN32
+	void* base = MapViewOfFile(
+		mappingHandle,
+		FILE_MAP_READ,
+		static_cast<DWORD>(alignedOffset >> 32),
+		static_cast<DWORD>(alignedOffset & 0xffffffff),
+		mappingLength);
+
+	if (!base)
+	{
+		return MemoryMappedView();
+	}
+
+	// Ask the memory manager to read the view in large batches instead
+	// of faulting in each page when it is first accessed.
+	WIN32_MEMORY_RANGE_ENTRY range{};
+	range.VirtualAddress = base;
+	range.NumberOfBytes = mappingLength;
+
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	void* base = mmap(
+		nullptr,
+		mappingLength,
+		PROT_READ,
+		MAP_SHARED,
+		fileDescriptor,
+		static_cast<off_t>(alignedOffset));
+
+	if (base == MAP_FAILED)
+	{
+		return MemoryMappedView();
+	}
+
+	madvise(base, mappingLength, MADV_SEQUENTIAL);
+#endif
+
+	return MemoryMappedView(base, mappingLength, static_cast<const uint8_t*>(base) + offsetInView, length);
+}
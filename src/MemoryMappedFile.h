@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <span>
+#include <stdint.h>
+
+// A read-only view of part of a memory mapped file.
+// The data is valid until the view is destroyed.
+class MemoryMappedView
+{
+public:
+
+	MemoryMappedView();
+	MemoryMappedView(void* mappingBase, size_t mappingLength, const uint8_t* data, size_t length);
+	~MemoryMappedView();
+
+	MemoryMappedView(MemoryMappedView&& other) noexcept;
+	MemoryMappedView& operator=(MemoryMappedView&& other) noexcept;
+
+	MemoryMappedView(const MemoryMappedView&) = delete;
+	MemoryMappedView& operator=(const MemoryMappedView&) = delete;
+
+	bool IsValid() const;
+
+	std::span<const uint8_t> GetData() const;
+
+private:
+
+	void Release();
+
+	void* mappingBase;
+	size_t mappingLength;
+	const uint8_t* data;
+	size_t length;
+	bool valid;
+};
+
+// A read-only memory mapped file.
+//
+// The file is mapped as separate views instead of mapping the whole file, this
+// allows large files to be read without using a large amount of address space.
+// The game is a 32-bit process and its address space is limited.
+// The file must not be written by another program while it is open.
+class MemoryMappedFile
+{
+public:
+
+	MemoryMappedFile();
+	~MemoryMappedFile();
+
+	MemoryMappedFile(const MemoryMappedFile&) = delete;
+	MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+	// Opens the file and hints to the operating system that it will be read sequentially.
+	bool Open(const std::filesystem::path& path);
+
+	void Close();
+
+	bool IsOpen() const;
+
+	uint64_t GetSize() const;
+
+	// Maps the specified range of the file, an invalid view is returned
+	// if the range is outside of the file or the mapping fails.
+	MemoryMappedView MapView(uint64_t offset, size_t length) const;
+
+private:
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+	uint64_t size;
+	uint64_t allocationGranularity;
+};
+
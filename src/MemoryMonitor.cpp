@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "MemoryMonitor.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <cstdio>
+#include <cstring>
+#include <sys/resource.h>
+#endif
+
+// The fraction of a threshold that the usage must fall below before the monitor is re-armed,
+// this prevents a usage that hovers around the threshold from causing repeated saves.
+static constexpr double ResetMargin = 0.05;
+
+namespace
+{
+#ifndef _WIN32
+	uint64_t GetAddressSpaceSize()
+	{
+		if constexpr (sizeof(void*) == 4)
+		{
+			return 4ULL * 1024 * 1024 * 1024;
+		}
+		else
+		{
+			rlimit limit{};
+
+			if (getrlimit(RLIMIT_AS, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+			{
+				return static_cast<uint64_t>(limit.rlim_cur);
+			}
+
+			// The 47-bit user mode address space of x64 Linux.
+			return 1ULL << 47;
+		}
+	}
+#endif
+}
+
+double MemoryUsage::GetAddressSpacePercent() const
+{
+	if (addressSpaceTotalBytes == 0)
+	{
+		return 0.0;
+	}
+
+	return (static_cast<double>(addressSpaceUsedBytes) * 100.0) / static_cast<double>(addressSpaceTotalBytes);
+}
+
+MemoryMonitor::MemoryMonitor()
+	: addressSpaceThreshold(0.0),
+	  committedThreshold(0),
+	  aboveThreshold(false)
+{
+}
+
+void MemoryMonitor::SetThresholds(double addressSpacePercent, uint64_t committedBytes)
+{
+	addressSpaceThreshold = addressSpacePercent;
+	committedThreshold = committedBytes;
+}
+
+bool MemoryMonitor::IsEnabled() const
+{
+	return addressSpaceThreshold > 0.0 || committedThreshold > 0;
+}
+
+bool MemoryMonitor::GetProcessUsage(MemoryUsage& usage)
+{
+	usage = MemoryUsage{};
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS_EX counters{};
+	counters.cb = sizeof(counters);
+
+	if (!GetProcessMemoryInfo(
+		GetCurrentProcess(),
+		reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+		sizeof(counters)))
+	{
+		return false;
+	}
+
+	// The virtual memory values are for the calling process, the total is 4 GB for
+	// a large address aware 32-bit process on a 64-bit version of Windows.
+	MEMORYSTATUSEX status{};
+	status.dwLength = sizeof(status);
+
+	if (!GlobalMemoryStatusEx(&status))
+	{
+		return false;
+	}
+
+	usage.committedBytes = counters.PrivateUsage;
+	usage.addressSpaceUsedBytes = status.ullTotalVirtual - status.ullAvailVirtual;
+	usage.addressSpaceTotalBytes = status.ullTotalVirtual;
+#else
+	if (!ReadProcStatus("/proc/self/status", usage))
+	{
+		return false;
+	}
+
+	usage.addressSpaceTotalBytes = GetAddressSpaceSize();
+#endif
+
+	return true;
+}
+
+#ifndef _WIN32
+bool MemoryMonitor::ReadProcStatus(const char* path, MemoryUsage& usage)
+{
+	FILE* file = std::fopen(path, "r");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	// The values are in kB. VmSize is the size of the mapped address space,
+	// VmData is the size of the private data and is closest to the Windows commit charge.
+	bool hasSize = false;
+	bool hasData = false;
+	char line[256]{};
+
+	while (std::fgets(line, sizeof(line), file))
+	{
+		unsigned long long value = 0;
+
+		if (std::sscanf(line, "VmSize: %llu kB", &value) == 1)
+		{
+			usage.addressSpaceUsedBytes = static_cast<uint64_t>(value) * 1024;
+			hasSize = true;
+		}
+		else if (std::sscanf(line, "VmData: %llu kB", &value) == 1)
+		{
+			usage.committedBytes = static_cast<uint64_t>(value) * 1024;
+			hasData = true;
+		}
+	}
+
+	std::fclose(file);
+
+	return hasSize && hasData;
+}
+#endif
+
+bool MemoryMonitor::Update(const MemoryUsage& usage)
+{
+	if (aboveThreshold)
+	{
+		if (!IsAboveThreshold(usage, ResetMargin))
+		{
+			aboveThreshold = false;
+		}
+
+		return false;
+	}
+
+	aboveThreshold = IsAboveThreshold(usage, 0.0);
+
+	return aboveThreshold;
+}
+
+bool MemoryMonitor::IsAboveThreshold(const MemoryUsage& usage, double margin) const
+{
+	if (addressSpaceThreshold > 0.0
+		&& usage.GetAddressSpacePercent() >= addressSpaceThreshold * (1.0 - margin))
+	{
+		return true;
+	}
+
+	if (committedThreshold > 0
+		&& static_cast<double>(usage.committedBytes) >= static_cast<double>(committedThreshold) * (1.0 - margin))
+	{
+		return true;
+	}
+
+	return false;
+}
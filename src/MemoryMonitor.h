@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+
+struct MemoryUsage
+{
+	// The private memory that the process has committed.
+	uint64_t committedBytes;
+	// The part of the user mode address space that is reserved or committed.
+	uint64_t addressSpaceUsedBytes;
+	// The size of the user mode address space.
+	uint64_t addressSpaceTotalBytes;
+
+	double GetAddressSpacePercent() const;
+};
+
+// Detects when the process is close to running out of memory.
+//
+// The game is a 32-bit process, a large city can exhaust its 4 GB address space
+// long before the system runs out of memory. The usage is read from the operating
+// system when the caller samples it, it is not intended to be called every frame.
+// The monitor only reports the first sample above a threshold, it is re-armed
+// once the usage has fallen back below the threshold by a small margin.
+class MemoryMonitor
+{
+public:
+
+	MemoryMonitor();
+
+	// Sets the thresholds, a value of 0 disables that threshold.
+	void SetThresholds(double addressSpacePercent, uint64_t committedBytes);
+
+	bool IsEnabled() const;
+
+	// Reads the memory usage of the current process.
+	static bool GetProcessUsage(MemoryUsage& usage);
+
+#ifndef _WIN32
+	// Reads the committed and used address space values from a /proc/<pid>/status file,
+	// the total address space is not changed.
+	static bool ReadProcStatus(const char* path, MemoryUsage& usage);
+#endif
+
+	// Returns true if the usage has crossed a threshold since the last time it was below them.
+	bool Update(const MemoryUsage& usage);
+
+private:
+
+	bool IsAboveThreshold(const MemoryUsage& usage, double margin) const;
+
+	double addressSpaceThreshold;
+	uint64_t committedThreshold;
+	bool aboveThreshold;
+};
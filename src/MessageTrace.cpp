@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "MessageTrace.h"
+
+// The records are written in 6 KB batches.
+static constexpr size_t BufferedRecordCount = 256;
+
+namespace
+{
+	struct TraceFileHeader
+	{
+		uint32_t signature;
+		uint32_t version;
+		// The time that the trace was started, in seconds since the Unix epoch.
+		int64_t startTime;
+	};
+	static_assert(sizeof(TraceFileHeader) == 16);
+}
+
+MessageTrace& MessageTrace::GetInstance()
+{
+	static MessageTrace instance;
+
+	return instance;
+}
+
+MessageTrace::MessageTrace()
+	: file(),
+	  buffer(),
+	  startTime()
+{
+}
+
+MessageTrace::~MessageTrace()
+{
+	Close();
+}
+
+bool MessageTrace::Init(const std::filesystem::path& path)
+{
+	Close();
+
+	file.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+	if (!file)
+	{
+		return false;
+	}
+
+	TraceFileHeader header{};
+	header.signature = Signature;
+	header.version = Version;
+	header.startTime = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	buffer.reserve(BufferedRecordCount);
+	startTime = std::chrono::steady_clock::now();
+
+	return file.good();
+}
+
+void MessageTrace::Close()
+{
+	if (file.is_open())
+	{
+		Flush();
+		file.close();
+	}
+}
+
+bool MessageTrace::IsEnabled() const
+{
+	return file.is_open();
+}
+
+void MessageTrace::RecordMessage(uint32_t messageType, uint32_t data1)
+{
+	if (file.is_open())
+	{
+		TraceRecord record{};
+		record.recordType = static_cast<uint32_t>(TraceRecordType::Message);
+		record.messageType = messageType;
+		record.data1 = data1;
+
+		Write(record);
+	}
+}
+
+void MessageTrace::Record(TraceRecordType type, uint32_t data1, uint32_t value)
+{
+	if (file.is_open())
+	{
+		TraceRecord record{};
+		record.recordType = static_cast<uint32_t>(type);
+		record.data1 = data1;
+		record.value = value;
+
+		Write(record);
+
+		// The saves are written immediately so that a trace of a session
+		// that ended in a crash still has the last save.
+		if (type == TraceRecordType::SaveCompleted)
+		{
+			Flush();
+		}
+	}
+}
+
+bool MessageTrace::ReadFile(
+	const std::filesystem::path& path,
+	std::vector<TraceRecord>& records,
+	std::string& errorMessage)
+{
+	std::ifstream stream(path, std::ifstream::in | std::ifstream::binary);
+
+	if (!stream)
+	{
+		errorMessage = "Failed to open the trace file.";
+		return false;
+	}
+
+	TraceFileHeader header{};
+
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| header.signature != Signature
+		|| header.version != Version)
+	{
+		errorMessage = "The file is not a SC4AutoSave trace.";
+		return false;
+	}
+
+	records.clear();
+
+	TraceRecord record{};
+
+	while (stream.read(reinterpret_cast<char*>(&record), sizeof(record)))
+	{
+		records.push_back(record);
+	}
+
+	// A partial record at the end of the file is ignored, the game may have
+	// exited before the last batch was completely written.
+	return true;
+}
+
+void MessageTrace::Write(const TraceRecord& record)
+{
+	buffer.push_back(record);
+	buffer.back().timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - startTime).count());
+
+	if (buffer.size() >= BufferedRecordCount)
+	{
+		Flush();
+	}
+}
+
+void MessageTrace::Flush()
+{
+	if (!buffer.empty())
+	{
+		file.write(
+			reinterpret_cast<const char*>(buffer.data()),
+			static_cast<std::streamsize>(buffer.size() * sizeof(TraceRecord)));
+		file.flush();
+		buffer.clear();
+	}
+}
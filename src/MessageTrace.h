@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum class TraceRecordType : uint32_t
+{
+	// A game message, the message type and data1 are set.
+	Message = 0,
+	// The auto-save timer was started or stopped.
+	TimerStarted = 1,
+	TimerStopped = 2,
+	// An auto-save became due, the value is the save interval in milliseconds.
+	SaveDue = 3,
+	// The conditions that block a due save changed, the value is the SaveBlocker flags.
+	BlockersChanged = 4,
+	// The city was saved, data1 is 1 if the save succeeded and the value is the save time in milliseconds.
+	SaveCompleted = 5,
+	// The save interval changed, the value is the interval in milliseconds.
+	IntervalChanged = 6,
+	// A due save was skipped because the city had not changed since it was last saved.
+	SaveSkipped = 7,
+};
+
+struct TraceRecord
+{
+	// The time in microseconds since the trace was started.
+	uint64_t timestamp;
+	uint32_t recordType;
+	uint32_t messageType;
+	uint32_t data1;
+	uint32_t value;
+};
+static_assert(sizeof(TraceRecord) == 24);
+
+// Records the game messages and auto-save decisions to a compact binary file.
+//
+// The file starts with a 16 byte header followed by fixed size records, the
+// records are buffered and written in batches.
+// The trace can be replayed offline through the scheduling logic with the
+// TraceReplay tool. This class is only used from the game's main thread.
+class MessageTrace
+{
+public:
+
+	static constexpr uint32_t Signature = 0x52544153; // SATR
+	static constexpr uint32_t Version = 1;
+
+	static MessageTrace& GetInstance();
+
+	// Starts a new trace file, any existing file is replaced.
+	bool Init(const std::filesystem::path& path);
+
+	// Writes the buffered records and closes the file.
+	void Close();
+
+	bool IsEnabled() const;
+
+	void RecordMessage(uint32_t messageType, uint32_t data1);
+
+	void Record(TraceRecordType type, uint32_t data1, uint32_t value);
+
+	// Reads all of the records in a trace file.
+	static bool ReadFile(
+		const std::filesystem::path& path,
+		std::vector<TraceRecord>& records,
+		std::string& errorMessage);
+
+private:
+
+	MessageTrace();
+	~MessageTrace();
+
+	MessageTrace(const MessageTrace&) = delete;
+	MessageTrace& operator=(const MessageTrace&) = delete;
+
+	void Write(const TraceRecord& record);
+
+	void Flush();
+
+	std::ofstream file;
+	std::vector<TraceRecord> buffer;
+	std::chrono::steady_clock::time_point startTime;
+};
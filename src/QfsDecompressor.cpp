@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "QfsDecompressor.h"
+#include <cstring>
+
+// The DBPF entry starts with the compressed size, followed by the QFS header.
+static constexpr size_t QfsHeaderOffset = 4;
+
+bool QfsDecompress(std::span<const uint8_t> input, size_t expectedSize, std::vector<uint8_t>& output)
+{
+	if (input.size() < QfsHeaderOffset + 5)
+	{
+		return false;
+	}
+
+	const uint8_t* const data = input.data();
+	const size_t inputLength = input.size();
+
+	size_t inputPosition = QfsHeaderOffset;
+
+	const uint8_t flags = data[inputPosition];
+
+	// The low bit of the first byte indicates that a compressed size field follows the
+	// signature, the high bit indicates that the sizes are 4 bytes instead of 3.
+	if ((flags & 0x3E) != 0x10 || data[inputPosition + 1] != 0xFB)
+	{
+		return false;
+	}
+
+	inputPosition += 2;
+
+	const size_t sizeFieldLength = (flags & 0x80) != 0 ? 4 : 3;
+	const size_t sizeFieldCount = (flags & 0x01) != 0 ? 2 : 1;
+
+	if (inputPosition + (sizeFieldLength * sizeFieldCount) > inputLength)
+	{
+		return false;
+	}
+
+	if ((flags & 0x01) != 0)
+	{
+		inputPosition += sizeFieldLength;
+	}
+
+	// The sizes are stored in big-endian byte order.
+	size_t uncompressedSize = 0;
+
+	for (size_t i = 0; i < sizeFieldLength; i++)
+	{
+		uncompressedSize = (uncompressedSize << 8) | data[inputPosition + i];
+	}
+
+	inputPosition += sizeFieldLength;
+
+	if (uncompressedSize != expectedSize || uncompressedSize > QfsMaximumUncompressedSize)
+	{
+		return false;
+	}
+
+	output.resize(uncompressedSize);
+
+	uint8_t* const out = output.data();
+	size_t outputPosition = 0;
+
+	while (inputPosition < inputLength)
+	{
+		const uint8_t control = data[inputPosition];
+
+		size_t literalLength = 0;
+		size_t copyLength = 0;
+		size_t copyOffset = 0;
+		bool endOfStream = false;
+
+		if (control <= 0x7F)
+		{
+			if (inputPosition + 2 > inputLength)
+			{
+				return false;
+			}
+
+			const uint8_t b1 = data[inputPosition + 1];
+
+			literalLength = control & 0x03;
+			copyLength = static_cast<size_t>((control & 0x1C) >> 2) + 3;
+			copyOffset = (static_cast<size_t>(control & 0x60) << 3) + b1 + 1;
+			inputPosition += 2;
+		}
+		else if (control <= 0xBF)
+		{
+			if (inputPosition + 3 > inputLength)
+			{
+				return false;
+			}
+
+			const uint8_t b1 = data[inputPosition + 1];
+			const uint8_t b2 = data[inputPosition + 2];
+
+			literalLength = (b1 >> 6) & 0x03;
+			copyLength = static_cast<size_t>(control & 0x3F) + 4;
+			copyOffset = (static_cast<size_t>(b1 & 0x3F) << 8) + b2 + 1;
+			inputPosition += 3;
+		}
+		else if (control <= 0xDF)
+		{
+			if (inputPosition + 4 > inputLength)
+			{
+				return false;
+			}
+
+			const uint8_t b1 = data[inputPosition + 1];
+			const uint8_t b2 = data[inputPosition + 2];
+			const uint8_t b3 = data[inputPosition + 3];
+
+			literalLength = control & 0x03;
+			copyLength = (static_cast<size_t>(control & 0x0C) << 6) + b3 + 5;
+			copyOffset = (static_cast<size_t>(control & 0x10) << 12) + (static_cast<size_t>(b1) << 8) + b2 + 1;
+			inputPosition += 4;
+		}
+		else if (control <= 0xFB)
+		{
+			literalLength = (static_cast<size_t>(control & 0x1F) << 2) + 4;
+			inputPosition += 1;
+		}
+		else
+		{
+			literalLength = control & 0x03;
+			endOfStream = true;
+			inputPosition += 1;
+		}
+
+		if (literalLength > 0)
+		{
+			if (literalLength > inputLength - inputPosition || literalLength > uncompressedSize - outputPosition)
+			{
+				return false;
+			}
+
+			std::memcpy(out + outputPosition, data + inputPosition, literalLength);
+			inputPosition += literalLength;
+			outputPosition += literalLength;
+		}
+
+		if (copyLength > 0)
+		{
+			if (copyOffset > outputPosition || copyLength > uncompressedSize - outputPosition)
+			{
+				return false;
+			}
+
+			// The source and destination can overlap, which repeats the earlier bytes.
+			const uint8_t* source = out + outputPosition - copyOffset;
+
+			for (size_t i = 0; i < copyLength; i++)
+			{
+				out[outputPosition + i] = source[i];
+			}
+
+			outputPosition += copyLength;
+		}
+
+		if (endOfStream)
+		{
+			break;
+		}
+	}
+
+	return outputPosition == uncompressedSize;
+}
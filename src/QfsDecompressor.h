@@ -0,0 +1,31 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <span>
+#include <stdint.h>
+#include <vector>
+
+// Decompresses the QFS (RefPack) format that SimCity 4 uses for compressed DBPF entries.
+//
+// The input is the entry data including the 4-byte compressed size prefix that
+// precedes the QFS header in a DBPF file. The expected size is the uncompressed size
+// from the DBPF directory, the output buffer is resized to it before decompressing,
+// callers can reuse it to avoid an allocation for each entry.
+// Returns false if the uncompressed size in the QFS header does not match the expected
+// size or is larger than QfsMaximumUncompressedSize, or if the data is truncated or
+// references data outside of the output.
+bool QfsDecompress(std::span<const uint8_t> input, size_t expectedSize, std::vector<uint8_t>& output);
+
+// The largest entry that will be decompressed, the uncompressed size is read from
+// the file and a damaged file could otherwise make the game allocate up to 4 GB.
+static constexpr size_t QfsMaximumUncompressedSize = 256 * 1024 * 1024;
@@ -0,0 +1,32 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+
+// The game messages that the plugin subscribes to.
+
+static constexpr uint32_t kSC4MessageCityEstablished = 0x26D31EC4;
+static constexpr uint32_t kSC4MessagePostCityInit = 0x26d31ec1;
+static constexpr uint32_t kSC4MessagePreCityShutdown = 0x26D31EC2;
+static constexpr uint32_t kSC4MessageSimPauseChange = 0xAA7FB7E0;
+static constexpr uint32_t kSC4MessageSimHiddenPauseChange = 0x4A7FB7E2;
+static constexpr uint32_t kSC4MessageSimEmergencyPauseChange = 0x4A7FB807;
+static constexpr uint32_t kMessageTypeAppGainLoseFocus = 0x4348B111;
+// Sent by the cheat code manager when a cheat is entered, data1 is the cheat ID
+// and data2 is a cIGZString with the full cheat text.
+static constexpr uint32_t kMessageCheatIssued = 0x230E27AC;
+// Sent when a building, lot or network occupant is added to or removed from the city.
+// Sent when the simulation starts a new month.
+static constexpr uint32_t kSC4MessageSimNewMonth = 0x66956816;
+static constexpr uint32_t kSC4MessageInsertOccupant = 0x99EF1142;
+static constexpr uint32_t kSC4MessageRemoveOccupant = 0x99EF1143;
@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveController.h"
+#include "SC4Messages.h"
+
+SaveController::SaveController()
+	: scheduler(),
+	  readiness(),
+	  running(false),
+	  cityEstablished(false),
+	  pauseStoppedTimer(false),
+	  pauseEventCount(0),
+	  loseFocusEventCount(0)
+{
+}
+
+void SaveController::HandleMessage(uint32_t messageType, uint32_t data1, bool ignoreTimePaused, int64_t now)
+{
+	switch (messageType)
+	{
+	case kSC4MessagePostCityInit:
+		// We only enable auto-save after a city has been established.
+		// There is no point in running it before then.
+		if (data1 != 0)
+		{
+			cityEstablished = true;
+			StartTimer(now);
+		}
+		break;
+	case kSC4MessageCityEstablished:
+		cityEstablished = true;
+		StartTimer(now);
+		break;
+	case kSC4MessagePreCityShutdown:
+		cityEstablished = false;
+		StopTimer(now);
+		break;
+	case kSC4MessageSimPauseChange:
+	case kSC4MessageSimHiddenPauseChange:
+	case kSC4MessageSimEmergencyPauseChange:
+		if (cityEstablished)
+		{
+			PauseChanged(data1 != 0, ignoreTimePaused, now);
+		}
+		break;
+	case kMessageTypeAppGainLoseFocus:
+		if (cityEstablished)
+		{
+			FocusChanged(data1 != 0, now);
+		}
+		break;
+	}
+}
+
+void SaveController::StartTimer(int64_t now)
+{
+	if (!running)
+	{
+		scheduler.Start(now);
+		running = true;
+	}
+}
+
+void SaveController::StopTimer(int64_t now)
+{
+	if (running)
+	{
+		scheduler.Stop(now);
+		running = false;
+	}
+}
+
+bool SaveController::IsRunning() const
+{
+	return running;
+}
+
+bool SaveController::HasFocus() const
+{
+	return !readiness.IsBlockedBy(SaveBlocker::AppInBackground);
+}
+
+bool SaveController::IsGamePaused() const
+{
+	return readiness.IsBlockedBy(SaveBlocker::GamePaused);
+}
+
+SaveControllerState SaveController::GetState() const
+{
+	return SaveControllerState{ running, readiness.GetBlockers() };
+}
+
+void SaveController::SaveCompleted(int64_t saveCompletedTime)
+{
+	readiness.EndDue(saveCompletedTime);
+	scheduler.Restart(saveCompletedTime);
+}
+
+SaveScheduler& SaveController::GetScheduler()
+{
+	return scheduler;
+}
+
+const SaveScheduler& SaveController::GetScheduler() const
+{
+	return scheduler;
+}
+
+SaveReadiness& SaveController::GetReadiness()
+{
+	return readiness;
+}
+
+const SaveReadiness& SaveController::GetReadiness() const
+{
+	return readiness;
+}
+
+void SaveController::PauseChanged(bool pauseActive, bool ignoreTimePaused, int64_t now)
+{
+	if (pauseActive)
+	{
+		pauseEventCount++;
+
+		if (pauseEventCount == 1)
+		{
+			// When the game is paused we either stop the auto save timer
+			// or leave it running and suspend the auto save schedule.
+			//
+			// We never save a city when the game is paused.
+			readiness.SetBlocked(SaveBlocker::GamePaused, true, now);
+
+			// The setting is saved so that the timer is restarted when the game
+			// is resumed, even if the settings are reloaded while it is paused.
+			pauseStoppedTimer = ignoreTimePaused;
+
+			if (pauseStoppedTimer)
+			{
+				StopTimer(now);
+			}
+		}
+	}
+	else if (pauseEventCount > 0)
+	{
+		pauseEventCount--;
+
+		if (pauseEventCount == 0)
+		{
+			if (pauseStoppedTimer)
+			{
+				StartTimer(now);
+				pauseStoppedTimer = false;
+			}
+
+			readiness.SetBlocked(SaveBlocker::GamePaused, false, now);
+		}
+	}
+}
+
+void SaveController::FocusChanged(bool hasFocus, int64_t now)
+{
+	if (hasFocus)
+	{
+		if (loseFocusEventCount > 0)
+		{
+			loseFocusEventCount--;
+
+			if (loseFocusEventCount == 0)
+			{
+				readiness.SetBlocked(SaveBlocker::AppInBackground, false, now);
+			}
+		}
+	}
+	else
+	{
+		loseFocusEventCount++;
+
+		if (loseFocusEventCount == 1)
+		{
+			readiness.SetBlocked(SaveBlocker::AppInBackground, true, now);
+		}
+	}
+}
@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "SaveReadiness.h"
+#include "SaveScheduler.h"
+#include <stdint.h>
+
+// The controller state that the auto save service reacts to when it changes.
+struct SaveControllerState
+{
+	bool running;
+	uint32_t blockers;
+};
+
+// Starts and stops the auto-save timer and sets the focus and pause blockers
+// from the game's city, pause and focus messages.
+//
+// The plugin and the TraceReplay tool both use this class, so that a replay or
+// soak test makes the same decisions as the game.
+// The times are in milliseconds from an arbitrary epoch.
+class SaveController
+{
+public:
+
+	SaveController();
+
+	// Updates the timer and blockers from a game message, the other messages are ignored.
+	// The data1 value of kSC4MessagePostCityInit is 1 if the city has been established.
+	// When ignoreTimePaused is true the timer is stopped while the game is paused.
+	void HandleMessage(uint32_t messageType, uint32_t data1, bool ignoreTimePaused, int64_t now);
+
+	void StartTimer(int64_t now);
+
+	void StopTimer(int64_t now);
+
+	bool IsRunning() const;
+
+	bool HasFocus() const;
+
+	bool IsGamePaused() const;
+
+	SaveControllerState GetState() const;
+
+	// Stops recording the deferral time and starts counting a new interval,
+	// this is called after the city has been saved.
+	void SaveCompleted(int64_t saveCompletedTime);
+
+	SaveScheduler& GetScheduler();
+
+	const SaveScheduler& GetScheduler() const;
+
+	SaveReadiness& GetReadiness();
+
+	const SaveReadiness& GetReadiness() const;
+
+private:
+
+	void PauseChanged(bool pauseActive, bool ignoreTimePaused, int64_t now);
+
+	void FocusChanged(bool hasFocus, int64_t now);
+
+	SaveScheduler scheduler;
+	SaveReadiness readiness;
+	bool running;
+	bool cityEstablished;
+	bool pauseStoppedTimer;
+	int pauseEventCount;
+	int loseFocusEventCount;
+};
@@ -0,0 +1,282 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveMetricsHistory.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+static constexpr uint32_t HistorySignature = 0x48534D53; // SMSH
+static constexpr uint32_t HistoryVersion = 1;
+static constexpr std::streamoff HistoryHeaderSize = 8;
+
+static_assert(sizeof(SaveMetricsRecord) == 32, "The history file record size must not change.");
+
+namespace
+{
+	struct Percentiles
+	{
+		double p50;
+		double p95;
+		double max;
+	};
+
+	// Uses the nearest-rank method.
+	Percentiles GetPercentiles(std::vector<double>& values)
+	{
+		Percentiles result{};
+
+		if (!values.empty())
+		{
+			std::sort(values.begin(), values.end());
+
+			auto rank = [&](double percentile)
+			{
+				size_t index = static_cast<size_t>((percentile * static_cast<double>(values.size())) + 0.999999);
+
+				return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+			};
+
+			result.p50 = rank(0.5);
+			result.p95 = rank(0.95);
+			result.max = values.back();
+		}
+
+		return result;
+	}
+
+	void AppendSummarySection(std::string& summary, const char* title, std::span<const SaveMetricsRecord> records)
+	{
+		std::vector<double> saveSeconds;
+		std::vector<double> deferredSeconds;
+		std::vector<double> throughput;
+		saveSeconds.reserve(records.size());
+		deferredSeconds.reserve(records.size());
+		throughput.reserve(records.size());
+
+		for (const SaveMetricsRecord& record : records)
+		{
+			saveSeconds.push_back(static_cast<double>(record.saveMilliseconds) / 1000.0);
+			deferredSeconds.push_back(static_cast<double>(record.deferredMilliseconds) / 1000.0);
+
+			const double value = record.GetThroughput();
+
+			if (value > 0)
+			{
+				throughput.push_back(value);
+			}
+		}
+
+		const Percentiles save = GetPercentiles(saveSeconds);
+		const Percentiles deferred = GetPercentiles(deferredSeconds);
+		const Percentiles rate = GetPercentiles(throughput);
+
+		char buffer[512]{};
+
+		std::snprintf(
+			buffer,
+			sizeof(buffer),
+			"%s: %zu save(s), latest size %.1f MB\n"
+			"  Save time (s):        p50 %.2f, p95 %.2f, max %.2f\n"
+			"  Throughput (MB/s):    p50 %.1f, p95 %.1f, max %.1f\n"
+			"  Deferred (s):         p50 %.1f, p95 %.1f, max %.1f\n",
+			title,
+			records.size(),
+			static_cast<double>(records.back().fileSize) / (1024.0 * 1024.0),
+			save.p50,
+			save.p95,
+			save.max,
+			rate.p50,
+			rate.p95,
+			rate.max,
+			deferred.p50,
+			deferred.p95,
+			deferred.max);
+
+		summary.append(buffer);
+	}
+
+	// Removes a partial record that was left at the end of the file when the
+	// game exited during a write, the next record is appended after the last
+	// whole record instead of being misaligned by the partial one.
+	void TruncateToWholeRecords(const std::filesystem::path& path, uintmax_t fileSize)
+	{
+		if (fileSize < static_cast<uintmax_t>(HistoryHeaderSize))
+		{
+			return;
+		}
+
+		const uintmax_t partialSize = (fileSize - HistoryHeaderSize) % sizeof(SaveMetricsRecord);
+
+		if (partialSize != 0)
+		{
+			std::error_code ec;
+			std::filesystem::resize_file(path, fileSize - partialSize, ec);
+
+			if (ec)
+			{
+				Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to remove a partial save metrics history record.");
+			}
+		}
+	}
+}
+
+double SaveMetricsRecord::GetThroughput() const
+{
+	if (saveMilliseconds == 0)
+	{
+		return 0;
+	}
+
+	return (static_cast<double>(fileSize) / (1024.0 * 1024.0)) / (static_cast<double>(saveMilliseconds) / 1000.0);
+}
+
+SaveMetricsHistory::SaveMetricsHistory()
+	: filePath(),
+	  records(),
+	  sessionStartIndex(0)
+{
+}
+
+const std::filesystem::path& SaveMetricsHistory::GetFilePath() const
+{
+	return filePath;
+}
+
+void SaveMetricsHistory::Load(const std::filesystem::path& path)
+{
+	Reset();
+	filePath = path;
+
+	std::ifstream stream(path, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+
+	if (!stream)
+	{
+		return;
+	}
+
+	const std::streamoff fileSize = stream.tellg();
+	stream.seekg(0);
+
+	uint32_t signature = 0;
+	uint32_t version = 0;
+
+	if (fileSize < HistoryHeaderSize
+		|| !stream.read(reinterpret_cast<char*>(&signature), sizeof(signature))
+		|| !stream.read(reinterpret_cast<char*>(&version), sizeof(version))
+		|| signature != HistorySignature
+		|| version != HistoryVersion)
+	{
+		Logger::GetInstance().WriteLine(LogLevel::Error, "The save metrics history is invalid, starting a new history.");
+
+		stream.close();
+
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+		return;
+	}
+
+	const size_t recordCount = static_cast<size_t>((fileSize - HistoryHeaderSize) / sizeof(SaveMetricsRecord));
+	const size_t loadCount = std::min(recordCount, MaxLoadedRecords);
+
+	stream.seekg(HistoryHeaderSize + static_cast<std::streamoff>((recordCount - loadCount) * sizeof(SaveMetricsRecord)));
+
+	records.resize(loadCount);
+
+	if (!stream.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(loadCount * sizeof(SaveMetricsRecord))))
+	{
+		records.clear();
+	}
+
+	sessionStartIndex = records.size();
+
+	stream.close();
+
+	TruncateToWholeRecords(path, static_cast<uintmax_t>(fileSize));
+}
+
+void SaveMetricsHistory::Reset()
+{
+	filePath.clear();
+	records.clear();
+	sessionStartIndex = 0;
+}
+
+void SaveMetricsHistory::Append(const SaveMetricsRecord& record)
+{
+	records.push_back(record);
+
+	if (filePath.empty())
+	{
+		return;
+	}
+
+	std::error_code ec;
+	const uintmax_t fileSize = std::filesystem::file_size(filePath, ec);
+	const bool newFile = ec || fileSize == 0;
+
+	if (!newFile)
+	{
+		// Another game instance may have left a partial record since the history was loaded.
+		TruncateToWholeRecords(filePath, fileSize);
+	}
+
+	std::ofstream stream(filePath, std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+
+	if (stream)
+	{
+		if (newFile)
+		{
+			stream.write(reinterpret_cast<const char*>(&HistorySignature), sizeof(HistorySignature));
+			stream.write(reinterpret_cast<const char*>(&HistoryVersion), sizeof(HistoryVersion));
+		}
+
+		stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	}
+
+	if (!stream)
+	{
+		Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to write the save metrics history.");
+	}
+}
+
+size_t SaveMetricsHistory::GetSessionRecordCount() const
+{
+	return records.size() - sessionStartIndex;
+}
+
+std::span<const SaveMetricsRecord> SaveMetricsHistory::GetRecords() const
+{
+	return records;
+}
+
+std::string SaveMetricsHistory::GetSummary() const
+{
+	std::string summary;
+
+	if (GetSessionRecordCount() > 0)
+	{
+		const std::span<const SaveMetricsRecord> allRecords(records);
+
+		AppendSummarySection(summary, "This session", allRecords.subspan(sessionStartIndex));
+
+		if (sessionStartIndex > 0)
+		{
+			AppendSummarySection(summary, "All sessions", allRecords);
+		}
+
+		summary.pop_back();
+	}
+
+	return summary;
+}
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <span>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct SaveMetricsRecord
+{
+	// The time of the save in seconds since the Unix epoch.
+	int64_t timestamp;
+	uint64_t fileSize;
+	// The time that the game's SaveCity call took.
+	uint32_t saveMilliseconds;
+	// The time that the save waited after it became due.
+	uint32_t deferredMilliseconds;
+	uint32_t flags;
+	uint32_t reserved;
+
+	static constexpr uint32_t FastSaveFlag = 1 << 0;
+
+	// The save throughput in MB/s, 0 if the save time is too short to measure.
+	double GetThroughput() const;
+};
+
+// Records the performance of each auto-save for a single city.
+//
+// The records are appended to a small binary file in the city's backup folder,
+// this allows the save performance to be compared across game sessions.
+class SaveMetricsHistory
+{
+public:
+
+	SaveMetricsHistory();
+
+	const std::filesystem::path& GetFilePath() const;
+
+	// Loads the most recent records from the history file.
+	void Load(const std::filesystem::path& path);
+
+	void Reset();
+
+	// Adds a record and appends it to the history file.
+	void Append(const SaveMetricsRecord& record);
+
+	size_t GetSessionRecordCount() const;
+
+	// Gets the loaded records, sorted from oldest to newest.
+	std::span<const SaveMetricsRecord> GetRecords() const;
+
+	// Gets a multi-line summary of the save metrics for the current session and the
+	// saved history, or an empty string if there are no records for the current session.
+	std::string GetSummary() const;
+
+private:
+
+	static constexpr size_t MaxLoadedRecords = 1000;
+
+	std::filesystem::path filePath;
+	std::vector<SaveMetricsRecord> records;
+	size_t sessionStartIndex;
+};
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveProfiles.h"
+
+namespace
+{
+	// The names are compared without regard to case, matching the file system.
+	std::string GetKey(std::string_view name)
+	{
+		std::string key(name);
+
+		for (char& c : key)
+		{
+			if (c >= 'A' && c <= 'Z')
+			{
+				c = static_cast<char>(c - 'A' + 'a');
+			}
+		}
+
+		return key;
+	}
+}
+
+SaveProfiles::SaveProfiles()
+	: cityProfiles(),
+	  regionProfiles()
+{
+}
+
+bool SaveProfiles::IsEmpty() const
+{
+	return cityProfiles.empty() && regionProfiles.empty();
+}
+
+void SaveProfiles::AddCityProfile(std::string_view cityName, const SaveProfile& profile)
+{
+	cityProfiles.insert_or_assign(GetKey(cityName), profile);
+}
+
+void SaveProfiles::AddRegionProfile(std::string_view regionDirectoryName, const SaveProfile& profile)
+{
+	regionProfiles.insert_or_assign(GetKey(regionDirectoryName), profile);
+}
+
+const SaveProfile* SaveProfiles::Find(std::string_view cityName, std::string_view regionDirectoryName) const
+{
+	if (!cityName.empty() && !cityProfiles.empty())
+	{
+		const auto it = cityProfiles.find(GetKey(cityName));
+
+		if (it != cityProfiles.end())
+		{
+			return &it->second;
+		}
+	}
+
+	if (!regionDirectoryName.empty() && !regionProfiles.empty())
+	{
+		const auto it = regionProfiles.find(GetKey(regionDirectoryName));
+
+		if (it != regionProfiles.end())
+		{
+			return &it->second;
+		}
+	}
+
+	return nullptr;
+}
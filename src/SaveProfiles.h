@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// The settings that can be overridden for a city or region.
+struct SaveProfile
+{
+	// The name of the INI section, empty for the default profile.
+	std::string name;
+	int saveIntervalInMinutes;
+	bool fastSave;
+	int saveSlotCount;
+	int deduplicatedGenerationCount;
+};
+
+// The save profiles for specific cities and regions.
+//
+// The profiles are stored in hash tables keyed by the lower case name, the
+// profile is looked up once when a city is loaded.
+class SaveProfiles
+{
+public:
+
+	SaveProfiles();
+
+	bool IsEmpty() const;
+
+	void AddCityProfile(std::string_view cityName, const SaveProfile& profile);
+
+	void AddRegionProfile(std::string_view regionDirectoryName, const SaveProfile& profile);
+
+	// Finds the profile for the city, a city profile takes precedence over
+	// a profile for its region. Returns nullptr if there is no matching profile.
+	const SaveProfile* Find(std::string_view cityName, std::string_view regionDirectoryName) const;
+
+private:
+
+	std::unordered_map<std::string, SaveProfile> cityProfiles;
+	std::unordered_map<std::string, SaveProfile> regionProfiles;
+};
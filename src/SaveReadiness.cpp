@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveReadiness.h"
+
+SaveReadiness::SaveReadiness()
+	: blockers(0),
+	  due(false),
+	  dueStartTime(0),
+	  lastUpdateTime(0),
+	  nextPollTime(0),
+	  deferredTime(0),
+	  blockedTime()
+{
+}
+
+bool SaveReadiness::IsReady() const
+{
+	return blockers == 0;
+}
+
+uint32_t SaveReadiness::GetBlockers() const
+{
+	return blockers;
+}
+
+bool SaveReadiness::IsBlockedBy(SaveBlocker blocker) const
+{
+	return (blockers & static_cast<uint32_t>(blocker)) != 0;
+}
+
+void SaveReadiness::SetBlocked(SaveBlocker blocker, bool blocked, int64_t now)
+{
+	AccumulateBlockedTime(now);
+
+	if (blocked)
+	{
+		blockers |= static_cast<uint32_t>(blocker);
+	}
+	else
+	{
+		blockers &= ~static_cast<uint32_t>(blocker);
+	}
+}
+
+void SaveReadiness::SetPolledBlockers(uint32_t value, int64_t now)
+{
+	AccumulateBlockedTime(now);
+
+	blockers = (blockers & ~PolledBlockers) | (value & PolledBlockers);
+	nextPollTime = now + PollIntervalInMilliseconds;
+}
+
+bool SaveReadiness::IsPollDue(int64_t now) const
+{
+	return now >= nextPollTime;
+}
+
+void SaveReadiness::BeginDue(int64_t now)
+{
+	if (!due)
+	{
+		due = true;
+		dueStartTime = now;
+		lastUpdateTime = now;
+		deferredTime = 0;
+		blockedTime.fill(0);
+
+		// The game state is polled as soon as the save is due.
+		nextPollTime = now;
+	}
+}
+
+void SaveReadiness::EndDue(int64_t now)
+{
+	if (due)
+	{
+		AccumulateBlockedTime(now);
+		due = false;
+	}
+}
+
+bool SaveReadiness::IsDue() const
+{
+	return due;
+}
+
+int64_t SaveReadiness::GetDeferredMilliseconds(int64_t now) const
+{
+	int64_t total = deferredTime;
+
+	if (due && blockers != 0)
+	{
+		total += now - lastUpdateTime;
+	}
+
+	return total;
+}
+
+std::string SaveReadiness::GetDeferralSummary(int64_t now) const
+{
+	std::string summary;
+
+	for (size_t i = 0; i < BlockerCount; i++)
+	{
+		int64_t time = blockedTime[i];
+
+		if (due && (blockers & (1U << i)) != 0)
+		{
+			time += now - lastUpdateTime;
+		}
+
+		if (time > 0)
+		{
+			if (!summary.empty())
+			{
+				summary.append(", ");
+			}
+
+			summary.append(GetBlockerName(static_cast<SaveBlocker>(1U << i)));
+			summary.append(" ");
+			summary.append(std::to_string((time + 500) / 1000));
+			summary.append(" s");
+		}
+	}
+
+	return summary;
+}
+
+const char* SaveReadiness::GetBlockerName(SaveBlocker blocker)
+{
+	switch (blocker)
+	{
+	case SaveBlocker::AppInBackground:
+		return "game in background";
+	case SaveBlocker::GamePaused:
+		return "game paused";
+	case SaveBlocker::ModalDialog:
+		return "modal dialog";
+	case SaveBlocker::SaveDisabled:
+		return "saving disabled";
+	case SaveBlocker::NoCity:
+		return "no city";
+	case SaveBlocker::PausedByCommand:
+		return "paused by command";
+	case SaveBlocker::LowDiskSpace:
+		return "low disk space";
+	case SaveBlocker::SimulatorPaused:
+		return "simulator paused";
+	case SaveBlocker::None:
+	default:
+		return "none";
+	}
+}
+
+std::string SaveReadiness::GetBlockerNames(uint32_t value)
+{
+	std::string names;
+
+	for (size_t i = 0; i < BlockerCount; i++)
+	{
+		if ((value & (1U << i)) != 0)
+		{
+			if (!names.empty())
+			{
+				names.append(", ");
+			}
+
+			names.append(GetBlockerName(static_cast<SaveBlocker>(1U << i)));
+		}
+	}
+
+	return names;
+}
+
+void SaveReadiness::AccumulateBlockedTime(int64_t now)
+{
+	if (due)
+	{
+		const int64_t period = now - lastUpdateTime;
+
+		if (period > 0 && blockers != 0)
+		{
+			deferredTime += period;
+
+			for (size_t i = 0; i < BlockerCount; i++)
+			{
+				if ((blockers & (1U << i)) != 0)
+				{
+					blockedTime[i] += period;
+				}
+			}
+		}
+	}
+
+	lastUpdateTime = now;
+}
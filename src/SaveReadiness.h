@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <array>
+#include <stdint.h>
+#include <string>
+
+// The conditions that prevent the city from being saved.
+enum class SaveBlocker : uint32_t
+{
+	None = 0,
+	// The game window does not have focus.
+	AppInBackground = 1 << 0,
+	// The simulation is paused.
+	GamePaused = 1 << 1,
+	// A modal dialog is open.
+	ModalDialog = 1 << 2,
+	// The game has disabled saving for the current city.
+	SaveDisabled = 1 << 3,
+	// There is no city loaded.
+	NoCity = 1 << 4,
+	// The auto-saves were paused with the AutoSave pause command.
+	PausedByCommand = 1 << 5,
+	// The drive that the city is saved to is low on free space.
+	LowDiskSpace = 1 << 6,
+	// The simulator reports that it is paused, this catches a pause
+	// that was not reported by a notification message.
+	SimulatorPaused = 1 << 7,
+};
+
+// Tracks whether the city can be saved.
+//
+// The focus and pause blockers are set from the game's notification messages.
+// The game does not send notifications for the other blockers, they are set
+// by a throttled poll that only runs while a save is due.
+//
+// While a save is due the time spent blocked is recorded for each blocker,
+// this allows the log to show how long a save was deferred and why.
+// The times are in milliseconds from an arbitrary epoch.
+class SaveReadiness
+{
+public:
+
+	// The blockers that are set from the game's state by the fallback poll.
+	static constexpr uint32_t PolledBlockers =
+		static_cast<uint32_t>(SaveBlocker::ModalDialog)
+		| static_cast<uint32_t>(SaveBlocker::SaveDisabled)
+		| static_cast<uint32_t>(SaveBlocker::NoCity)
+		| static_cast<uint32_t>(SaveBlocker::LowDiskSpace)
+		| static_cast<uint32_t>(SaveBlocker::SimulatorPaused);
+
+	SaveReadiness();
+
+	bool IsReady() const;
+
+	uint32_t GetBlockers() const;
+
+	bool IsBlockedBy(SaveBlocker blocker) const;
+
+	// Sets or clears a single blocker.
+	void SetBlocked(SaveBlocker blocker, bool blocked, int64_t now);
+
+	// Replaces the polled blockers with the result of a poll.
+	void SetPolledBlockers(uint32_t blockers, int64_t now);
+
+	// Returns true if the polled blockers should be refreshed.
+	bool IsPollDue(int64_t now) const;
+
+	// Starts recording the deferral time for a save that is due.
+	void BeginDue(int64_t now);
+
+	// Stops recording the deferral time, this is called after the save has completed.
+	void EndDue(int64_t now);
+
+	bool IsDue() const;
+
+	// Gets the total time that the save has been deferred since it became due.
+	int64_t GetDeferredMilliseconds(int64_t now) const;
+
+	// Gets a description of the time that each blocker deferred the save, e.g.
+	// "modal dialog 40 s, game paused 10 s". Returns an empty string if the save
+	// was not deferred.
+	std::string GetDeferralSummary(int64_t now) const;
+
+	static const char* GetBlockerName(SaveBlocker blocker);
+
+	// Gets a comma separated list of the blocker names.
+	static std::string GetBlockerNames(uint32_t blockers);
+
+private:
+
+	static constexpr size_t BlockerCount = 8;
+	static constexpr int64_t PollIntervalInMilliseconds = 500;
+
+	void AccumulateBlockedTime(int64_t now);
+
+	uint32_t blockers;
+	bool due;
+	int64_t dueStartTime;
+	int64_t lastUpdateTime;
+	int64_t nextPollTime;
+	int64_t deferredTime;
+	std::array<int64_t, BlockerCount> blockedTime;
+};
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveScheduler.h"
+#include <algorithm>
+
+SaveScheduler::SaveScheduler()
+	: interval(0),
+	  elapsedBeforeStart(0),
+	  startTime(0),
+	  dueTime(NotScheduled),
+	  running(false)
+{
+}
+
+int64_t SaveScheduler::GetIntervalInMilliseconds() const
+{
+	return interval;
+}
+
+void SaveScheduler::SetIntervalInMilliseconds(int64_t value, int64_t now)
+{
+	if (running)
+	{
+		// Fold the current period into the elapsed time so that the due
+		// time can be recomputed from the new interval.
+		elapsedBeforeStart += now - startTime;
+		startTime = now;
+	}
+
+	interval = std::max<int64_t>(value, 0);
+
+	if (running)
+	{
+		dueTime = startTime + std::max<int64_t>(interval - elapsedBeforeStart, 0);
+	}
+}
+
+bool SaveScheduler::IsRunning() const
+{
+	return running;
+}
+
+void SaveScheduler::Start(int64_t now)
+{
+	if (!running)
+	{
+		startTime = now;
+		dueTime = startTime + std::max<int64_t>(interval - elapsedBeforeStart, 0);
+		running = true;
+	}
+}
+
+void SaveScheduler::Stop(int64_t now)
+{
+	if (running)
+	{
+		elapsedBeforeStart += now - startTime;
+		dueTime = NotScheduled;
+		running = false;
+	}
+}
+
+void SaveScheduler::Restart(int64_t now)
+{
+	running = false;
+	elapsedBeforeStart = 0;
+	Start(now);
+}
+
+int64_t SaveScheduler::GetDueTime() const
+{
+	return dueTime;
+}
+
+bool SaveScheduler::IsDue(int64_t now) const
+{
+	return running && now >= dueTime;
+}
+
+int64_t SaveScheduler::GetTimeUntilDue(int64_t now) const
+{
+	if (!running)
+	{
+		return NotScheduled;
+	}
+
+	return std::max<int64_t>(dueTime - now, 0);
+}
@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+
+// Computes the time that the next auto-save is due.
+//
+// The scheduler counts the time that it has been running, in the same way as a stopwatch,
+// but it only reads the clock when its state changes. The due time is an absolute time
+// that callers compare against the clock, or use to arm a timer, instead of polling the
+// elapsed time.
+//
+// The times are in milliseconds from an arbitrary epoch, the caller provides the
+// current time so that the schedule can be driven by a recorded or simulated clock.
+class SaveScheduler
+{
+public:
+
+	static constexpr int64_t NotScheduled = INT64_MAX;
+
+	SaveScheduler();
+
+	int64_t GetIntervalInMilliseconds() const;
+
+	// Changes the save interval, the time that has already elapsed counts towards the new interval.
+	void SetIntervalInMilliseconds(int64_t value, int64_t now);
+
+	bool IsRunning() const;
+
+	// Starts or resumes counting towards the next save.
+	void Start(int64_t now);
+
+	// Stops counting, the elapsed time is kept until the scheduler is started again.
+	void Stop(int64_t now);
+
+	// Starts counting a new interval, this is called after the city has been saved.
+	void Restart(int64_t now);
+
+	// Gets the absolute time that the next save is due, or NotScheduled if the scheduler is stopped.
+	int64_t GetDueTime() const;
+
+	bool IsDue(int64_t now) const;
+
+	// Gets the number of milliseconds until the next save is due, 0 if it is already due
+	// or NotScheduled if the scheduler is stopped.
+	int64_t GetTimeUntilDue(int64_t now) const;
+
+private:
+
+	int64_t interval;
+	int64_t elapsedBeforeStart;
+	int64_t startTime;
+	int64_t dueTime;
+	bool running;
+};
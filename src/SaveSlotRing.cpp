@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveSlotRing.h"
+#include "Logger.h"
+#include "Settings.h"
+#include <fstream>
+
+static constexpr std::string_view SlotIndexFileName = "SlotIndex.bin";
+static constexpr uint32_t SlotIndexSignature = 0x52544C53; // SLTR
+static constexpr uint32_t SlotIndexVersion = 1;
+
+namespace
+{
+	template<typename T> bool ReadValue(std::ifstream& stream, T& value)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template<typename T> void WriteValue(std::ofstream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+}
+
+SaveSlotRing::SaveSlotRing() : folder(), slotFileNames(), nextSlot(0)
+{
+}
+
+const std::filesystem::path& SaveSlotRing::GetFolder() const
+{
+	return folder;
+}
+
+void SaveSlotRing::Load(const std::filesystem::path& folder, int slotCount)
+{
+	this->folder = folder;
+	slotFileNames.clear();
+	nextSlot = 0;
+
+	ReadIndex();
+
+	const size_t newSlotCount = static_cast<size_t>(slotCount);
+
+	if (slotFileNames.size() > newSlotCount)
+	{
+		// The user reduced the number of slots, remove the files that are no longer part of the ring.
+		for (size_t i = newSlotCount; i < slotFileNames.size(); i++)
+		{
+			if (!slotFileNames[i].empty())
+			{
+				std::error_code ec;
+				std::filesystem::remove(folder / slotFileNames[i], ec);
+			}
+		}
+	}
+
+	slotFileNames.resize(newSlotCount);
+
+	if (nextSlot >= newSlotCount)
+	{
+		nextSlot = 0;
+	}
+}
+
+void SaveSlotRing::Reset()
+{
+	folder.clear();
+	slotFileNames.clear();
+	nextSlot = 0;
+}
+
+std::filesystem::path SaveSlotRing::GetNextSlotPath(const std::string& fileName) const
+{
+	return folder / fileName;
+}
+
+void SaveSlotRing::CommitNextSlot(const std::string& fileName)
+{
+	if (slotFileNames.empty())
+	{
+		return;
+	}
+
+	std::string& previousFileName = slotFileNames[nextSlot];
+
+	if (!previousFileName.empty() && previousFileName != fileName)
+	{
+		std::error_code ec;
+		std::filesystem::remove(folder / previousFileName, ec);
+	}
+
+	previousFileName = fileName;
+	nextSlot = (nextSlot + 1) % slotFileNames.size();
+
+	WriteIndex();
+}
+
+int SaveSlotRing::GetNextSlotNumber() const
+{
+	// Slot numbers are 1-based when presented to the user.
+	return static_cast<int>(nextSlot) + 1;
+}
+
+void SaveSlotRing::ReadIndex()
+{
+	std::ifstream stream(folder / SlotIndexFileName, std::ifstream::in | std::ifstream::binary);
+
+	if (!stream)
+	{
+		return;
+	}
+
+	uint32_t signature = 0;
+	uint32_t version = 0;
+	uint32_t slotCount = 0;
+	uint32_t indexNextSlot = 0;
+
+	if (!ReadValue(stream, signature)
+		|| !ReadValue(stream, version)
+		|| !ReadValue(stream, slotCount)
+		|| !ReadValue(stream, indexNextSlot)
+		|| signature != SlotIndexSignature
+		|| version != SlotIndexVersion
+		|| slotCount > static_cast<uint32_t>(Settings::MaximumSaveSlotCount))
+	{
+		Logger::GetInstance().WriteLine(LogLevel::Error, "The save slot index is invalid, starting a new slot ring.");
+		return;
+	}
+
+	std::vector<std::string> names;
+	names.reserve(slotCount);
+
+	for (uint32_t i = 0; i < slotCount; i++)
+	{
+		uint16_t length = 0;
+
+		if (!ReadValue(stream, length))
+		{
+			Logger::GetInstance().WriteLine(LogLevel::Error, "The save slot index is truncated, starting a new slot ring.");
+			return;
+		}
+
+		std::string name(length, '\0');
+
+		if (length > 0 && !stream.read(name.data(), length))
+		{
+			Logger::GetInstance().WriteLine(LogLevel::Error, "The save slot index is truncated, starting a new slot ring.");
+			return;
+		}
+
+		names.push_back(std::move(name));
+	}
+
+	slotFileNames = std::move(names);
+	nextSlot = indexNextSlot;
+}
+
+void SaveSlotRing::WriteIndex() const
+{
+	const std::filesystem::path indexPath = folder / SlotIndexFileName;
+	std::filesystem::path tempPath = indexPath;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream stream(tempPath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+		if (!stream)
+		{
+			Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to write the save slot index.");
+			return;
+		}
+
+		WriteValue(stream, SlotIndexSignature);
+		WriteValue(stream, SlotIndexVersion);
+		WriteValue(stream, static_cast<uint32_t>(slotFileNames.size()));
+		WriteValue(stream, static_cast<uint32_t>(nextSlot));
+
+		for (const std::string& name : slotFileNames)
+		{
+			WriteValue(stream, static_cast<uint16_t>(name.size()));
+			stream.write(name.data(), name.size());
+		}
+
+		if (!stream)
+		{
+			Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to write the save slot index.");
+			return;
+		}
+	}
+
+	// Replace the old index in a single step so that a crash during the write
+	// does not leave a partial index behind.
+	std::error_code ec;
+	std::filesystem::rename(tempPath, indexPath, ec);
+
+	if (ec)
+	{
+		Logger::GetInstance().WriteLineFormatted(
+			LogLevel::Error,
+			"Failed to replace the save slot index: %s",
+			ec.message().c_str());
+	}
+}
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Tracks a fixed number of auto-save slot files for a single city.
+//
+// The slot file names and the next slot to write are stored in a small index
+// file in the slot folder, this allows the ring to be resumed in a later session
+// without scanning the folder.
+class SaveSlotRing
+{
+public:
+
+	SaveSlotRing();
+
+	const std::filesystem::path& GetFolder() const;
+
+	// Loads the slot index from the specified folder.
+	// If the folder does not have a slot index, the ring will start at the first slot.
+	void Load(const std::filesystem::path& folder, int slotCount);
+
+	void Reset();
+
+	// Gets the path that the next auto-save should be written to.
+	std::filesystem::path GetNextSlotPath(const std::string& fileName) const;
+
+	// Records that the next slot was saved using the specified file name.
+	// The previous file in that slot is deleted if its name is different.
+	void CommitNextSlot(const std::string& fileName);
+
+	int GetNextSlotNumber() const;
+
+private:
+
+	void ReadIndex();
+	void WriteIndex() const;
+
+	std::filesystem::path folder;
+	std::vector<std::string> slotFileNames;
+	size_t nextSlot;
+};
+
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveTriggers.h"
+#include <algorithm>
+
+static constexpr size_t TriggerCount = 5;
+
+SaveTriggers::SaveTriggers()
+	: debounceTime(0),
+	  minimumSpacing(0),
+	  lastTriggerTime(0),
+	  lastSaveTime(INT64_MIN / 2),
+	  pendingTriggers(0),
+	  immediate(false)
+{
+}
+
+void SaveTriggers::SetTiming(int64_t debounceMilliseconds, int64_t minimumSpacingMilliseconds)
+{
+	debounceTime = std::max<int64_t>(debounceMilliseconds, 0);
+	minimumSpacing = std::max<int64_t>(minimumSpacingMilliseconds, 0);
+}
+
+void SaveTriggers::Trigger(SaveTrigger trigger, int64_t now)
+{
+	const uint32_t flag = static_cast<uint32_t>(trigger);
+
+	// A trigger that is already pending does not restart the debounce window, at the
+	// highest simulation speed the monthly checks can repeat faster than the window.
+	if ((pendingTriggers & flag) == 0)
+	{
+		pendingTriggers |= flag;
+		lastTriggerTime = now;
+	}
+}
+
+void SaveTriggers::TriggerImmediate(SaveTrigger trigger, int64_t now)
+{
+	if (!immediate)
+	{
+		immediate = true;
+		lastTriggerTime = now;
+	}
+
+	pendingTriggers |= static_cast<uint32_t>(trigger);
+}
+
+bool SaveTriggers::IsPending() const
+{
+	return pendingTriggers != 0;
+}
+
+uint32_t SaveTriggers::GetPendingTriggers() const
+{
+	return pendingTriggers;
+}
+
+int64_t SaveTriggers::GetDueTime() const
+{
+	if (pendingTriggers == 0)
+	{
+		return NotScheduled;
+	}
+
+	if (immediate)
+	{
+		return lastTriggerTime;
+	}
+
+	return std::max(lastTriggerTime + debounceTime, lastSaveTime + minimumSpacing);
+}
+
+void SaveTriggers::SaveCompleted(int64_t now)
+{
+	pendingTriggers = 0;
+	immediate = false;
+	lastSaveTime = now;
+}
+
+void SaveTriggers::Clear()
+{
+	pendingTriggers = 0;
+	immediate = false;
+}
+
+const char* SaveTriggers::GetTriggerName(SaveTrigger trigger)
+{
+	switch (trigger)
+	{
+	case SaveTrigger::NewYear:
+		return "new year";
+	case SaveTrigger::FundsChanged:
+		return "funds changed";
+	case SaveTrigger::SimInterval:
+		return "in-game interval";
+	case SaveTrigger::MemoryPressure:
+		return "memory pressure";
+	case SaveTrigger::Command:
+		return "AutoSave now command";
+	case SaveTrigger::None:
+	default:
+		return "none";
+	}
+}
+
+std::string SaveTriggers::GetTriggerNames(uint32_t value)
+{
+	std::string names;
+
+	for (size_t i = 0; i < TriggerCount; i++)
+	{
+		if ((value & (1U << i)) != 0)
+		{
+			if (!names.empty())
+			{
+				names.append(", ");
+			}
+
+			names.append(GetTriggerName(static_cast<SaveTrigger>(1U << i)));
+		}
+	}
+
+	return names;
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// The game events that can request an auto-save.
+enum class SaveTrigger : uint32_t
+{
+	None = 0,
+	// The simulation started a new year.
+	NewYear = 1 << 0,
+	// The city's funds changed by more than the configured amount since the last save.
+	FundsChanged = 1 << 1,
+	// The number of in-game months in the simulation interval has elapsed since the last save.
+	SimInterval = 1 << 2,
+	// The process is close to running out of memory.
+	MemoryPressure = 1 << 3,
+	// The AutoSave now command was used.
+	Command = 1 << 4,
+};
+
+// Coalesces the save requests from game events into a single save.
+//
+// Each new trigger restarts the debounce window, so a burst of events results in
+// one save after the events have stopped. A triggered save is also never made within
+// the minimum spacing of the previous save, including the interval saves.
+// The times are in milliseconds from an arbitrary epoch.
+class SaveTriggers
+{
+public:
+
+	static constexpr int64_t NotScheduled = INT64_MAX;
+
+	SaveTriggers();
+
+	void SetTiming(int64_t debounceMilliseconds, int64_t minimumSpacingMilliseconds);
+
+	// Requests a save, the save is due once the debounce window and minimum spacing have elapsed.
+	void Trigger(SaveTrigger trigger, int64_t now);
+
+	// Requests a save that is due immediately, the debounce window and minimum spacing are not used.
+	void TriggerImmediate(SaveTrigger trigger, int64_t now);
+
+	bool IsPending() const;
+
+	// Gets the SaveTrigger flags for the events that requested the pending save.
+	uint32_t GetPendingTriggers() const;
+
+	// Gets the absolute time that the pending save is due, or NotScheduled if there is no pending save.
+	int64_t GetDueTime() const;
+
+	// Discards the pending triggers and records the time of the save,
+	// this is called after every save, not only the triggered saves.
+	void SaveCompleted(int64_t now);
+
+	// Discards the pending triggers, this is called when the city is closed.
+	void Clear();
+
+	static const char* GetTriggerName(SaveTrigger trigger);
+
+	// Gets a comma separated list of the trigger names for the specified SaveTrigger flags.
+	static std::string GetTriggerNames(uint32_t triggers);
+
+private:
+
+	int64_t debounceTime;
+	int64_t minimumSpacing;
+	int64_t lastTriggerTime;
+	int64_t lastSaveTime;
+	uint32_t pendingTriggers;
+	bool immediate;
+};
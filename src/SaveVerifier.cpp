@@ -0,0 +1,323 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SaveVerifier.h"
+#include "DBPFReader.h"
+#include "QfsDecompressor.h"
+#include "Stopwatch.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+static constexpr uint32_t kDirectoryType = 0xE86B1EEF;
+static constexpr uint32_t kDirectoryGroup = 0xE86B1EEF;
+static constexpr uint32_t kDirectoryInstance = 0x286B1F03;
+
+// Each directory record is a TGI followed by the uncompressed size.
+static constexpr size_t kDirectoryRecordSize = 16;
+
+static constexpr uint32_t kMaxWorkerThreads = 8;
+
+// A worker keeps its output buffer for the next entry up to this size, the entries are
+// decompressed from largest to smallest and the game is a 32-bit process.
+static constexpr size_t kMaxRetainedBufferSize = 4 * 1024 * 1024;
+
+namespace
+{
+	struct TGI
+	{
+		uint32_t type;
+		uint32_t group;
+		uint32_t instance;
+
+		bool operator==(const TGI& other) const
+		{
+			return type == other.type && group == other.group && instance == other.instance;
+		}
+	};
+
+	struct TGIHasher
+	{
+		size_t operator()(const TGI& tgi) const noexcept
+		{
+			size_t hash = tgi.type;
+			hash = (hash * 31) + tgi.group;
+			hash = (hash * 31) + tgi.instance;
+
+			return hash;
+		}
+	};
+
+	struct CompressedEntry
+	{
+		const DBPFIndexEntry* entry;
+		uint32_t uncompressedSize;
+	};
+
+	uint32_t ReadUInt32(const uint8_t* data)
+	{
+		uint32_t value = 0;
+		std::memcpy(&value, data, sizeof(value));
+
+		return value;
+	}
+
+	SaveVerificationResult Fail(SaveVerificationResult& result, const Stopwatch& stopwatch, const char* message)
+	{
+		result.valid = false;
+		result.errorMessage = message;
+		result.elapsedMilliseconds = stopwatch.ElapsedMilliseconds();
+
+		return result;
+	}
+}
+
+SaveVerifier::SaveVerifier(uint32_t threadCount)
+	: threadCount(threadCount)
+{
+}
+
+SaveVerificationResult SaveVerifier::Verify(const std::filesystem::path& path, std::stop_token stopToken) const
+{
+	Stopwatch stopwatch;
+	stopwatch.Start();
+
+	SaveVerificationResult result{};
+
+	DBPFReader reader;
+
+	if (!reader.Open(path))
+	{
+		return Fail(result, stopwatch, reader.GetErrorMessage());
+	}
+
+	result.fileSize = reader.GetFileSize();
+	result.entryCount = reader.GetEntries().size();
+
+	std::unordered_map<TGI, const DBPFIndexEntry*, TGIHasher> entriesByTGI;
+	entriesByTGI.reserve(result.entryCount);
+
+	const DBPFIndexEntry* directoryEntry = nullptr;
+
+	for (const DBPFIndexEntry& entry : reader.GetEntries())
+	{
+		if (entry.type == kDirectoryType && entry.group == kDirectoryGroup && entry.instance == kDirectoryInstance)
+		{
+			directoryEntry = &entry;
+		}
+		else
+		{
+			entriesByTGI.emplace(TGI{ entry.type, entry.group, entry.instance }, &entry);
+		}
+	}
+
+	std::vector<CompressedEntry> compressedEntries;
+
+	// A file without a directory record does not have any compressed entries.
+	if (directoryEntry)
+	{
+		if ((directoryEntry->size % kDirectoryRecordSize) != 0)
+		{
+			return Fail(result, stopwatch, "The DBPF directory record has an invalid size.");
+		}
+
+		const MemoryMappedView directoryView = reader.MapEntry(*directoryEntry);
+
+		if (!directoryView.IsValid())
+		{
+			return Fail(result, stopwatch, "Failed to map the DBPF directory record.");
+		}
+
+		const std::span<const uint8_t> directory = directoryView.GetData();
+
+		compressedEntries.reserve(directory.size() / kDirectoryRecordSize);
+
+		for (size_t offset = 0; offset < directory.size(); offset += kDirectoryRecordSize)
+		{
+			const uint8_t* record = directory.data() + offset;
+
+			const TGI tgi{ ReadUInt32(record), ReadUInt32(record + 4), ReadUInt32(record + 8) };
+
+			auto it = entriesByTGI.find(tgi);
+
+			if (it == entriesByTGI.end())
+			{
+				return Fail(result, stopwatch, "The DBPF directory references an entry that is not in the index.");
+			}
+
+			compressedEntries.push_back(CompressedEntry{ it->second, ReadUInt32(record + 12) });
+		}
+	}
+
+	result.compressedEntryCount = compressedEntries.size();
+
+	// The largest entries are decompressed first so that the work is spread evenly
+	// over the threads when a few entries are much larger than the others.
+	std::sort(
+		compressedEntries.begin(),
+		compressedEntries.end(),
+		[](const CompressedEntry& a, const CompressedEntry& b) { return a.entry->size > b.entry->size; });
+
+	std::atomic<size_t> nextEntry = 0;
+	std::atomic<uint64_t> uncompressedBytes = 0;
+	std::atomic<bool> failed = false;
+	std::mutex errorMutex;
+	std::string errorMessage;
+
+	auto setError = [&](const char* message)
+	{
+		std::scoped_lock lock(errorMutex);
+
+		if (!failed.exchange(true))
+		{
+			errorMessage = message;
+		}
+	};
+
+	auto workerProc = [&]()
+	{
+#ifdef _WIN32
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+
+		// The output buffer is reused for the entries that this thread decompresses.
+		std::vector<uint8_t> buffer;
+
+		while (!failed && !stopToken.stop_requested())
+		{
+			const size_t index = nextEntry.fetch_add(1);
+
+			if (index >= compressedEntries.size())
+			{
+				break;
+			}
+
+			const CompressedEntry& item = compressedEntries[index];
+
+			const MemoryMappedView view = reader.MapEntry(*item.entry);
+
+			if (!view.IsValid())
+			{
+				setError("Failed to map a compressed DBPF entry.");
+				break;
+			}
+
+			if (!QfsDecompress(view.GetData(), item.uncompressedSize, buffer))
+			{
+				setError("A compressed DBPF entry is damaged or does not match the size in the directory.");
+				break;
+			}
+
+			uncompressedBytes += buffer.size();
+
+			if (buffer.capacity() > kMaxRetainedBufferSize)
+			{
+				std::vector<uint8_t>().swap(buffer);
+			}
+		}
+	};
+
+	// An exception would terminate the game if it escaped from the thread,
+	// e.g. when the output buffer cannot be allocated.
+	auto safeWorkerProc = [&]()
+	{
+		try
+		{
+			workerProc();
+		}
+		catch (const std::exception&)
+		{
+			setError("An error occurred when decompressing a DBPF entry.");
+		}
+	};
+
+	uint32_t workerThreadCount = threadCount;
+
+	if (workerThreadCount == 0)
+	{
+		// Leave one core for the game.
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+
+		workerThreadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	workerThreadCount = std::min(workerThreadCount, kMaxWorkerThreads);
+	workerThreadCount = static_cast<uint32_t>(std::min<size_t>(workerThreadCount, compressedEntries.size()));
+
+	{
+		std::vector<std::jthread> workerThreads;
+		workerThreads.reserve(workerThreadCount);
+
+		for (uint32_t i = 0; i < workerThreadCount; i++)
+		{
+			workerThreads.emplace_back(safeWorkerProc);
+		}
+	}
+
+	if (failed)
+	{
+		return Fail(result, stopwatch, errorMessage.c_str());
+	}
+
+	if (stopToken.stop_requested())
+	{
+		return Fail(result, stopwatch, "The verification was canceled.");
+	}
+
+	result.valid = true;
+	result.uncompressedBytes = uncompressedBytes;
+	result.elapsedMilliseconds = stopwatch.ElapsedMilliseconds();
+
+	return result;
+}
+
+bool SaveVerifier::AppendRecord(
+	const std::filesystem::path& recordFilePath,
+	const std::string& generationName,
+	const std::filesystem::path& saveFilePath,
+	const SaveVerificationResult& result)
+{
+	std::ofstream stream(recordFilePath, std::ofstream::out | std::ofstream::app);
+
+	if (!stream)
+	{
+		return false;
+	}
+
+	stream << generationName << '\t' << saveFilePath.filename().string() << '\t';
+
+	if (result.valid)
+	{
+		stream << "OK\t"
+			<< result.entryCount << " entries, "
+			<< result.compressedEntryCount << " compressed, "
+			<< result.elapsedMilliseconds << " ms";
+	}
+	else
+	{
+		stream << "FAILED\t" << result.errorMessage;
+	}
+
+	stream << '\n';
+
+	return static_cast<bool>(stream);
+}
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <stdint.h>
+#include <stop_token>
+#include <string>
+
+struct SaveVerificationResult
+{
+	bool valid;
+	std::string errorMessage;
+	size_t entryCount;
+	size_t compressedEntryCount;
+	uint64_t fileSize;
+	uint64_t uncompressedBytes;
+	int64_t elapsedMilliseconds;
+};
+
+// Checks that a save file can be read by the game.
+//
+// The DBPF header and index are validated, and every compressed entry listed in
+// the DBPF directory record is decompressed and checked against the size recorded
+// in the directory. The entries are decompressed in parallel on worker threads.
+class SaveVerifier
+{
+public:
+
+	// A threadCount of 0 uses one less than the number of CPU cores.
+	explicit SaveVerifier(uint32_t threadCount);
+
+	SaveVerificationResult Verify(const std::filesystem::path& path, std::stop_token stopToken) const;
+
+	// Appends the result to a text file that records the verification history
+	// of the auto-saves in a backup folder.
+	static bool AppendRecord(
+		const std::filesystem::path& recordFilePath,
+		const std::string& generationName,
+		const std::filesystem::path& saveFilePath,
+		const SaveVerificationResult& result);
+
+private:
+
+	uint32_t threadCount;
+};
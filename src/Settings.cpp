@@ -11,16 +11,95 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "Settings.h"
-#include "boost/property_tree/ptree.hpp"
-#include "boost/property_tree/ini_parser.hpp"
+#include "IniParser.h"
+#include <vector>
 
-namespace pt = boost::property_tree;
+static constexpr int kMinimumSaveIntervalInMinutes = Settings::MinimumSaveIntervalInMinutes;
+static constexpr int kMaximumSaveIntervalInMinutes = Settings::MaximumSaveIntervalInMinutes;
+static constexpr int kMaximumFullSaveIntervalInMinutes = 1440;
+static constexpr int kMaximumSimIntervalInMonths = 120;
+static constexpr int kMaximumTriggerDebounceInSeconds = 600;
+static constexpr int kMaximumFundsChangeTriggerAmount = 1000000000;
+static constexpr int kMaximumAddressSpaceThresholdPercent = 99;
+static constexpr int kMaximumCommittedMemoryThresholdInMB = 4096;
+
+static constexpr int kMaximumSaveSlotCount = Settings::MaximumSaveSlotCount;
+
+static constexpr int kMaximumEventLogSizeInMB = 1024;
+
+static constexpr double kMinimumStallBudgetPercent = 0.1;
+static constexpr double kMaximumStallBudgetPercent = 50.0;
+
+static constexpr int kMinimumDeduplicatedGenerationCount = 1;
+static constexpr int kMaximumDeduplicatedGenerationCount = 1000;
+
+static constexpr int kMaximumThreadCount = 64;
+
+static constexpr int kMaximumBackupQuotaInMB = 1048576;
+static constexpr int kMaximumFreeDiskSpaceInMB = 1048576;
+
+static constexpr std::string_view CityProfilePrefix = "City:";
+static constexpr std::string_view RegionProfilePrefix = "Region:";
+
+namespace
+{
+	std::string_view TrimSpaces(std::string_view value)
+	{
+		while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+		{
+			value.remove_prefix(1);
+		}
+
+		while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+		{
+			value.remove_suffix(1);
+		}
+
+		return value;
+	}
+}
 
 Settings::Settings()
 	: saveIntervalInMinutes(15),
-	  fastSave(false),
+	  simIntervalInMonths(0),
+	  fastSave(true),
+	  fullSaveIntervalInMinutes(0),
+	  fullSaveOnCityClose(false),
+	  saveOnFocusLoss(false),
+	  focusLossMinimumAgeInMinutes(5),
 	  ignoreTimePaused(true),
-	  logSaveEvents(true)
+	  logSaveEvents(true),
+	  skipUnchangedSaves(true),
+	  saveSlotCount(0),
+	  saveSlotNameFormat("<CityName> - AutoSave <Slot>"),
+	  backupDirectory(),
+	  compressBackups(false),
+	  compressionThreadCount(0),
+	  pruneCompressedBackups(false),
+	  cityBackupQuotaInMB(0),
+	  totalBackupQuotaInMB(0),
+	  minimumFreeDiskSpaceInMB(0),
+	  deduplicateBackups(false),
+	  deduplicatedGenerationCount(20),
+	  catalogBackups(false),
+	  verifySaves(false),
+	  verificationThreadCount(0),
+	  recordSaveMetrics(true),
+	  adaptiveInterval(false),
+	  stallBudgetPercent(2.0),
+	  minimumIntervalInMinutes(2),
+	  maximumIntervalInMinutes(30),
+	  saveOnNewYear(false),
+	  fundsChangeTriggerAmount(0),
+	  triggerDebounceInSeconds(30),
+	  triggerMinimumSpacingInMinutes(5),
+	  addressSpaceThresholdPercent(85),
+	  committedMemoryThresholdInMB(0),
+	  asyncLogging(true),
+	  eventLogMaxSizeInMB(10),
+	  hotReloadSettings(true),
+	  traceMessages(false),
+	  profiles()
 {
 }
 
@@ -29,11 +108,36 @@ int Settings::SaveIntervalInMinutes() const
 	return saveIntervalInMinutes;
 }
 
+int Settings::SimIntervalInMonths() const
+{
+	return simIntervalInMonths;
+}
+
 bool Settings::FastSave() const
 {
 	return fastSave;
 }
 
+int Settings::FullSaveIntervalInMinutes() const
+{
+	return fullSaveIntervalInMinutes;
+}
+
+bool Settings::FullSaveOnCityClose() const
+{
+	return fullSaveOnCityClose;
+}
+
+bool Settings::SaveOnFocusLoss() const
+{
+	return saveOnFocusLoss;
+}
+
+int Settings::FocusLossMinimumAgeInMinutes() const
+{
+	return focusLossMinimumAgeInMinutes;
+}
+
 bool Settings::IgnoreTimePaused() const
 {
 	return ignoreTimePaused;
@@ -44,21 +148,297 @@ bool Settings::LogSaveEvents() const
 	return logSaveEvents;
 }
 
-void Settings::Load(const std::filesystem::path& path)
+bool Settings::SkipUnchangedSaves() const
 {
-	std::ifstream stream(path, std::ifstream::in);
+	return skipUnchangedSaves;
+}
+
+int Settings::SaveSlotCount() const
+{
+	return saveSlotCount;
+}
 
-	if (!stream)
+const std::string& Settings::SaveSlotNameFormat() const
+{
+	return saveSlotNameFormat;
+}
+
+const std::filesystem::path& Settings::BackupDirectory() const
+{
+	return backupDirectory;
+}
+
+bool Settings::CompressBackups() const
+{
+	return compressBackups;
+}
+
+int Settings::CompressionThreadCount() const
+{
+	return compressionThreadCount;
+}
+
+bool Settings::PruneCompressedBackups() const
+{
+	return pruneCompressedBackups;
+}
+
+int Settings::CityBackupQuotaInMB() const
+{
+	return cityBackupQuotaInMB;
+}
+
+int Settings::TotalBackupQuotaInMB() const
+{
+	return totalBackupQuotaInMB;
+}
+
+int Settings::MinimumFreeDiskSpaceInMB() const
+{
+	return minimumFreeDiskSpaceInMB;
+}
+
+bool Settings::DeduplicateBackups() const
+{
+	return deduplicateBackups;
+}
+
+int Settings::DeduplicatedGenerationCount() const
+{
+	return deduplicatedGenerationCount;
+}
+
+bool Settings::CatalogBackups() const
+{
+	return catalogBackups;
+}
+
+bool Settings::VerifySaves() const
+{
+	return verifySaves;
+}
+
+int Settings::VerificationThreadCount() const
+{
+	return verificationThreadCount;
+}
+
+bool Settings::RecordSaveMetrics() const
+{
+	return recordSaveMetrics;
+}
+
+bool Settings::AdaptiveInterval() const
+{
+	return adaptiveInterval;
+}
+
+double Settings::StallBudgetPercent() const
+{
+	return stallBudgetPercent;
+}
+
+int Settings::MinimumIntervalInMinutes() const
+{
+	return minimumIntervalInMinutes;
+}
+
+int Settings::MaximumIntervalInMinutes() const
+{
+	return maximumIntervalInMinutes;
+}
+
+bool Settings::SaveOnNewYear() const
+{
+	return saveOnNewYear;
+}
+
+int Settings::FundsChangeTriggerAmount() const
+{
+	return fundsChangeTriggerAmount;
+}
+
+int Settings::TriggerDebounceInSeconds() const
+{
+	return triggerDebounceInSeconds;
+}
+
+int Settings::TriggerMinimumSpacingInMinutes() const
+{
+	return triggerMinimumSpacingInMinutes;
+}
+
+int Settings::AddressSpaceThresholdPercent() const
+{
+	return addressSpaceThresholdPercent;
+}
+
+int Settings::CommittedMemoryThresholdInMB() const
+{
+	return committedMemoryThresholdInMB;
+}
+
+bool Settings::AsyncLogging() const
+{
+	return asyncLogging;
+}
+
+int Settings::EventLogMaxSizeInMB() const
+{
+	return eventLogMaxSizeInMB;
+}
+
+bool Settings::HotReloadSettings() const
+{
+	return hotReloadSettings;
+}
+
+bool Settings::TraceMessages() const
+{
+	return traceMessages;
+}
+
+SaveProfile Settings::DefaultProfile() const
+{
+	SaveProfile profile{};
+	profile.saveIntervalInMinutes = saveIntervalInMinutes;
+	profile.fastSave = fastSave;
+	profile.saveSlotCount = saveSlotCount;
+	profile.deduplicatedGenerationCount = deduplicatedGenerationCount;
+
+	return profile;
+}
+
+const SaveProfiles& Settings::Profiles() const
+{
+	return profiles;
+}
+
+bool Settings::Load(const std::filesystem::path& path, std::string& errors)
+{
+	errors.clear();
+
+	std::string text;
+
+	if (!IniParser::ReadFile(path, text))
 	{
-		throw std::runtime_error("Failed to open the settings file.");
+		errors = "Failed to open the settings file.";
+		return false;
 	}
 
-	pt::ptree tree;
+	const IniKeyDefinition schema[] =
+	{
+		// Name, value, default, minimum, maximum
+		{ "IntervalInMinutes", &saveIntervalInMinutes, "15", kMinimumSaveIntervalInMinutes, kMaximumSaveIntervalInMinutes },
+		{ "SimIntervalInMonths", &simIntervalInMonths, "0", 0, kMaximumSimIntervalInMonths },
+		{ "FastSave", &fastSave, "true", 0, 0 },
+		{ "FullSaveIntervalInMinutes", &fullSaveIntervalInMinutes, "0", 0, kMaximumFullSaveIntervalInMinutes },
+		{ "FullSaveOnCityClose", &fullSaveOnCityClose, "false", 0, 0 },
+		{ "SaveOnFocusLoss", &saveOnFocusLoss, "false", 0, 0 },
+		{ "FocusLossMinimumAgeInMinutes", &focusLossMinimumAgeInMinutes, "5", kMinimumSaveIntervalInMinutes, kMaximumSaveIntervalInMinutes },
+		{ "IgnoreTimePaused", &ignoreTimePaused, "true", 0, 0 },
+		{ "LogSaveEvents", &logSaveEvents, "true", 0, 0 },
+		{ "SkipUnchangedSaves", &skipUnchangedSaves, "true", 0, 0 },
+		{ "SaveSlotCount", &saveSlotCount, "0", 0, kMaximumSaveSlotCount },
+		{ "SaveSlotNameFormat", &saveSlotNameFormat, "<CityName> - AutoSave <Slot>", 0, 0 },
+		{ "BackupDirectory", &backupDirectory, "", 0, 0 },
+		{ "CompressBackups", &compressBackups, "false", 0, 0 },
+		{ "CompressionThreadCount", &compressionThreadCount, "0", 0, kMaximumThreadCount },
+		{ "PruneCompressedBackups", &pruneCompressedBackups, "false", 0, 0 },
+		{ "CityBackupQuotaInMB", &cityBackupQuotaInMB, "0", 0, kMaximumBackupQuotaInMB },
+		{ "TotalBackupQuotaInMB", &totalBackupQuotaInMB, "0", 0, kMaximumBackupQuotaInMB },
+		{ "MinimumFreeDiskSpaceInMB", &minimumFreeDiskSpaceInMB, "0", 0, kMaximumFreeDiskSpaceInMB },
+		{ "DeduplicateBackups", &deduplicateBackups, "false", 0, 0 },
+		{ "DeduplicatedGenerationCount", &deduplicatedGenerationCount, "20", kMinimumDeduplicatedGenerationCount, kMaximumDeduplicatedGenerationCount },
+		{ "CatalogBackups", &catalogBackups, "false", 0, 0 },
+		{ "VerifySaves", &verifySaves, "false", 0, 0 },
+		{ "VerificationThreadCount", &verificationThreadCount, "0", 0, kMaximumThreadCount },
+		{ "RecordSaveMetrics", &recordSaveMetrics, "true", 0, 0 },
+		{ "AdaptiveInterval", &adaptiveInterval, "false", 0, 0 },
+		{ "StallBudgetPercent", &stallBudgetPercent, "2", kMinimumStallBudgetPercent, kMaximumStallBudgetPercent },
+		{ "MinimumIntervalInMinutes", &minimumIntervalInMinutes, "2", kMinimumSaveIntervalInMinutes, kMaximumSaveIntervalInMinutes },
+		{ "MaximumIntervalInMinutes", &maximumIntervalInMinutes, "30", kMinimumSaveIntervalInMinutes, kMaximumSaveIntervalInMinutes },
+		{ "SaveOnNewYear", &saveOnNewYear, "false", 0, 0 },
+		{ "FundsChangeTriggerAmount", &fundsChangeTriggerAmount, "0", 0, kMaximumFundsChangeTriggerAmount },
+		{ "TriggerDebounceInSeconds", &triggerDebounceInSeconds, "30", 0, kMaximumTriggerDebounceInSeconds },
+		{ "TriggerMinimumSpacingInMinutes", &triggerMinimumSpacingInMinutes, "5", 0, kMaximumSaveIntervalInMinutes },
+		{ "AddressSpaceThresholdPercent", &addressSpaceThresholdPercent, "85", 0, kMaximumAddressSpaceThresholdPercent },
+		{ "CommittedMemoryThresholdInMB", &committedMemoryThresholdInMB, "0", 0, kMaximumCommittedMemoryThresholdInMB },
+		{ "AsyncLogging", &asyncLogging, "true", 0, 0 },
+		{ "EventLogMaxSizeInMB", &eventLogMaxSizeInMB, "10", 0, kMaximumEventLogSizeInMB },
+		{ "HotReloadSettings", &hotReloadSettings, "true", 0, 0 },
+		{ "TraceMessages", &traceMessages, "false", 0, 0 },
+	};
+
+	IniParser::SetDefaults(schema);
+
+	bool result = IniParser::ParseSection(text, "AutoSave", schema, errors);
+
+	// The profile sections override some of the [AutoSave] values for a city or region,
+	// the values that are not in a profile section use the [AutoSave] value.
+	profiles = SaveProfiles();
+
+	std::vector<std::string_view> sectionNames;
+	IniParser::GetSectionNames(text, sectionNames);
+
+	for (const std::string_view& sectionName : sectionNames)
+	{
+		const bool isCityProfile = sectionName.starts_with(CityProfilePrefix);
+		const bool isRegionProfile = sectionName.starts_with(RegionProfilePrefix);
+
+		if (!isCityProfile && !isRegionProfile)
+		{
+			continue;
+		}
+
+		const std::string_view profileName = TrimSpaces(
+			sectionName.substr(isCityProfile ? CityProfilePrefix.size() : RegionProfilePrefix.size()));
 
-	pt::ini_parser::read_ini(stream, tree);
+		SaveProfile profile = DefaultProfile();
+		profile.name = sectionName;
+
+		const IniKeyDefinition profileSchema[] =
+		{
+			{ "IntervalInMinutes", &profile.saveIntervalInMinutes, "", kMinimumSaveIntervalInMinutes, kMaximumSaveIntervalInMinutes },
+			{ "FastSave", &profile.fastSave, "", 0, 0 },
+			{ "SaveSlotCount", &profile.saveSlotCount, "", 0, kMaximumSaveSlotCount },
+			{ "DeduplicatedGenerationCount", &profile.deduplicatedGenerationCount, "", kMinimumDeduplicatedGenerationCount, kMaximumDeduplicatedGenerationCount },
+		};
+
+		if (profileName.empty())
+		{
+			errors.append("The ");
+			errors.append(sectionName);
+			errors.append(" section does not have a name.\n");
+			result = false;
+		}
+		else if (IniParser::ParseSection(text, sectionName, profileSchema, errors))
+		{
+			if (isCityProfile)
+			{
+				profiles.AddCityProfile(profileName, profile);
+			}
+			else
+			{
+				profiles.AddRegionProfile(profileName, profile);
+			}
+		}
+		else
+		{
+			result = false;
+		}
+	}
+
+	if (adaptiveInterval && minimumIntervalInMinutes > maximumIntervalInMinutes)
+	{
+		errors.append("The MinimumIntervalInMinutes value cannot be greater than the MaximumIntervalInMinutes value.\n");
+		result = false;
+	}
+
+	if (!errors.empty() && errors.back() == '\n')
+	{
+		errors.pop_back();
+	}
 
-	saveIntervalInMinutes = tree.get<int>("AutoSave.IntervalInMinutes");
-	fastSave = tree.get<bool>("AutoSave.FastSave");
-	ignoreTimePaused = tree.get<bool>("AutoSave.IgnoreTimePaused");
-	logSaveEvents = tree.get<bool>("AutoSave.LogSaveEvents");
+	return result;
 }
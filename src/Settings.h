@@ -12,20 +12,41 @@
 
 #pragma once
 
+#include "SaveProfiles.h"
 #include <filesystem>
-#include <fstream>
+#include <string>
 
 class Settings
 {
 public:
 
+	static constexpr int MinimumSaveIntervalInMinutes = 1;
+	static constexpr int MaximumSaveIntervalInMinutes = 120;
+	static constexpr int MaximumSaveSlotCount = 100;
+
 	Settings();
 
 	int SaveIntervalInMinutes() const;
 
+	// The number of in-game months between auto-saves, 0 uses the real time interval.
+	int SimIntervalInMonths() const;
+
 	// Fast saving skips updating the region view thumbnail.
 	bool FastSave() const;
 
+	// The number of minutes between full saves when FastSave is enabled, 0 disables the full saves.
+	// A full save updates the region view thumbnail.
+	int FullSaveIntervalInMinutes() const;
+
+	// A full save will be made when the city is closed if only fast saves were made since the last full save.
+	bool FullSaveOnCityClose() const;
+
+	// The city will be saved shortly after the game loses focus, if the last save is older than FocusLossMinimumAgeInMinutes.
+	bool SaveOnFocusLoss() const;
+
+	// The age of the last save in minutes that allows a save when the game loses focus.
+	int FocusLossMinimumAgeInMinutes() const;
+
 	// Will the time the game spends paused count towards the next auto-save point.
 	// If this is false, the next auto-save may occur after the game resumes.
 	bool IgnoreTimePaused() const;
@@ -33,12 +54,156 @@ public:
 	// The save event status will be written to the log.
 	bool LogSaveEvents() const;
 
-	void Load(const std::filesystem::path& path);
+	// The auto-save will be skipped if the city has not changed since it was last saved.
+	bool SkipUnchangedSaves() const;
+
+	// The number of rotating auto-save slots, 0 if the slot ring is disabled.
+	// When enabled, each auto-save is written to the next slot file instead of
+	// overwriting the city's save file.
+	int SaveSlotCount() const;
+
+	// The file name format for the auto-save slots, see SC4AutoSave.ini for the supported tokens.
+	const std::string& SaveSlotNameFormat() const;
+
+	// The folder that the auto-save backups are written to.
+	// An empty path uses a SC4AutoSave folder in the game's user data directory.
+	const std::filesystem::path& BackupDirectory() const;
+
+	// A gzip compressed copy of each auto-save will be written to the backup folder.
+	bool CompressBackups() const;
+
+	// The number of threads used to compress the backups, 0 uses the number of CPU cores.
+	int CompressionThreadCount() const;
+
+	// The compressed backups will be thinned to a grandfather-father-son schedule, every backup
+	// from the last hour, one per hour for a day, one per day for a month and one per week after that.
+	bool PruneCompressedBackups() const;
+
+	// The maximum size in MB of each city's compressed backups, 0 does not limit the size.
+	int CityBackupQuotaInMB() const;
+
+	// The maximum size in MB of the compressed backups for all cities, 0 does not limit the size.
+	int TotalBackupQuotaInMB() const;
+
+	// The auto-save waits while the free disk space is below this value in MB, 0 disables the check.
+	int MinimumFreeDiskSpaceInMB() const;
+
+	// Each auto-save will be added to a content-addressed backup store, only the
+	// DBPF entries that changed since the previous generations are written.
+	bool DeduplicateBackups() const;
+
+	// The number of generations that are kept in the deduplicating backup store.
+	int DeduplicatedGenerationCount() const;
+
+	// Each auto-save will be recorded in a catalog in the backup folder, with
+	// the city's population, in-game date, content hash and verification status.
+	bool CatalogBackups() const;
+
+	// Each auto-save will be checked on a background thread after the game has saved it,
+	// every compressed DBPF entry is decompressed to prove that the file can be read.
+	bool VerifySaves() const;
+
+	// The number of threads used to verify the saves, 0 uses the number of CPU cores.
+	int VerificationThreadCount() const;
+
+	// The time and size of each auto-save will be recorded in a history file in the
+	// city's backup folder, and a summary is written to the log when the city is closed.
+	bool RecordSaveMetrics() const;
+
+	// The save interval will be derived from the measured save times and the stall
+	// budget, instead of using a fixed interval.
+	bool AdaptiveInterval() const;
+
+	// The largest percentage of the play time that auto-saving is allowed to use.
+	double StallBudgetPercent() const;
+
+	// The shortest interval that the adaptive mode will use.
+	int MinimumIntervalInMinutes() const;
+
+	// The longest interval that the adaptive mode will use.
+	int MaximumIntervalInMinutes() const;
+
+	// The city will be saved when the simulation starts a new year.
+	bool SaveOnNewYear() const;
+
+	// The change in the city's funds since the last save that causes the city to be saved, 0 disables the trigger.
+	int FundsChangeTriggerAmount() const;
+
+	// The number of seconds after the last event trigger before the triggered save is made.
+	int TriggerDebounceInSeconds() const;
+
+	// The shortest time between a triggered save and the previous save.
+	int TriggerMinimumSpacingInMinutes() const;
+
+	// The percentage of the process address space that causes an early save, 0 disables this threshold.
+	int AddressSpaceThresholdPercent() const;
+
+	// The committed memory in MB that causes an early save, 0 disables this threshold.
+	int CommittedMemoryThresholdInMB() const;
+
+	// The log messages will be written to the file by a background thread.
+	bool AsyncLogging() const;
+
+	// The total size of the event log files, 0 disables the event log.
+	int EventLogMaxSizeInMB() const;
+
+	// Changes to the settings file will be applied while the game is running.
+	bool HotReloadSettings() const;
+
+	// The game messages and auto-save decisions will be recorded to a trace file.
+	bool TraceMessages() const;
+
+	// The profile that is used for the cities that do not have a profile.
+	SaveProfile DefaultProfile() const;
+
+	// The profiles from the [City: Name] and [Region: Folder] sections.
+	const SaveProfiles& Profiles() const;
+
+	// Loads the settings from the file, the settings that are not in the file use their default values.
+	// Returns false if the file could not be read or any value is invalid, the errors for every
+	// invalid value are reported at once.
+	bool Load(const std::filesystem::path& path, std::string& errors);
 
 private:
 	int saveIntervalInMinutes;
+	int simIntervalInMonths;
 	bool fastSave;
+	int fullSaveIntervalInMinutes;
+	bool fullSaveOnCityClose;
+	bool saveOnFocusLoss;
+	int focusLossMinimumAgeInMinutes;
 	bool ignoreTimePaused;
 	bool logSaveEvents;
+	bool skipUnchangedSaves;
+	int saveSlotCount;
+	std::string saveSlotNameFormat;
+	std::filesystem::path backupDirectory;
+	bool compressBackups;
+	int compressionThreadCount;
+	bool pruneCompressedBackups;
+	int cityBackupQuotaInMB;
+	int totalBackupQuotaInMB;
+	int minimumFreeDiskSpaceInMB;
+	bool deduplicateBackups;
+	int deduplicatedGenerationCount;
+	bool catalogBackups;
+	bool verifySaves;
+	int verificationThreadCount;
+	bool recordSaveMetrics;
+	bool adaptiveInterval;
+	double stallBudgetPercent;
+	int minimumIntervalInMinutes;
+	int maximumIntervalInMinutes;
+	bool saveOnNewYear;
+	int fundsChangeTriggerAmount;
+	int triggerDebounceInSeconds;
+	int triggerMinimumSpacingInMinutes;
+	int addressSpaceThresholdPercent;
+	int committedMemoryThresholdInMB;
+	bool asyncLogging;
+	int eventLogMaxSizeInMB;
+	bool hotReloadSettings;
+	bool traceMessages;
+	SaveProfiles profiles;
 };
 
@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SettingsWatcher.h"
+#include "Logger.h"
+#include <array>
+#include <Windows.h>
+
+// Editors often write a file in several steps, the file is loaded after
+// it has not changed for this long.
+static constexpr DWORD SettleTimeInMilliseconds = 250;
+
+// The change records are DWORD aligned.
+static constexpr size_t ChangeBufferSizeInDwords = 1024;
+
+namespace
+{
+	// Returns true if one of the change records is for the specified file name.
+	// A read with no records means that the changes did not fit in the buffer,
+	// any file in the folder may have changed.
+	bool ContainsFileName(const DWORD* buffer, DWORD bytesReturned, const std::wstring& fileName)
+	{
+		if (bytesReturned == 0)
+		{
+			return true;
+		}
+
+		const uint8_t* record = reinterpret_cast<const uint8_t*>(buffer);
+
+		while (true)
+		{
+			const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+
+			if (CompareStringOrdinal(
+				info->FileName,
+				static_cast<int>(info->FileNameLength / sizeof(WCHAR)),
+				fileName.c_str(),
+				static_cast<int>(fileName.size()),
+				TRUE) == CSTR_EQUAL)
+			{
+				return true;
+			}
+
+			if (info->NextEntryOffset == 0)
+			{
+				break;
+			}
+
+			record += info->NextEntryOffset;
+		}
+
+		return false;
+	}
+
+	std::filesystem::file_time_type GetLastWriteTime(const std::filesystem::path& path)
+	{
+		std::error_code ec;
+		const std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+
+		return ec ? std::filesystem::file_time_type::min() : time;
+	}
+}
+
+SettingsWatcher::SettingsWatcher()
+	: filePath(),
+	  lastWriteTime(),
+	  thread(),
+	  stopEvent(nullptr),
+	  updatedSettings()
+{
+}
+
+SettingsWatcher::~SettingsWatcher()
+{
+	Stop();
+}
+
+bool SettingsWatcher::Start(const std::filesystem::path& path)
+{
+	if (thread.joinable())
+	{
+		return true;
+	}
+
+	stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+	if (!stopEvent)
+	{
+		return false;
+	}
+
+	filePath = path;
+	lastWriteTime = GetLastWriteTime(path);
+	thread = std::thread(&SettingsWatcher::ThreadProc, this);
+
+	return true;
+}
+
+void SettingsWatcher::Stop()
+{
+	if (!thread.joinable())
+	{
+		return;
+	}
+
+	SetEvent(stopEvent);
+	thread.join();
+
+	CloseHandle(stopEvent);
+	stopEvent = nullptr;
+	updatedSettings.store(nullptr);
+}
+
+std::shared_ptr<const Settings> SettingsWatcher::TakeUpdatedSettings()
+{
+	return updatedSettings.exchange(nullptr);
+}
+
+void SettingsWatcher::ThreadProc()
+{
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+	Logger& logger = Logger::GetInstance();
+
+	// The changes are reported for the folder, the names in the change records are used to
+	// ignore the other files in the plugin folder without waiting for them to settle.
+	// The log files are written to the same folder while the game is running.
+	HANDLE directory = CreateFileW(
+		filePath.parent_path().c_str(),
+		FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		nullptr);
+
+	if (directory == INVALID_HANDLE_VALUE)
+	{
+		logger.WriteLine(LogLevel::Error, "Failed to watch the settings file for changes.");
+		return;
+	}
+
+	HANDLE changeEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+	if (!changeEvent)
+	{
+		logger.WriteLine(LogLevel::Error, "Failed to watch the settings file for changes.");
+		CloseHandle(directory);
+		return;
+	}
+
+	const std::wstring fileName = filePath.filename().wstring();
+	std::array<DWORD, ChangeBufferSizeInDwords> buffer{};
+	const HANDLE handles[2] = { stopEvent, changeEvent };
+
+	while (true)
+	{
+		OVERLAPPED overlapped{};
+		overlapped.hEvent = changeEvent;
+
+		if (!ReadDirectoryChangesW(
+			directory,
+			buffer.data(),
+			static_cast<DWORD>(buffer.size() * sizeof(DWORD)),
+			FALSE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+			nullptr,
+			&overlapped,
+			nullptr))
+		{
+			logger.WriteLine(LogLevel::Error, "Failed to watch the settings file for changes.");
+			break;
+		}
+
+		const DWORD waitResult = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+		DWORD bytesReturned = 0;
+
+		if (waitResult != WAIT_OBJECT_0 + 1)
+		{
+			// The buffer must not be released while the read is pending.
+			CancelIoEx(directory, &overlapped);
+			GetOverlappedResult(directory, &overlapped, &bytesReturned, TRUE);
+			break;
+		}
+
+		if (!GetOverlappedResult(directory, &overlapped, &bytesReturned, FALSE))
+		{
+			logger.WriteLine(LogLevel::Error, "Failed to watch the settings file for changes.");
+			break;
+		}
+
+		if (!ContainsFileName(buffer.data(), bytesReturned, fileName))
+		{
+			continue;
+		}
+
+		// Wait for the file to settle, the stop event ends the wait early.
+		if (WaitForSingleObject(stopEvent, SettleTimeInMilliseconds) == WAIT_OBJECT_0)
+		{
+			break;
+		}
+
+		const std::filesystem::file_time_type writeTime = GetLastWriteTime(filePath);
+
+		if (writeTime != lastWriteTime && writeTime != std::filesystem::file_time_type::min())
+		{
+			lastWriteTime = writeTime;
+			LoadSettings();
+		}
+	}
+
+	CloseHandle(changeEvent);
+	CloseHandle(directory);
+}
+
+void SettingsWatcher::LoadSettings()
+{
+	Logger& logger = Logger::GetInstance();
+
+	auto settings = std::make_shared<Settings>();
+	std::string errors;
+
+	try
+	{
+		if (!settings->Load(filePath, errors))
+		{
+			logger.WriteLineFormatted(
+				LogLevel::Error,
+				"The changes to the settings file were rejected:\n%s",
+				errors.c_str());
+			return;
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		logger.WriteLineFormatted(
+			LogLevel::Error,
+			"The changes to the settings file were rejected: %s",
+			ex.what());
+		return;
+	}
+
+	// Replaces any snapshot that the main thread has not picked up yet.
+	updatedSettings.store(std::move(settings));
+}
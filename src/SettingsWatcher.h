@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "Settings.h"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+// Watches the settings file for changes on a background thread.
+//
+// When the file changes it is loaded and validated on the background thread,
+// the new settings are published as an immutable snapshot that the main thread
+// picks up with TakeUpdatedSettings. Settings that fail to load or validate are
+// written to the log and discarded, the previous settings remain in use.
+class SettingsWatcher
+{
+public:
+
+	SettingsWatcher();
+	~SettingsWatcher();
+
+	SettingsWatcher(const SettingsWatcher&) = delete;
+	SettingsWatcher& operator=(const SettingsWatcher&) = delete;
+
+	bool Start(const std::filesystem::path& path);
+
+	void Stop();
+
+	// Gets the settings that were loaded since the previous call, or nullptr
+	// if the file has not changed.
+	std::shared_ptr<const Settings> TakeUpdatedSettings();
+
+private:
+
+	void ThreadProc();
+
+	void LoadSettings();
+
+	std::filesystem::path filePath;
+	std::filesystem::file_time_type lastWriteTime;
+	std::thread thread;
+	void* stopEvent;
+	std::atomic<std::shared_ptr<const Settings>> updatedSettings;
+};
@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "Sha256.h"
+#include <algorithm>
+#include <cstring>
+#include <Windows.h>
+#include <bcrypt.h>
+
+#ifndef NT_SUCCESS
+#define NT_SUCCESS(Status) (((NTSTATUS)(Status)) >= 0)
+#endif
+
+std::string Sha256Digest::ToString() const
+{
+	static constexpr char HexDigits[] = "0123456789abcdef";
+
+	std::string text;
+	text.reserve(bytes.size() * 2);
+
+	for (uint8_t value : bytes)
+	{
+		text.push_back(HexDigits[value >> 4]);
+		text.push_back(HexDigits[value & 0x0f]);
+	}
+
+	return text;
+}
+
+size_t Sha256DigestHasher::operator()(const Sha256Digest& digest) const noexcept
+{
+	// The digest is already uniformly distributed, so the first bytes are a good hash code.
+	size_t value = 0;
+	std::memcpy(&value, digest.bytes.data(), sizeof(value));
+
+	return value;
+}
+
+Sha256::Sha256() : algorithmHandle(nullptr), hashHandle(nullptr)
+{
+	BCRYPT_ALG_HANDLE algorithm = nullptr;
+
+	if (NT_SUCCESS(BCryptOpenAlgorithmProvider(&algorithm, BCRYPT_SHA256_ALGORITHM, nullptr, BCRYPT_HASH_REUSABLE_FLAG)))
+	{
+		BCRYPT_HASH_HANDLE hash = nullptr;
+
+		if (NT_SUCCESS(BCryptCreateHash(algorithm, &hash, nullptr, 0, nullptr, 0, BCRYPT_HASH_REUSABLE_FLAG)))
+		{
+			algorithmHandle = algorithm;
+			hashHandle = hash;
+		}
+		else
+		{
+			BCryptCloseAlgorithmProvider(algorithm, 0);
+		}
+	}
+}
+
+Sha256::~Sha256()
+{
+	if (hashHandle)
+	{
+		BCryptDestroyHash(hashHandle);
+		hashHandle = nullptr;
+	}
+
+	if (algorithmHandle)
+	{
+		BCryptCloseAlgorithmProvider(algorithmHandle, 0);
+		algorithmHandle = nullptr;
+	}
+}
+
+bool Sha256::IsValid() const
+{
+	return hashHandle != nullptr;
+}
+
+bool Sha256::Update(const void* data, size_t length)
+{
+	if (!hashHandle)
+	{
+		return false;
+	}
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	while (length > 0)
+	{
+		const ULONG chunkLength = static_cast<ULONG>(std::min<size_t>(length, 0x7fffffff));
+
+		if (!NT_SUCCESS(BCryptHashData(hashHandle, const_cast<PUCHAR>(bytes), chunkLength, 0)))
+		{
+			return false;
+		}
+
+		bytes += chunkLength;
+		length -= chunkLength;
+	}
+
+	return true;
+}
+
+bool Sha256::Finish(Sha256Digest& digest)
+{
+	if (!hashHandle)
+	{
+		return false;
+	}
+
+	return NT_SUCCESS(BCryptFinishHash(
+		hashHandle,
+		digest.bytes.data(),
+		static_cast<ULONG>(digest.bytes.size()),
+		0));
+}
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <array>
+#include <stdint.h>
+#include <string>
+
+struct Sha256Digest
+{
+	std::array<uint8_t, 32> bytes;
+
+	std::string ToString() const;
+
+	bool operator==(const Sha256Digest& other) const = default;
+};
+
+struct Sha256DigestHasher
+{
+	size_t operator()(const Sha256Digest& digest) const noexcept;
+};
+
+// Computes SHA-256 hashes using the Windows CNG API.
+// The hash object is reused after each call to Finish.
+class Sha256
+{
+public:
+
+	Sha256();
+	~Sha256();
+
+	Sha256(const Sha256&) = delete;
+	Sha256& operator=(const Sha256&) = delete;
+
+	bool IsValid() const;
+
+	bool Update(const void* data, size_t length);
+
+	bool Finish(Sha256Digest& digest);
+
+private:
+
+	void* algorithmHandle;
+	void* hashHandle;
+};
+
@@ -11,7 +11,12 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "Stopwatch.h"
+
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <chrono>
+#endif
 
 // This code is based on the .NET runtime Stopwatch and TimeSpan types.
 
@@ -28,20 +33,31 @@ namespace
 
 	int64_t GetTimeStamp()
 	{
+#ifdef _WIN32
 		LARGE_INTEGER li{};
 
 		QueryPerformanceCounter(&li);
 
 		return li.QuadPart;
+#else
+		// The time stamp is in ticks, so the frequency is 1.
+		typedef std::chrono::duration<int64_t, std::ratio<1, TicksPerSecond>> Ticks;
+
+		return std::chrono::duration_cast<Ticks>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
 	}
 
 	int64_t GetTickFrequency()
 	{
+#ifdef _WIN32
 		LARGE_INTEGER li{};
 
 		QueryPerformanceFrequency(&li);
 
 		return TicksPerSecond / li.QuadPart;
+#else
+		return 1;
+#endif
 	}
 }
 
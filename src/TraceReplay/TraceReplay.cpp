@@ -0,0 +1,715 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+// Replays a message trace that was recorded by the plugin through the auto-save
+// scheduling logic, this allows a scheduling policy to be compared against a
+// real play session without running the game.
+//
+// It can also generate a synthetic session and drive the scheduling logic from a
+// virtual clock one idle callback at a time, this soak tests thousands of hours of
+// play in seconds and measures the cost of each idle callback and the timing drift.
+// The session includes pauses that the game did not send a message for, the soak
+// test fails if a save is made while the simulator is paused.
+//
+// Only SaveController is tested, cGZAutoSaveService is not part of this tool because it
+// depends on the GZCOM interfaces of the running game, Win32 timers and the game's save call.
+//
+// Usage: TraceReplay <trace file> [options]
+//        TraceReplay --soak <hours> [options]
+//   --interval <minutes>   Use a fixed save interval instead of the recorded intervals.
+//   --count-paused         The time that the game is paused counts towards the next save.
+//   --save-time <ms>       The time that each simulated save takes, defaults to the
+//                          average of the recorded saves.
+//   --list                 Print each recorded and simulated save.
+//   --dump                 Print each record in the trace.
+//   --seed <value>         The random seed for the soak test session, defaults to 1.
+//   --tick <ms>            The time between idle callbacks in the soak test, defaults to 33 ms.
+
+#include "../MessageTrace.h"
+#include "../SaveController.h"
+#include "../SC4Messages.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr int64_t MillisecondsPerMinute = 60 * 1000;
+
+namespace
+{
+	struct ReplayOptions
+	{
+		int64_t intervalMilliseconds = -1;
+		bool ignoreTimePaused = true;
+		int64_t saveMilliseconds = -1;
+		bool list = false;
+		bool dump = false;
+		const char* traceFilePath = nullptr;
+		int64_t soakHours = 0;
+		uint32_t seed = 1;
+		int64_t tickMilliseconds = 33;
+	};
+
+	struct SaveEvent
+	{
+		int64_t time;
+		int64_t saveMilliseconds;
+		int64_t deferredMilliseconds;
+	};
+
+	// The director's message handling and the service's save loop, driven by the recorded clock.
+	//
+	// When the session is idle driven, the saves are only made from the Idle method in the same
+	// way as the service's OnIdle callback. Otherwise the save times are computed exactly from
+	// the schedule at each record.
+	class ReplaySession
+	{
+	public:
+
+		ReplaySession(const ReplayOptions& options, bool idleDriven)
+			: options(options),
+			  idleDriven(idleDriven),
+			  controller(),
+			  saves(),
+			  lastTime(0),
+			  maximumIdleLatency(0)
+		{
+			if (options.intervalMilliseconds > 0)
+			{
+				controller.GetScheduler().SetIntervalInMilliseconds(options.intervalMilliseconds, 0);
+			}
+		}
+
+		void Replay(const TraceRecord& record)
+		{
+			const int64_t now = static_cast<int64_t>(record.timestamp / 1000);
+
+			if (!idleDriven)
+			{
+				AdvanceTo(now);
+			}
+
+			switch (static_cast<TraceRecordType>(record.recordType))
+			{
+			case TraceRecordType::Message:
+				controller.HandleMessage(record.messageType, record.data1, options.ignoreTimePaused, now);
+				break;
+			case TraceRecordType::BlockersChanged:
+				// The polled blockers are only recorded while a save is due, the
+				// last known state is used until the next record.
+				controller.GetReadiness().SetPolledBlockers(record.value, now);
+				break;
+			case TraceRecordType::IntervalChanged:
+				if (options.intervalMilliseconds <= 0)
+				{
+					controller.GetScheduler().SetIntervalInMilliseconds(record.value, now);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		void Finish(int64_t now)
+		{
+			if (!idleDriven)
+			{
+				AdvanceTo(now);
+			}
+		}
+
+		// The service's OnIdle callback.
+		void Idle(int64_t now)
+		{
+			const SaveScheduler& scheduler = controller.GetScheduler();
+			SaveReadiness& readiness = controller.GetReadiness();
+
+			if (controller.IsRunning() && scheduler.IsDue(now))
+			{
+				readiness.BeginDue(scheduler.GetDueTime());
+
+				if (readiness.IsReady())
+				{
+					const int64_t saveMilliseconds = std::max<int64_t>(options.saveMilliseconds, 0);
+					const int64_t deferredMilliseconds = readiness.GetDeferredMilliseconds(now);
+
+					// The time between the save becoming possible and the idle callback that made it.
+					const int64_t latency = now - scheduler.GetDueTime() - deferredMilliseconds;
+
+					maximumIdleLatency = std::max(maximumIdleLatency, latency);
+					saves.push_back(SaveEvent{ now, saveMilliseconds, deferredMilliseconds });
+
+					controller.SaveCompleted(now + saveMilliseconds);
+				}
+			}
+		}
+
+		const std::vector<SaveEvent>& GetSaves() const
+		{
+			return saves;
+		}
+
+		int64_t GetMaximumIdleLatency() const
+		{
+			return maximumIdleLatency;
+		}
+
+	private:
+
+		void AdvanceTo(int64_t now)
+		{
+			SaveScheduler& scheduler = controller.GetScheduler();
+
+			while (controller.IsRunning() && controller.GetReadiness().IsReady() && scheduler.GetDueTime() <= now)
+			{
+				// A save that was blocked happens when the last blocker was cleared.
+				const int64_t dueTime = scheduler.GetDueTime();
+				const int64_t saveTime = std::max(dueTime, lastTime);
+				const int64_t saveMilliseconds = std::max<int64_t>(options.saveMilliseconds, 0);
+
+				saves.push_back(SaveEvent{ saveTime, saveMilliseconds, saveTime - dueTime });
+
+				// The game does not run while it is saving.
+				scheduler.Restart(saveTime + saveMilliseconds);
+			}
+
+			lastTime = std::max(lastTime, now);
+		}
+
+		const ReplayOptions& options;
+		const bool idleDriven;
+		SaveController controller;
+		std::vector<SaveEvent> saves;
+		int64_t lastTime;
+		int64_t maximumIdleLatency;
+	};
+
+	std::string FormatTime(int64_t milliseconds)
+	{
+		const int64_t totalSeconds = milliseconds / 1000;
+
+		char buffer[64]{};
+
+		std::snprintf(
+			buffer,
+			sizeof(buffer),
+			"%02lld:%02lld:%02lld.%03lld",
+			static_cast<long long>(totalSeconds / 3600),
+			static_cast<long long>((totalSeconds / 60) % 60),
+			static_cast<long long>(totalSeconds % 60),
+			static_cast<long long>(milliseconds % 1000));
+
+		return std::string(buffer);
+	}
+
+	const char* GetRecordTypeName(uint32_t recordType)
+	{
+		switch (static_cast<TraceRecordType>(recordType))
+		{
+		case TraceRecordType::Message:
+			return "Message";
+		case TraceRecordType::TimerStarted:
+			return "TimerStarted";
+		case TraceRecordType::TimerStopped:
+			return "TimerStopped";
+		case TraceRecordType::SaveDue:
+			return "SaveDue";
+		case TraceRecordType::BlockersChanged:
+			return "BlockersChanged";
+		case TraceRecordType::SaveCompleted:
+			return "SaveCompleted";
+		case TraceRecordType::IntervalChanged:
+			return "IntervalChanged";
+		case TraceRecordType::SaveSkipped:
+			return "SaveSkipped";
+		default:
+			return "Unknown";
+		}
+	}
+
+	void PrintSummary(const char* name, const std::vector<SaveEvent>& saves, int64_t duration, bool list)
+	{
+		int64_t totalSaveTime = 0;
+		int64_t totalDeferredTime = 0;
+		int64_t maximumDeferredTime = 0;
+		int64_t longestGap = 0;
+
+		for (size_t i = 0; i < saves.size(); i++)
+		{
+			const SaveEvent& save = saves[i];
+
+			totalSaveTime += save.saveMilliseconds;
+			totalDeferredTime += save.deferredMilliseconds;
+			maximumDeferredTime = std::max(maximumDeferredTime, save.deferredMilliseconds);
+			longestGap = std::max(longestGap, save.time - (i > 0 ? saves[i - 1].time : 0));
+
+			if (list)
+			{
+				std::printf(
+					"  %s  save %lld ms, deferred %lld ms\n",
+					FormatTime(save.time).c_str(),
+					static_cast<long long>(save.saveMilliseconds),
+					static_cast<long long>(save.deferredMilliseconds));
+			}
+		}
+
+		std::printf("%s: %zu saves", name, saves.size());
+
+		if (!saves.empty())
+		{
+			std::printf(
+				", %.1f%% of the time saving, longest time without a save %s, deferred %s in total (maximum %s)",
+				duration > 0 ? (100.0 * static_cast<double>(totalSaveTime) / static_cast<double>(duration)) : 0.0,
+				FormatTime(longestGap).c_str(),
+				FormatTime(totalDeferredTime).c_str(),
+				FormatTime(maximumDeferredTime).c_str());
+		}
+
+		std::printf("\n");
+	}
+
+	bool ParseOptions(int argc, char** argv, ReplayOptions& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+			{
+				options.intervalMilliseconds = std::atoll(argv[++i]) * MillisecondsPerMinute;
+			}
+			else if (std::strcmp(argv[i], "--save-time") == 0 && i + 1 < argc)
+			{
+				options.saveMilliseconds = std::atoll(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--soak") == 0 && i + 1 < argc)
+			{
+				options.soakHours = std::atoll(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			{
+				options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (std::strcmp(argv[i], "--tick") == 0 && i + 1 < argc)
+			{
+				options.tickMilliseconds = std::max<int64_t>(std::atoll(argv[++i]), 1);
+			}
+			else if (std::strcmp(argv[i], "--count-paused") == 0)
+			{
+				options.ignoreTimePaused = false;
+			}
+			else if (std::strcmp(argv[i], "--list") == 0)
+			{
+				options.list = true;
+			}
+			else if (std::strcmp(argv[i], "--dump") == 0)
+			{
+				options.dump = true;
+			}
+			else if (argv[i][0] != '-' && !options.traceFilePath)
+			{
+				options.traceFilePath = argv[i];
+			}
+			else
+			{
+				std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+				return false;
+			}
+		}
+
+		return options.traceFilePath != nullptr || options.soakHours > 0;
+	}
+
+	void AddRecord(
+		std::vector<TraceRecord>& records,
+		int64_t time,
+		TraceRecordType type,
+		uint32_t messageType,
+		uint32_t data1,
+		uint32_t value)
+	{
+		TraceRecord record{};
+		record.timestamp = static_cast<uint64_t>(time) * 1000;
+		record.recordType = static_cast<uint32_t>(type);
+		record.messageType = messageType;
+		record.data1 = data1;
+		record.value = value;
+
+		records.push_back(record);
+	}
+
+	// Adds periods where a condition is active, the gaps and durations are uniformly distributed.
+	template<typename StartFunc, typename EndFunc>
+	void AddPeriods(
+		std::mt19937& random,
+		int64_t sessionLength,
+		int64_t minimumGap,
+		int64_t maximumGap,
+		int64_t minimumDuration,
+		int64_t maximumDuration,
+		StartFunc start,
+		EndFunc end)
+	{
+		std::uniform_int_distribution<int64_t> gap(minimumGap, maximumGap);
+		std::uniform_int_distribution<int64_t> duration(minimumDuration, maximumDuration);
+
+		int64_t time = gap(random);
+
+		while (time < sessionLength)
+		{
+			const int64_t endTime = std::min(time + duration(random), sessionLength);
+
+			start(time);
+			end(endTime);
+
+			time = endTime + gap(random);
+		}
+	}
+
+	struct PolledChange
+	{
+		int64_t time;
+		SaveBlocker blocker;
+		bool blocked;
+	};
+
+	struct TimePeriod
+	{
+		int64_t start;
+		int64_t end;
+	};
+
+	// Adds BlockersChanged records for the polled blockers, each record has the state of all of them.
+	void AddPolledRecords(std::vector<TraceRecord>& records, std::vector<PolledChange>& changes)
+	{
+		std::stable_sort(
+			changes.begin(),
+			changes.end(),
+			[](const PolledChange& a, const PolledChange& b) { return a.time < b.time; });
+
+		uint32_t blockers = 0;
+
+		for (const PolledChange& change : changes)
+		{
+			if (change.blocked)
+			{
+				blockers |= static_cast<uint32_t>(change.blocker);
+			}
+			else
+			{
+				blockers &= ~static_cast<uint32_t>(change.blocker);
+			}
+
+			AddRecord(records, change.time, TraceRecordType::BlockersChanged, 0, 0, blockers);
+		}
+	}
+
+	// Generates a play session with random pauses, focus changes and modal dialogs.
+	// Some of the pauses are only visible to the poll, the game did not send a pause message.
+	std::vector<TraceRecord> GenerateSession(const ReplayOptions& options, std::vector<TimePeriod>& unreportedPauses)
+	{
+		constexpr int64_t MillisecondsPerSecond = 1000;
+
+		const int64_t sessionLength = options.soakHours * 60 * MillisecondsPerMinute;
+
+		std::mt19937 random(options.seed);
+		std::vector<TraceRecord> records;
+
+		AddRecord(records, 0, TraceRecordType::IntervalChanged, 0, 0, static_cast<uint32_t>(15 * MillisecondsPerMinute));
+		AddRecord(records, 0, TraceRecordType::Message, kSC4MessagePostCityInit, 1, 0);
+
+		AddPeriods(
+			random,
+			sessionLength,
+			5 * MillisecondsPerMinute,
+			60 * MillisecondsPerMinute,
+			10 * MillisecondsPerSecond,
+			10 * MillisecondsPerMinute,
+			[&](int64_t time) { AddRecord(records, time, TraceRecordType::Message, kSC4MessageSimPauseChange, 1, 0); },
+			[&](int64_t time) { AddRecord(records, time, TraceRecordType::Message, kSC4MessageSimPauseChange, 0, 0); });
+
+		AddPeriods(
+			random,
+			sessionLength,
+			10 * MillisecondsPerMinute,
+			90 * MillisecondsPerMinute,
+			5 * MillisecondsPerSecond,
+			5 * MillisecondsPerMinute,
+			[&](int64_t time) { AddRecord(records, time, TraceRecordType::Message, kMessageTypeAppGainLoseFocus, 0, 0); },
+			[&](int64_t time) { AddRecord(records, time, TraceRecordType::Message, kMessageTypeAppGainLoseFocus, 1, 0); });
+
+		std::vector<PolledChange> polledChanges;
+
+		AddPeriods(
+			random,
+			sessionLength,
+			5 * MillisecondsPerMinute,
+			30 * MillisecondsPerMinute,
+			1 * MillisecondsPerSecond,
+			60 * MillisecondsPerSecond,
+			[&](int64_t time) { polledChanges.push_back(PolledChange{ time, SaveBlocker::ModalDialog, true }); },
+			[&](int64_t time) { polledChanges.push_back(PolledChange{ time, SaveBlocker::ModalDialog, false }); });
+
+		AddPeriods(
+			random,
+			sessionLength,
+			30 * MillisecondsPerMinute,
+			120 * MillisecondsPerMinute,
+			1 * MillisecondsPerMinute,
+			20 * MillisecondsPerMinute,
+			[&](int64_t time)
+			{
+				polledChanges.push_back(PolledChange{ time, SaveBlocker::SimulatorPaused, true });
+				unreportedPauses.push_back(TimePeriod{ time, time });
+			},
+			[&](int64_t time)
+			{
+				polledChanges.push_back(PolledChange{ time, SaveBlocker::SimulatorPaused, false });
+				unreportedPauses.back().end = time;
+			});
+
+		AddPolledRecords(records, polledChanges);
+
+		AddRecord(records, sessionLength, TraceRecordType::Message, kSC4MessagePreCityShutdown, 0, 0);
+
+		std::stable_sort(
+			records.begin(),
+			records.end(),
+			[](const TraceRecord& a, const TraceRecord& b) { return a.timestamp < b.timestamp; });
+
+		return records;
+	}
+
+	// Counts the saves that started while the simulator was paused without a pause message.
+	size_t CountSavesDuringPauses(const std::vector<SaveEvent>& saves, const std::vector<TimePeriod>& pauses)
+	{
+		size_t count = 0;
+
+		for (const SaveEvent& save : saves)
+		{
+			for (const TimePeriod& pause : pauses)
+			{
+				if (save.time >= pause.start && save.time < pause.end)
+				{
+					count++;
+					break;
+				}
+			}
+		}
+
+		return count;
+	}
+
+	int RunSoakTest(ReplayOptions& options)
+	{
+		std::vector<TimePeriod> unreportedPauses;
+		const std::vector<TraceRecord> records = GenerateSession(options, unreportedPauses);
+		const int64_t sessionLength = static_cast<int64_t>(records.back().timestamp / 1000);
+
+		if (options.saveMilliseconds < 0)
+		{
+			options.saveMilliseconds = 2000;
+		}
+
+		ReplaySession session(options, true);
+
+		const auto startTime = std::chrono::steady_clock::now();
+
+		size_t nextRecord = 0;
+		uint64_t idleCount = 0;
+
+		for (int64_t now = 0; now <= sessionLength; now += options.tickMilliseconds)
+		{
+			while (nextRecord < records.size() && static_cast<int64_t>(records[nextRecord].timestamp / 1000) <= now)
+			{
+				session.Replay(records[nextRecord]);
+				nextRecord++;
+			}
+
+			session.Idle(now);
+			idleCount++;
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - startTime).count();
+
+		std::printf(
+			"Soak test: %lld hours, %zu records, %llu idle callbacks (%lld ms tick) in %.1f ms, %.1f ns per idle callback\n",
+			static_cast<long long>(options.soakHours),
+			records.size(),
+			static_cast<unsigned long long>(idleCount),
+			static_cast<long long>(options.tickMilliseconds),
+			static_cast<double>(elapsed) / 1e6,
+			idleCount > 0 ? static_cast<double>(elapsed) / static_cast<double>(idleCount) : 0.0);
+
+		// The drift is the time between a save becoming possible and the idle callback
+		// that made it, it should never be more than one tick.
+		std::printf(
+			"Maximum timing drift: %lld ms\n",
+			static_cast<long long>(session.GetMaximumIdleLatency()));
+
+		PrintSummary("Simulated", session.GetSaves(), sessionLength, options.list);
+
+		// The poll must block the saves when the game did not send a pause message.
+		const size_t pausedSaveCount = CountSavesDuringPauses(session.GetSaves(), unreportedPauses);
+
+		std::printf(
+			"Saves during %zu unreported pauses: %zu\n",
+			unreportedPauses.size(),
+			pausedSaveCount);
+
+		if (pausedSaveCount > 0)
+		{
+			return 3;
+		}
+
+		return session.GetMaximumIdleLatency() <= options.tickMilliseconds ? 0 : 2;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ReplayOptions options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::fprintf(
+			stderr,
+			"Usage: TraceReplay <trace file> [--interval <minutes>] [--count-paused] [--save-time <ms>] [--list] [--dump]\n"
+			"       TraceReplay --soak <hours> [--seed <value>] [--tick <ms>] [--interval <minutes>] [--count-paused] [--save-time <ms>] [--list]\n");
+		return 1;
+	}
+
+	if (options.soakHours > 0)
+	{
+		return RunSoakTest(options);
+	}
+
+	std::vector<TraceRecord> records;
+	std::string errorMessage;
+
+	if (!MessageTrace::ReadFile(options.traceFilePath, records, errorMessage))
+	{
+		std::fprintf(stderr, "%s\n", errorMessage.c_str());
+		return 1;
+	}
+
+	if (records.empty())
+	{
+		std::printf("The trace is empty.\n");
+		return 0;
+	}
+
+	std::vector<SaveEvent> recordedSaves;
+	int64_t recordedDueTime = -1;
+
+	for (const TraceRecord& record : records)
+	{
+		const int64_t now = static_cast<int64_t>(record.timestamp / 1000);
+
+		if (options.dump)
+		{
+			std::printf(
+				"%s  %-15s type=0x%08X data1=%u value=%u\n",
+				FormatTime(now).c_str(),
+				GetRecordTypeName(record.recordType),
+				record.messageType,
+				record.data1,
+				record.value);
+		}
+
+		if (record.recordType == static_cast<uint32_t>(TraceRecordType::SaveDue))
+		{
+			recordedDueTime = now;
+		}
+		else if (record.recordType == static_cast<uint32_t>(TraceRecordType::SaveCompleted) && record.data1 != 0)
+		{
+			// The save completed record is written after the save, its timestamp includes the save time.
+			const int64_t saveTime = now - record.value;
+
+			recordedSaves.push_back(SaveEvent{
+				saveTime,
+				record.value,
+				recordedDueTime >= 0 ? std::max<int64_t>(saveTime - recordedDueTime, 0) : 0 });
+			recordedDueTime = -1;
+		}
+		else if (record.recordType == static_cast<uint32_t>(TraceRecordType::SaveSkipped))
+		{
+			recordedDueTime = -1;
+		}
+	}
+
+	if (options.saveMilliseconds < 0)
+	{
+		int64_t total = 0;
+
+		for (const SaveEvent& save : recordedSaves)
+		{
+			total += save.saveMilliseconds;
+		}
+
+		options.saveMilliseconds = recordedSaves.empty() ? 0 : total / static_cast<int64_t>(recordedSaves.size());
+	}
+
+	ReplaySession session(options, false);
+
+	for (const TraceRecord& record : records)
+	{
+		session.Replay(record);
+	}
+
+	const int64_t duration = static_cast<int64_t>(records.back().timestamp / 1000);
+
+	session.Finish(duration);
+
+	std::printf("Trace: %zu records, %s\n", records.size(), FormatTime(duration).c_str());
+
+	if (options.list)
+	{
+		std::printf("Recorded saves:\n");
+	}
+
+	PrintSummary("Recorded", recordedSaves, duration, options.list);
+
+	if (options.list)
+	{
+		std::printf("Simulated saves:\n");
+	}
+
+	char name[128]{};
+
+	if (options.intervalMilliseconds > 0)
+	{
+		std::snprintf(
+			name,
+			sizeof(name),
+			"Simulated (%lld minute interval, %s, %lld ms per save)",
+			static_cast<long long>(options.intervalMilliseconds / MillisecondsPerMinute),
+			options.ignoreTimePaused ? "paused time ignored" : "paused time counted",
+			static_cast<long long>(options.saveMilliseconds));
+	}
+	else
+	{
+		std::snprintf(
+			name,
+			sizeof(name),
+			"Simulated (recorded intervals, %s, %lld ms per save)",
+			options.ignoreTimePaused ? "paused time ignored" : "paused time counted",
+			static_cast<long long>(options.saveMilliseconds));
+	}
+
+	PrintSummary(name, session.GetSaves(), duration, options.list);
+
+	return 0;
+}
@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../BackupCatalog.h"
+#include <array>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	BackupCatalogRecord CreateRecord(uint32_t citySerialNumber, int32_t population, std::string_view cityName)
+	{
+		BackupCatalogRecord record{};
+		record.time = 1700000000 + population;
+		record.citySerialNumber = citySerialNumber;
+		record.population = population;
+		BackupCatalog::SetText(record.cityName, cityName);
+		BackupCatalog::SetText(record.simDate, "2001-02-03");
+
+		return record;
+	}
+
+	bool WriteJournal(const std::filesystem::path& folder, const void* data, size_t length)
+	{
+		return WriteTextFile(
+			folder / BackupCatalog::JournalFileName,
+			std::string_view(static_cast<const char*>(data), length));
+	}
+
+	void TestText()
+	{
+		BackupCatalogRecord record{};
+
+		BackupCatalog::SetText(record.simDate, "A date that is longer than the field");
+
+		CHECK(BackupCatalog::GetText(record.simDate) == "A date that is ");
+
+		BackupCatalog::SetText(record.simDate, "Short");
+
+		CHECK(BackupCatalog::GetText(record.simDate) == "Short");
+	}
+
+	void TestMissingCatalog()
+	{
+		BackupCatalog catalog;
+
+		CHECK(!catalog.Open(GetTestFolder("MissingCatalog")));
+		CHECK(catalog.GetRecords().empty());
+	}
+
+	void TestAppendAndOpen()
+	{
+		const std::filesystem::path folder = GetTestFolder("Catalog");
+
+		for (int32_t i = 0; i < 3; i++)
+		{
+			BackupCatalogRecord record = CreateRecord(7, i * 100, "City " + std::to_string(i));
+
+			CHECK(BackupCatalog::Append(folder, record));
+			CHECK(record.sequence == static_cast<uint64_t>(i));
+		}
+
+		BackupCatalog catalog;
+
+		CHECK(catalog.Open(folder));
+
+		const std::span<const BackupCatalogRecord> records = catalog.GetRecords();
+
+		CHECK(records.size() == 3);
+
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			CHECK(BackupCatalog::IsRecordValid(records[i]));
+			CHECK(records[i].sequence == i);
+			CHECK(records[i].population == static_cast<int32_t>(i * 100));
+			CHECK(BackupCatalog::GetText(records[i].cityName) == "City " + std::to_string(i));
+			CHECK(BackupCatalog::GetText(records[i].simDate) == "2001-02-03");
+		}
+	}
+
+	// The appends are serialized by the journal lock, each thread opens its own
+	// file handles in the same way as separate game instances.
+	void TestConcurrentAppends()
+	{
+		constexpr uint32_t ThreadCount = 4;
+		constexpr int32_t AppendsPerThread = 250;
+
+		const std::filesystem::path folder = GetTestFolder("ConcurrentCatalog");
+
+		std::array<bool, ThreadCount> appended{};
+		std::vector<std::thread> threads;
+
+		for (uint32_t i = 0; i < ThreadCount; i++)
+		{
+			threads.emplace_back(
+				[&folder, &appended, i]()
+				{
+					bool result = true;
+
+					for (int32_t j = 0; j < AppendsPerThread; j++)
+					{
+						BackupCatalogRecord record = CreateRecord(i, j, "Concurrent");
+						result &= BackupCatalog::Append(folder, record);
+					}
+
+					appended[i] = result;
+				});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		for (bool result : appended)
+		{
+			CHECK(result);
+		}
+
+		BackupCatalog catalog;
+
+		CHECK(catalog.Open(folder));
+
+		const std::span<const BackupCatalogRecord> records = catalog.GetRecords();
+		std::array<int32_t, ThreadCount> recordCounts{};
+		size_t invalidRecords = 0;
+
+		CHECK(records.size() == ThreadCount * AppendsPerThread);
+
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			if (!BackupCatalog::IsRecordValid(records[i])
+				|| records[i].sequence != i
+				|| records[i].citySerialNumber >= ThreadCount)
+			{
+				invalidRecords++;
+				continue;
+			}
+
+			// The records from each thread are in the order that they were appended.
+			CHECK(records[i].population == recordCounts[records[i].citySerialNumber]);
+			recordCounts[records[i].citySerialNumber]++;
+		}
+
+		CHECK(invalidRecords == 0);
+
+		for (int32_t count : recordCounts)
+		{
+			CHECK(count == AppendsPerThread);
+		}
+	}
+
+	// A record that was journaled but not committed is appended before the next record.
+	void TestJournalReplay()
+	{
+		const std::filesystem::path folder = GetTestFolder("JournalCatalog");
+		const std::filesystem::path scratchFolder = GetTestFolder("JournalScratch");
+
+		for (int32_t i = 0; i < 3; i++)
+		{
+			BackupCatalogRecord record = CreateRecord(1, i, "Committed");
+			CHECK(BackupCatalog::Append(folder, record));
+		}
+
+		// The scratch catalog is used to set the sequence and checksum of the journaled record.
+		BackupCatalogRecord journaled{};
+
+		for (int32_t i = 0; i < 4; i++)
+		{
+			journaled = CreateRecord(1, 1000 + i, "Journaled");
+			CHECK(BackupCatalog::Append(scratchFolder, journaled));
+		}
+
+		CHECK(journaled.sequence == 3);
+		CHECK(WriteJournal(folder, &journaled, sizeof(journaled)));
+
+		BackupCatalogRecord record = CreateRecord(1, 4, "Next");
+
+		CHECK(BackupCatalog::Append(folder, record));
+		CHECK(record.sequence == 4);
+		CHECK(std::filesystem::file_size(folder / BackupCatalog::JournalFileName) == 0);
+
+		BackupCatalog catalog;
+
+		CHECK(catalog.Open(folder));
+
+		const std::span<const BackupCatalogRecord> records = catalog.GetRecords();
+
+		CHECK(records.size() == 5);
+
+		if (records.size() == 5)
+		{
+			CHECK(BackupCatalog::IsRecordValid(records[3]));
+			CHECK(records[3].population == 1003);
+			CHECK(BackupCatalog::GetText(records[3].cityName) == "Journaled");
+			CHECK(BackupCatalog::GetText(records[4].cityName) == "Next");
+		}
+	}
+
+	// A partially written journal record is discarded, the catalog is unchanged.
+	void TestTornJournal()
+	{
+		const std::filesystem::path folder = GetTestFolder("TornJournalCatalog");
+
+		BackupCatalogRecord record = CreateRecord(1, 1, "Committed");
+
+		CHECK(BackupCatalog::Append(folder, record));
+		CHECK(WriteJournal(folder, &record, sizeof(record) / 2));
+
+		record = CreateRecord(1, 2, "Next");
+
+		CHECK(BackupCatalog::Append(folder, record));
+		CHECK(record.sequence == 1);
+		CHECK(std::filesystem::file_size(folder / BackupCatalog::JournalFileName) == 0);
+
+		BackupCatalog catalog;
+
+		CHECK(catalog.Open(folder));
+		CHECK(catalog.GetRecords().size() == 2);
+	}
+}
+
+void RunBackupCatalogTests()
+{
+	TestText();
+	TestMissingCatalog();
+	TestAppendAndOpen();
+	TestConcurrentAppends();
+	TestJournalReplay();
+	TestTornJournal();
+}
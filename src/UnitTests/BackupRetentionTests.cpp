@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../BackupRetention.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+static constexpr int64_t SecondsPerHour = 60 * 60;
+static constexpr int64_t SecondsPerDay = 24 * SecondsPerHour;
+
+namespace
+{
+	bool CreateBackupFile(const std::filesystem::path& path, size_t size, int64_t ageInSeconds)
+	{
+		if (!WriteTextFile(path, std::string(size, 'x')))
+		{
+			return false;
+		}
+
+		std::error_code ec;
+		std::filesystem::last_write_time(
+			path,
+			std::filesystem::file_time_type::clock::now() - std::chrono::seconds(ageInSeconds),
+			ec);
+
+		return !ec;
+	}
+
+	size_t CountFiles(const std::filesystem::path& folder)
+	{
+		size_t count = 0;
+		std::error_code ec;
+
+		for (std::filesystem::directory_iterator it(folder, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+		{
+			std::error_code typeError;
+
+			if (it->is_regular_file(typeError))
+			{
+				count++;
+			}
+		}
+
+		return count;
+	}
+
+	// A backup every 15 minutes for 60 days keeps every backup from the last hour,
+	// one per hour for the last day, one per day for the last 30 days and one per week.
+	void TestSelectGenerations()
+	{
+		const int64_t now = (1000 * SecondsPerDay) + (5 * SecondsPerHour);
+
+		std::vector<int64_t> times;
+
+		for (int64_t time = now - (60 * SecondsPerDay); time <= now; time += 15 * 60)
+		{
+			times.push_back(time);
+		}
+
+		const std::vector<bool> keep = BackupRetention::SelectGenerations(times, now);
+
+		CHECK(keep.size() == times.size());
+		CHECK(keep.back());
+
+		size_t hourCount = 0;
+		size_t dayCount = 0;
+		size_t monthCount = 0;
+		size_t olderCount = 0;
+
+		for (size_t i = 0; i < times.size() && i < keep.size(); i++)
+		{
+			if (keep[i])
+			{
+				const int64_t age = now - times[i];
+
+				if (age < SecondsPerHour)
+				{
+					hourCount++;
+				}
+				else if (age < SecondsPerDay)
+				{
+					dayCount++;
+				}
+				else if (age < 30 * SecondsPerDay)
+				{
+					monthCount++;
+				}
+				else
+				{
+					olderCount++;
+				}
+			}
+		}
+
+		CHECK(hourCount == 4);
+		CHECK(dayCount == 24);
+		CHECK(monthCount == 30);
+		CHECK(olderCount == 5);
+	}
+
+	// The file system clock epoch can be after the backup times.
+	void TestSelectGenerationsBeforeEpoch()
+	{
+		std::vector<int64_t> times;
+
+		for (int64_t time = -10 * SecondsPerDay; time <= -SecondsPerDay; time += SecondsPerHour)
+		{
+			times.push_back(time);
+		}
+
+		const std::vector<bool> keep = BackupRetention::SelectGenerations(times, 0);
+
+		size_t keptCount = 0;
+
+		for (bool value : keep)
+		{
+			if (value)
+			{
+				keptCount++;
+			}
+		}
+
+		CHECK(keptCount == 10);
+	}
+
+	void TestMissingRootFolder()
+	{
+		BackupRetention retention;
+
+		retention.SetPolicy(true, 1, 1);
+		retention.Load(GetTestFolder("MissingRetention") / "Missing");
+
+		const BackupPruneResult result = retention.Prune(BackupRetention::GetFileSystemTime(), std::stop_token());
+
+		CHECK(result.deletedCount == 0);
+		CHECK(result.failedCount == 0);
+		CHECK(result.totalBytes == 0);
+	}
+
+	void TestPrune()
+	{
+		const std::filesystem::path root = GetTestFolder("Retention");
+		const std::filesystem::path cityA = root / "Region" / "CityA";
+		const std::filesystem::path cityB = root / "Region" / "CityB";
+
+		std::error_code ec;
+		std::filesystem::create_directories(cityA / "Store", ec);
+		std::filesystem::create_directories(cityB, ec);
+
+		bool created = true;
+
+		// A backup every 30 minutes for a day, the generation schedule keeps all of them.
+		for (int i = 0; i < 48; i++)
+		{
+			created &= CreateBackupFile(cityA / ("A " + std::to_string(i) + ".sc4.gz"), 1000, (i * 30 * 60) + 120);
+		}
+
+		// Weekly backups, the oldest ones are deleted by the total quota.
+		for (int i = 0; i < 5; i++)
+		{
+			created &= CreateBackupFile(cityB / ("B " + std::to_string(i) + ".sc4.gz"), 3000, (i * 40 * SecondsPerDay) + 120);
+		}
+
+		// The files that are not in a city folder or are not compressed backups are never deleted.
+		created &= CreateBackupFile(cityA / "Store" / "Object.sc4.gz", 5, 0);
+		created &= CreateBackupFile(cityA / "Slot.sc4", 5, 0);
+
+		CHECK(created);
+
+		BackupRetention retention;
+
+		retention.SetPolicy(true, 20000, 25000);
+		retention.Load(root);
+
+		// A backup whose compression failed is dropped from the index.
+		retention.AddBackup(cityA / "Failed.sc4.gz", BackupRetention::GetFileSystemTime());
+
+		const BackupPruneResult result = retention.Prune(BackupRetention::GetFileSystemTime(), std::stop_token());
+
+		CHECK(result.deletedCount == 32);
+		CHECK(result.deletedBytes == 40000);
+		CHECK(result.failedCount == 0);
+		CHECK(result.totalBytes == 23000);
+
+		CHECK(CountFiles(cityA) == 21);
+		CHECK(CountFiles(cityB) == 1);
+		CHECK(std::filesystem::exists(cityA / "Slot.sc4"));
+		CHECK(std::filesystem::exists(cityA / "Store" / "Object.sc4.gz"));
+		CHECK(std::filesystem::exists(cityA / "A 0.sc4.gz"));
+		CHECK(std::filesystem::exists(cityB / "B 0.sc4.gz"));
+	}
+}
+
+void RunBackupRetentionTests()
+{
+	TestSelectGenerations();
+	TestSelectGenerationsBeforeEpoch();
+	TestMissingRootFolder();
+	TestPrune();
+}
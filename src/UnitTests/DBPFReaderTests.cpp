@@ -0,0 +1,253 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../DBPFReader.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+static constexpr size_t HeaderSize = 96;
+static constexpr size_t IndexEntrySize = 20;
+
+namespace
+{
+	std::vector<uint8_t> ToBytes(std::string_view text)
+	{
+		return std::vector<uint8_t>(text.begin(), text.end());
+	}
+
+	std::vector<TestDBPFEntry> CreateEntries()
+	{
+		return std::vector<TestDBPFEntry>
+		{
+			TestDBPFEntry{ 0x11111111, 0x22222222, 0x33333333, ToBytes("first entry") },
+			TestDBPFEntry{ 0x44444444, 0x55555555, 0x66666666, ToBytes("second") },
+			TestDBPFEntry{ 0x77777777, 0x88888888, 0x99999999, ToBytes("the third entry") },
+			TestDBPFEntry{ 0xAAAAAAAA, 0xBBBBBBBB, 0xCCCCCCCC, std::vector<uint8_t>() },
+		};
+	}
+
+	uint32_t ReadUInt32(const std::vector<uint8_t>& file, size_t offset)
+	{
+		uint32_t value = 0;
+		std::memcpy(&value, file.data() + offset, sizeof(value));
+
+		return value;
+	}
+
+	void WriteUInt32(std::vector<uint8_t>& file, size_t offset, uint32_t value)
+	{
+		std::memcpy(file.data() + offset, &value, sizeof(value));
+	}
+
+	bool ViewEquals(const MemoryMappedView& view, const std::vector<uint8_t>& expected)
+	{
+		const std::span<const uint8_t> data = view.GetData();
+
+		return view.IsValid() && data.size() == expected.size() && std::equal(data.begin(), data.end(), expected.begin());
+	}
+
+	// Writes the file and checks that it fails to open with the specified error.
+	void CheckOpenFails(const std::filesystem::path& path, const std::vector<uint8_t>& file, const char* expectedError)
+	{
+		CHECK(WriteBinaryFile(path, file));
+
+		DBPFReader reader;
+
+		CHECK(!reader.Open(path));
+		CHECK(std::strcmp(reader.GetErrorMessage(), expectedError) == 0);
+		CHECK(reader.GetEntries().empty());
+		CHECK(reader.GetFileSize() == 0);
+		CHECK(!reader.MapRange(0, 0).IsValid());
+	}
+
+	void TestReadIndex()
+	{
+		const std::filesystem::path path = GetTestFolder("DBPFReaderIndex") / "City.sc4";
+
+		const std::vector<TestDBPFEntry> entries = CreateEntries();
+		std::vector<uint8_t> file = CreateDBPFFile(entries);
+
+		// The index is not required to be in file order.
+		const size_t indexOffset = ReadUInt32(file, 40);
+		std::swap_ranges(
+			file.begin() + indexOffset,
+			file.begin() + indexOffset + IndexEntrySize,
+			file.begin() + indexOffset + (3 * IndexEntrySize));
+
+		CHECK(WriteBinaryFile(path, file));
+
+		DBPFReader reader;
+
+		CHECK(reader.Open(path));
+		CHECK(reader.GetErrorMessage()[0] == '\0');
+		CHECK(reader.GetFileSize() == file.size());
+		CHECK(reader.GetIndexOffset() == indexOffset);
+		CHECK(reader.GetIndexSize() == entries.size() * IndexEntrySize);
+
+		const std::vector<DBPFIndexEntry>& index = reader.GetEntries();
+
+		CHECK(index.size() == entries.size());
+
+		if (index.size() == entries.size())
+		{
+			uint32_t expectedOffset = HeaderSize;
+
+			for (size_t i = 0; i < index.size(); i++)
+			{
+				CHECK(index[i].type == entries[i].type);
+				CHECK(index[i].group == entries[i].group);
+				CHECK(index[i].instance == entries[i].instance);
+				CHECK(index[i].offset == expectedOffset);
+				CHECK(index[i].size == entries[i].data.size());
+				CHECK(ViewEquals(reader.MapEntry(index[i]), entries[i].data));
+
+				expectedOffset += static_cast<uint32_t>(entries[i].data.size());
+			}
+		}
+
+		CHECK(ViewEquals(reader.MapRange(HeaderSize, 5), ToBytes("first")));
+		CHECK(!reader.MapRange(file.size() - 1, 2).IsValid());
+
+		reader.Close();
+
+		CHECK(reader.GetEntries().empty());
+		CHECK(reader.GetFileSize() == 0);
+		CHECK(!reader.MapRange(0, 0).IsValid());
+	}
+
+	void TestEmptyIndex()
+	{
+		const std::filesystem::path path = GetTestFolder("DBPFReaderEmptyIndex") / "Empty.sc4";
+
+		CHECK(WriteBinaryFile(path, CreateDBPFFile(std::vector<TestDBPFEntry>())));
+
+		DBPFReader reader;
+
+		CHECK(reader.Open(path));
+		CHECK(reader.GetEntries().empty());
+		CHECK(reader.GetIndexSize() == 0);
+	}
+
+	void TestInvalidHeader()
+	{
+		const std::filesystem::path folder = GetTestFolder("DBPFReaderHeader");
+		const std::vector<uint8_t> validFile = CreateDBPFFile(CreateEntries());
+
+		{
+			DBPFReader reader;
+
+			CHECK(!reader.Open(folder / "Missing.sc4"));
+			CHECK(std::strcmp(reader.GetErrorMessage(), "Failed to open the DBPF file.") == 0);
+		}
+
+		CheckOpenFails(folder / "Empty.sc4", std::vector<uint8_t>(), "The DBPF file is too small to contain a header.");
+		CheckOpenFails(
+			folder / "Short.sc4",
+			std::vector<uint8_t>(validFile.begin(), validFile.begin() + HeaderSize - 1),
+			"The DBPF file is too small to contain a header.");
+
+		// The signature, major version, minor version and index major version.
+		for (size_t offset : { 0, 4, 8, 32 })
+		{
+			std::vector<uint8_t> file = validFile;
+			file[offset] ^= 0x01;
+
+			CheckOpenFails(folder / "Header.sc4", file, "The file is not a SimCity 4 DBPF file.");
+		}
+	}
+
+	void TestInvalidIndex()
+	{
+		const std::filesystem::path folder = GetTestFolder("DBPFReaderInvalidIndex");
+		const std::vector<uint8_t> validFile = CreateDBPFFile(CreateEntries());
+
+		const uint32_t entryCount = ReadUInt32(validFile, 36);
+		const uint32_t indexOffset = ReadUInt32(validFile, 40);
+
+		{
+			std::vector<uint8_t> file = validFile;
+			WriteUInt32(file, 36, entryCount + 1);
+
+			CheckOpenFails(folder / "EntryCount.sc4", file, "The DBPF index size does not match the entry count.");
+		}
+
+		{
+			// The entry count must not overflow when it is multiplied by the entry size.
+			std::vector<uint8_t> file = validFile;
+			WriteUInt32(file, 36, 0x80000000);
+			WriteUInt32(file, 44, 0);
+
+			CheckOpenFails(folder / "Overflow.sc4", file, "The DBPF index size does not match the entry count.");
+		}
+
+		{
+			// A truncated index.
+			std::vector<uint8_t> file = validFile;
+			file.resize(file.size() - 1);
+
+			CheckOpenFails(folder / "Truncated.sc4", file, "The DBPF index is outside of the file.");
+		}
+
+		{
+			std::vector<uint8_t> file = validFile;
+			WriteUInt32(file, 40, 0xFFFFFFF0);
+
+			CheckOpenFails(folder / "IndexOffset.sc4", file, "The DBPF index is outside of the file.");
+		}
+
+		{
+			std::vector<uint8_t> file = validFile;
+			WriteUInt32(file, 40, HeaderSize - 1);
+
+			CheckOpenFails(folder / "IndexInHeader.sc4", file, "The DBPF index is outside of the file.");
+		}
+
+		{
+			// An entry that extends past the end of the file.
+			std::vector<uint8_t> file = validFile;
+			WriteUInt32(file, indexOffset + IndexEntrySize + 16, static_cast<uint32_t>(file.size()));
+
+			CheckOpenFails(folder / "EntrySize.sc4", file, "A DBPF index entry is outside of the file.");
+		}
+
+		{
+			// An entry offset that overflows 32 bits when the size is added.
+			std::vector<uint8_t> file = validFile;
+			WriteUInt32(file, indexOffset + 12, 0xFFFFFFFF);
+
+			CheckOpenFails(folder / "EntryOffset.sc4", file, "A DBPF index entry is outside of the file.");
+		}
+
+		{
+			// A reader can be reused after an error.
+			const std::filesystem::path path = folder / "Valid.sc4";
+			CHECK(WriteBinaryFile(path, validFile));
+
+			DBPFReader reader;
+
+			CHECK(!reader.Open(folder / "Missing.sc4"));
+			CHECK(reader.Open(path));
+			CHECK(reader.GetErrorMessage()[0] == '\0');
+			CHECK(reader.GetEntries().size() == entryCount);
+		}
+	}
+}
+
+void RunDBPFReaderTests()
+{
+	TestReadIndex();
+	TestEmptyIndex();
+	TestInvalidHeader();
+	TestInvalidIndex();
+}
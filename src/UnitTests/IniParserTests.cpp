@@ -0,0 +1,323 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../IniParser.h"
+#include "../Settings.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct TestValues
+	{
+		bool enabled = false;
+		int count = 0;
+		double percent = 0;
+		std::string name;
+		std::filesystem::path folder;
+	};
+
+	// The schema must outlive the parse, the pointers refer to the values.
+	std::vector<IniKeyDefinition> GetTestSchema(TestValues& values)
+	{
+		return std::vector<IniKeyDefinition>
+		{
+			{ "Enabled", &values.enabled, "true", 0, 0 },
+			{ "Count", &values.count, "5", 1, 10 },
+			{ "Percent", &values.percent, "2.5", 0.5, 50 },
+			{ "Name", &values.name, "default", 0, 0 },
+			{ "Folder", &values.folder, "", 0, 0 },
+		};
+	}
+
+	size_t CountLines(const std::string& text)
+	{
+		size_t count = 0;
+
+		for (char c : text)
+		{
+			if (c == '\n')
+			{
+				count++;
+			}
+		}
+
+		return count;
+	}
+
+	void TestDefaults()
+	{
+		TestValues values;
+		const std::vector<IniKeyDefinition> schema = GetTestSchema(values);
+
+		CHECK(IniParser::SetDefaults(schema));
+		CHECK(values.enabled);
+		CHECK(values.count == 5);
+		CHECK(values.percent == 2.5);
+		CHECK(values.name == "default");
+		CHECK(values.folder.empty());
+	}
+
+	void TestValidSection()
+	{
+		TestValues values;
+		const std::vector<IniKeyDefinition> schema = GetTestSchema(values);
+
+		IniParser::SetDefaults(schema);
+
+		// A byte order mark, CRLF line endings, comments, white space and another section.
+		const std::string_view text =
+			"\xEF\xBB\xBF; A comment\r\n"
+			"[Other]\r\n"
+			"Count=100\r\n"
+			"\r\n"
+			"[Test]\r\n"
+			"# Another comment\r\n"
+			"  Enabled = FALSE  \r\n"
+			"Count=+7\r\n"
+			"Percent=0.75\r\n"
+			"Name=City Name = 1\r\n"
+			"Folder=C:\\Backups\r\n";
+
+		std::string errors;
+
+		CHECK(IniParser::ParseSection(text, "Test", schema, errors));
+		CHECK(errors.empty());
+		CHECK(!values.enabled);
+		CHECK(values.count == 7);
+		CHECK(values.percent == 0.75);
+		CHECK(values.name == "City Name = 1");
+		CHECK(values.folder == std::filesystem::path("C:\\Backups"));
+	}
+
+	void TestMissingKeysKeepTheirValue()
+	{
+		TestValues values;
+		const std::vector<IniKeyDefinition> schema = GetTestSchema(values);
+
+		IniParser::SetDefaults(schema);
+
+		std::string errors;
+
+		CHECK(IniParser::ParseSection("[Test]\nCount=3\n", "Test", schema, errors));
+		CHECK(values.count == 3);
+		CHECK(values.enabled);
+		CHECK(values.name == "default");
+	}
+
+	void TestEveryErrorIsReported()
+	{
+		TestValues values;
+		const std::vector<IniKeyDefinition> schema = GetTestSchema(values);
+
+		IniParser::SetDefaults(schema);
+
+		const std::string_view text =
+			"[Test]\n"
+			"Enabled=yes\n"
+			"Count=11\n"
+			"Percent=abc\n"
+			"Unknown=1\n"
+			"Name\n"
+			"Name=a\n"
+			"Name=b\n"
+			"[Broken\n"
+			"[Test]\n"
+			"Folder=Backups\n";
+
+		std::string errors;
+
+		CHECK(!IniParser::ParseSection(text, "Test", schema, errors));
+
+		// Each problem is on its own line and starts with its line number.
+		CHECK(CountLines(errors) == 8);
+		CHECK(errors.find("Line 2: The Enabled value must be true or false.") != std::string::npos);
+		CHECK(errors.find("Line 3: The Count value must be between 1 and 10.") != std::string::npos);
+		CHECK(errors.find("Line 4: The Percent value must be a number.") != std::string::npos);
+		CHECK(errors.find("Line 5: Unknown is not a recognized setting.") != std::string::npos);
+		CHECK(errors.find("Line 6: Name is not a key=value pair.") != std::string::npos);
+		CHECK(errors.find("Line 8: Name appears more than once.") != std::string::npos);
+		CHECK(errors.find("Line 9: The section name [Broken is missing the closing bracket.") != std::string::npos);
+		CHECK(errors.find("Line 10: The Test section appears more than once.") != std::string::npos);
+
+		// The keys after the errors are still parsed, a value that fails to parse keeps its previous value.
+		CHECK(values.name == "a");
+		CHECK(values.enabled);
+		CHECK(values.folder == std::filesystem::path("Backups"));
+	}
+
+	void TestMissingSection()
+	{
+		TestValues values;
+		const std::vector<IniKeyDefinition> schema = GetTestSchema(values);
+
+		std::string errors;
+
+		CHECK(!IniParser::ParseSection("[Other]\nCount=1\n", "Test", schema, errors));
+		CHECK(errors == "The Test section is missing.\n");
+	}
+
+	void TestSectionNames()
+	{
+		std::vector<std::string_view> names;
+
+		IniParser::GetSectionNames("[A]\nKey=1\n[ B ]\n[A]\n[Unclosed\n", names);
+
+		CHECK(names.size() == 2);
+		CHECK(names.size() == 2 && names[0] == "A" && names[1] == "B");
+	}
+
+	void TestShippedSettingsFile()
+	{
+		Settings settings;
+		std::string errors;
+
+		CHECK(settings.Load(GetSourceFolder() / "SC4AutoSave.ini", errors));
+		CHECK(errors.empty());
+
+		if (!errors.empty())
+		{
+			std::fprintf(stderr, "%s", errors.c_str());
+		}
+	}
+
+	// The constructor values are used until the file has been loaded,
+	// they must match the schema defaults that are used for the missing keys.
+	void TestSettingsDefaultsMatchSchema()
+	{
+		const std::filesystem::path path = GetTestFolder("Settings") / "Empty.ini";
+
+		CHECK(WriteTextFile(path, "[AutoSave]\n"));
+
+		const Settings constructed;
+		Settings loaded;
+		std::string errors;
+
+		CHECK(loaded.Load(path, errors));
+
+		CHECK(constructed.SaveIntervalInMinutes() == loaded.SaveIntervalInMinutes());
+		CHECK(constructed.SimIntervalInMonths() == loaded.SimIntervalInMonths());
+		CHECK(constructed.FastSave() == loaded.FastSave());
+		CHECK(constructed.FullSaveIntervalInMinutes() == loaded.FullSaveIntervalInMinutes());
+		CHECK(constructed.FullSaveOnCityClose() == loaded.FullSaveOnCityClose());
+		CHECK(constructed.SaveOnFocusLoss() == loaded.SaveOnFocusLoss());
+		CHECK(constructed.FocusLossMinimumAgeInMinutes() == loaded.FocusLossMinimumAgeInMinutes());
+		CHECK(constructed.IgnoreTimePaused() == loaded.IgnoreTimePaused());
+		CHECK(constructed.LogSaveEvents() == loaded.LogSaveEvents());
+		CHECK(constructed.SkipUnchangedSaves() == loaded.SkipUnchangedSaves());
+		CHECK(constructed.SaveSlotCount() == loaded.SaveSlotCount());
+		CHECK(constructed.SaveSlotNameFormat() == loaded.SaveSlotNameFormat());
+		CHECK(constructed.BackupDirectory() == loaded.BackupDirectory());
+		CHECK(constructed.CompressBackups() == loaded.CompressBackups());
+		CHECK(constructed.CompressionThreadCount() == loaded.CompressionThreadCount());
+		CHECK(constructed.PruneCompressedBackups() == loaded.PruneCompressedBackups());
+		CHECK(constructed.CityBackupQuotaInMB() == loaded.CityBackupQuotaInMB());
+		CHECK(constructed.TotalBackupQuotaInMB() == loaded.TotalBackupQuotaInMB());
+		CHECK(constructed.MinimumFreeDiskSpaceInMB() == loaded.MinimumFreeDiskSpaceInMB());
+		CHECK(constructed.DeduplicateBackups() == loaded.DeduplicateBackups());
+		CHECK(constructed.DeduplicatedGenerationCount() == loaded.DeduplicatedGenerationCount());
+		CHECK(constructed.CatalogBackups() == loaded.CatalogBackups());
+		CHECK(constructed.VerifySaves() == loaded.VerifySaves());
+		CHECK(constructed.VerificationThreadCount() == loaded.VerificationThreadCount());
+		CHECK(constructed.RecordSaveMetrics() == loaded.RecordSaveMetrics());
+		CHECK(constructed.AdaptiveInterval() == loaded.AdaptiveInterval());
+		CHECK(constructed.StallBudgetPercent() == loaded.StallBudgetPercent());
+		CHECK(constructed.MinimumIntervalInMinutes() == loaded.MinimumIntervalInMinutes());
+		CHECK(constructed.MaximumIntervalInMinutes() == loaded.MaximumIntervalInMinutes());
+		CHECK(constructed.SaveOnNewYear() == loaded.SaveOnNewYear());
+		CHECK(constructed.FundsChangeTriggerAmount() == loaded.FundsChangeTriggerAmount());
+		CHECK(constructed.TriggerDebounceInSeconds() == loaded.TriggerDebounceInSeconds());
+		CHECK(constructed.TriggerMinimumSpacingInMinutes() == loaded.TriggerMinimumSpacingInMinutes());
+		CHECK(constructed.AddressSpaceThresholdPercent() == loaded.AddressSpaceThresholdPercent());
+		CHECK(constructed.CommittedMemoryThresholdInMB() == loaded.CommittedMemoryThresholdInMB());
+		CHECK(constructed.AsyncLogging() == loaded.AsyncLogging());
+		CHECK(constructed.EventLogMaxSizeInMB() == loaded.EventLogMaxSizeInMB());
+		CHECK(constructed.HotReloadSettings() == loaded.HotReloadSettings());
+		CHECK(constructed.TraceMessages() == loaded.TraceMessages());
+	}
+
+	template<typename Func>
+	void PrintBenchmark(const char* name, int iterations, Func func)
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; i++)
+		{
+			func();
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - startTime).count();
+
+		std::printf(
+			"%s: %d iterations in %.1f ms, %.2f us per iteration\n",
+			name,
+			iterations,
+			static_cast<double>(elapsed) / 1e6,
+			static_cast<double>(elapsed) / 1e3 / static_cast<double>(iterations));
+	}
+}
+
+void RunIniParserTests()
+{
+	TestDefaults();
+	TestValidSection();
+	TestMissingKeysKeepTheirValue();
+	TestEveryErrorIsReported();
+	TestMissingSection();
+	TestSectionNames();
+	TestShippedSettingsFile();
+	TestSettingsDefaultsMatchSchema();
+}
+
+void RunIniParserBenchmark()
+{
+	constexpr int Iterations = 100000;
+
+	TestValues values;
+	const std::vector<IniKeyDefinition> schema = GetTestSchema(values);
+
+	std::string text = "; A comment line that is skipped by the parser.\n[Other]\nCount=1\n[Test]\n";
+	text.append("Enabled=true\nCount=7\nPercent=12.5\nName=A city name\nFolder=C:\\Backups\\SimCity 4\n");
+
+	bool parsed = true;
+
+	PrintBenchmark(
+		"IniParser::ParseSection",
+		Iterations,
+		[&]()
+		{
+			std::string errors;
+			parsed &= IniParser::ParseSection(text, "Test", schema, errors);
+		});
+
+	CHECK(parsed);
+
+	const std::filesystem::path settingsPath = GetSourceFolder() / "SC4AutoSave.ini";
+	bool loaded = true;
+
+	// Includes reading the file.
+	PrintBenchmark(
+		"Settings::Load (SC4AutoSave.ini)",
+		Iterations / 10,
+		[&]()
+		{
+			Settings settings;
+			std::string errors;
+			loaded &= settings.Load(settingsPath, errors);
+		});
+
+	CHECK(loaded);
+}
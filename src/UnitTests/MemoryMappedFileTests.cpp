@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../MemoryMappedFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string_view>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <winioctl.h>
+#endif
+
+static constexpr uint64_t FourGigabytes = 0x100000000;
+static constexpr uint64_t SparseFileSize = FourGigabytes + (1024 * 1024);
+
+namespace
+{
+	std::vector<uint8_t> CreateData(size_t size)
+	{
+		std::vector<uint8_t> data(size);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			data[i] = static_cast<uint8_t>((i * 13) + (i >> 8));
+		}
+
+		return data;
+	}
+
+	bool ViewEquals(const MemoryMappedView& view, std::span<const uint8_t> expected)
+	{
+		const std::span<const uint8_t> data = view.GetData();
+
+		return view.IsValid() && data.size() == expected.size() && std::equal(data.begin(), data.end(), expected.begin());
+	}
+
+	bool ViewEquals(const MemoryMappedView& view, std::string_view expected)
+	{
+		return ViewEquals(view, std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(expected.data()), expected.size()));
+	}
+
+	// Creates a file that does not use disk space for the ranges that have not been written.
+	bool CreateSparseFile(const std::filesystem::path& path, uint64_t size)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		DWORD bytesReturned = 0;
+		LARGE_INTEGER fileSize{};
+		fileSize.QuadPart = static_cast<LONGLONG>(size);
+
+		const bool result = DeviceIoControl(file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytesReturned, nullptr)
+			&& SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN)
+			&& SetEndOfFile(file);
+
+		CloseHandle(file);
+
+		return result;
+#else
+		if (!WriteTextFile(path, std::string_view()))
+		{
+			return false;
+		}
+
+		// Extending a file with truncate creates a hole on POSIX file systems.
+		std::error_code ec;
+		std::filesystem::resize_file(path, size, ec);
+
+		return !ec;
+#endif
+	}
+
+	bool WriteAt(const std::filesystem::path& path, uint64_t offset, std::string_view text)
+	{
+		std::fstream stream(path, std::fstream::in | std::fstream::out | std::fstream::binary);
+
+		stream.seekp(static_cast<std::streamoff>(offset));
+		stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+
+		return static_cast<bool>(stream);
+	}
+
+	void TestOpen()
+	{
+		const std::filesystem::path folder = GetTestFolder("MemoryMappedFileOpen");
+
+		MemoryMappedFile file;
+
+		CHECK(!file.Open(folder / "Missing.dat"));
+		CHECK(!file.IsOpen());
+		CHECK(file.GetSize() == 0);
+		CHECK(!file.MapView(0, 0).IsValid());
+
+		CHECK(WriteTextFile(folder / "Empty.dat", std::string_view()));
+		CHECK(file.Open(folder / "Empty.dat"));
+		CHECK(file.IsOpen());
+		CHECK(file.GetSize() == 0);
+		CHECK(file.MapView(0, 0).IsValid());
+		CHECK(!file.MapView(0, 1).IsValid());
+
+		file.Close();
+
+		CHECK(!file.IsOpen());
+		CHECK(!file.MapView(0, 0).IsValid());
+	}
+
+	void TestMapView()
+	{
+		const std::filesystem::path path = GetTestFolder("MemoryMappedFileMapView") / "Data.dat";
+
+		// The file is larger than the allocation granularity on Windows and the page size on Linux.
+		const std::vector<uint8_t> data = CreateData(200000);
+
+		CHECK(WriteBinaryFile(path, data));
+
+		MemoryMappedFile file;
+
+		CHECK(file.Open(path));
+		CHECK(file.GetSize() == data.size());
+
+		CHECK(ViewEquals(file.MapView(0, data.size()), data));
+
+		// The views that do not start on a mapping boundary.
+		for (size_t offset : { size_t(1), size_t(4095), size_t(4097), size_t(65535), size_t(65537), size_t(131072), data.size() - 1 })
+		{
+			const size_t length = std::min<size_t>(1000, data.size() - offset);
+
+			CHECK(ViewEquals(file.MapView(offset, length), std::span<const uint8_t>(data.data() + offset, length)));
+		}
+
+		const MemoryMappedView emptyView = file.MapView(data.size(), 0);
+
+		CHECK(emptyView.IsValid());
+		CHECK(emptyView.GetData().empty());
+
+		// The ranges that are outside of the file.
+		CHECK(!file.MapView(data.size() - 1, 2).IsValid());
+		CHECK(!file.MapView(data.size() + 1, 0).IsValid());
+		CHECK(!file.MapView(0, data.size() + 1).IsValid());
+		CHECK(!file.MapView(1, SIZE_MAX).IsValid());
+		CHECK(!file.MapView(UINT64_MAX, 1).IsValid());
+	}
+
+	void TestMoveView()
+	{
+		const std::filesystem::path path = GetTestFolder("MemoryMappedFileMoveView") / "Data.dat";
+
+		CHECK(WriteTextFile(path, "0123456789"));
+
+		MemoryMappedFile file;
+		CHECK(file.Open(path));
+
+		MemoryMappedView view = file.MapView(2, 5);
+		MemoryMappedView movedView(std::move(view));
+
+		CHECK(!view.IsValid());
+		CHECK(ViewEquals(movedView, "23456"));
+
+		view = file.MapView(5, 3);
+		view = std::move(movedView);
+
+		CHECK(!movedView.IsValid());
+		CHECK(ViewEquals(view, "23456"));
+	}
+
+	void TestLargeFile()
+	{
+		const std::filesystem::path path = GetTestFolder("MemoryMappedFileLarge") / "Large.dat";
+
+		if (!CreateSparseFile(path, SparseFileSize))
+		{
+			std::printf("Skipped the memory mapped file test for offsets past 4 GB, the file system does not support sparse files.\n");
+			return;
+		}
+
+		CHECK(WriteAt(path, FourGigabytes - 4, "LowHigh!"));
+		CHECK(WriteAt(path, FourGigabytes + 12345, "Past 4 GB"));
+		CHECK(WriteAt(path, SparseFileSize - 3, "End"));
+
+		{
+			MemoryMappedFile file;
+
+			CHECK(file.Open(path));
+			CHECK(file.GetSize() == SparseFileSize);
+
+			// A view that crosses the 4 GB boundary, and views that start past it.
+			CHECK(ViewEquals(file.MapView(FourGigabytes - 4, 8), "LowHigh!"));
+			CHECK(ViewEquals(file.MapView(FourGigabytes, 4), "igh!"));
+			CHECK(ViewEquals(file.MapView(FourGigabytes + 12345, 9), "Past 4 GB"));
+			CHECK(ViewEquals(file.MapView(SparseFileSize - 3, 3), "End"));
+
+			const MemoryMappedView hole = file.MapView(FourGigabytes + 65536, 4);
+
+			CHECK(hole.IsValid() && std::all_of(hole.GetData().begin(), hole.GetData().end(), [](uint8_t value) { return value == 0; }));
+
+			CHECK(!file.MapView(SparseFileSize - 3, 4).IsValid());
+			CHECK(!file.MapView(SparseFileSize + 1, 0).IsValid());
+		}
+
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+	}
+}
+
+void RunMemoryMappedFileTests()
+{
+	TestOpen();
+	TestMapView();
+	TestMoveView();
+	TestLargeFile();
+}
@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../MemoryMonitor.h"
+#include <string>
+
+static constexpr uint64_t Megabyte = 1024 * 1024;
+
+namespace
+{
+	MemoryUsage CreateUsage(uint64_t addressSpaceUsedMB, uint64_t committedMB)
+	{
+		MemoryUsage usage{};
+		usage.addressSpaceUsedBytes = addressSpaceUsedMB * Megabyte;
+		usage.addressSpaceTotalBytes = 1000 * Megabyte;
+		usage.committedBytes = committedMB * Megabyte;
+
+		return usage;
+	}
+
+	void TestAddressSpacePercent()
+	{
+		CHECK(CreateUsage(250, 0).GetAddressSpacePercent() == 25.0);
+		CHECK(MemoryUsage{}.GetAddressSpacePercent() == 0.0);
+	}
+
+	void TestDisabled()
+	{
+		MemoryMonitor monitor;
+
+		CHECK(!monitor.IsEnabled());
+		CHECK(!monitor.Update(CreateUsage(1000, 100000)));
+
+		monitor.SetThresholds(0.0, 500 * Megabyte);
+		CHECK(monitor.IsEnabled());
+
+		monitor.SetThresholds(80.0, 0);
+		CHECK(monitor.IsEnabled());
+	}
+
+	// The monitor only reports the first sample above the threshold, it is re-armed when the
+	// usage falls more than 5% of the threshold below it.
+	void TestAddressSpaceThreshold()
+	{
+		MemoryMonitor monitor;
+		monitor.SetThresholds(80.0, 0);
+
+		CHECK(!monitor.Update(CreateUsage(799, 0)));
+		CHECK(monitor.Update(CreateUsage(800, 0)));
+
+		// Staying above the threshold, or falling back into the reset margin.
+		CHECK(!monitor.Update(CreateUsage(900, 0)));
+		CHECK(!monitor.Update(CreateUsage(790, 0)));
+		CHECK(!monitor.Update(CreateUsage(761, 0)));
+		CHECK(!monitor.Update(CreateUsage(850, 0)));
+
+		// 76% re-arms the monitor.
+		CHECK(!monitor.Update(CreateUsage(759, 0)));
+		CHECK(!monitor.Update(CreateUsage(799, 0)));
+		CHECK(monitor.Update(CreateUsage(801, 0)));
+		CHECK(!monitor.Update(CreateUsage(801, 0)));
+	}
+
+	void TestCommittedThreshold()
+	{
+		MemoryMonitor monitor;
+		monitor.SetThresholds(0.0, 2000 * Megabyte);
+
+		CHECK(!monitor.Update(CreateUsage(999, 1999)));
+		CHECK(monitor.Update(CreateUsage(999, 2000)));
+		CHECK(!monitor.Update(CreateUsage(999, 3000)));
+		CHECK(!monitor.Update(CreateUsage(999, 1901)));
+		CHECK(!monitor.Update(CreateUsage(999, 1899)));
+		CHECK(monitor.Update(CreateUsage(999, 2500)));
+	}
+
+	void TestBothThresholds()
+	{
+		MemoryMonitor monitor;
+		monitor.SetThresholds(80.0, 2000 * Megabyte);
+
+		CHECK(monitor.Update(CreateUsage(100, 2000)));
+
+		// The monitor stays triggered while either value is within the reset margin.
+		CHECK(!monitor.Update(CreateUsage(800, 100)));
+		CHECK(!monitor.Update(CreateUsage(100, 1950)));
+		CHECK(!monitor.Update(CreateUsage(100, 100)));
+		CHECK(monitor.Update(CreateUsage(810, 100)));
+	}
+
+	void TestChangeThresholds()
+	{
+		MemoryMonitor monitor;
+		monitor.SetThresholds(80.0, 0);
+
+		CHECK(monitor.Update(CreateUsage(850, 0)));
+
+		// A higher threshold re-arms the monitor once the usage is below its reset margin.
+		monitor.SetThresholds(95.0, 0);
+
+		CHECK(!monitor.Update(CreateUsage(850, 0)));
+		CHECK(monitor.Update(CreateUsage(960, 0)));
+	}
+
+#ifndef _WIN32
+	void TestReadProcStatus()
+	{
+		const std::filesystem::path folder = GetTestFolder("MemoryMonitorProcStatus");
+		const std::filesystem::path path = folder / "status";
+
+		CHECK(WriteTextFile(
+			path,
+			"Name:\tSimCity 4.exe\n"
+			"Groups:\t" + std::string(300, '1') + "\n"
+			"VmPeak:\t 3500000 kB\n"
+			"VmSize:\t 3145728 kB\n"
+			"VmLck:\t       0 kB\n"
+			"VmData:\t 2097152 kB\n"
+			"VmStk:\t     132 kB\n"));
+
+		MemoryUsage usage{};
+		usage.addressSpaceTotalBytes = 4096 * Megabyte;
+
+		CHECK(MemoryMonitor::ReadProcStatus(path.c_str(), usage));
+		CHECK(usage.addressSpaceUsedBytes == 3072 * Megabyte);
+		CHECK(usage.committedBytes == 2048 * Megabyte);
+		CHECK(usage.addressSpaceTotalBytes == 4096 * Megabyte);
+		CHECK(usage.GetAddressSpacePercent() == 75.0);
+
+		// Both values are required.
+		CHECK(WriteTextFile(path, "VmSize:\t 1024 kB\nVmPeak:\t 2048 kB\n"));
+		CHECK(!MemoryMonitor::ReadProcStatus(path.c_str(), usage));
+
+		CHECK(WriteTextFile(path, "VmData:\t 1024 kB\n"));
+		CHECK(!MemoryMonitor::ReadProcStatus(path.c_str(), usage));
+
+		CHECK(WriteTextFile(path, "VmSize:\t unknown\nVmData:\t 1024 kB\n"));
+		CHECK(!MemoryMonitor::ReadProcStatus(path.c_str(), usage));
+
+		CHECK(!MemoryMonitor::ReadProcStatus((folder / "Missing").c_str(), usage));
+	}
+#endif
+
+	void TestGetProcessUsage()
+	{
+		MemoryUsage usage{};
+
+		CHECK(MemoryMonitor::GetProcessUsage(usage));
+		CHECK(usage.committedBytes > 0);
+		CHECK(usage.addressSpaceUsedBytes > 0);
+		CHECK(usage.addressSpaceUsedBytes <= usage.addressSpaceTotalBytes);
+	}
+}
+
+void RunMemoryMonitorTests()
+{
+	TestAddressSpacePercent();
+	TestDisabled();
+	TestAddressSpaceThreshold();
+	TestCommittedThreshold();
+	TestBothThresholds();
+	TestChangeThresholds();
+#ifndef _WIN32
+	TestReadProcStatus();
+#endif
+	TestGetProcessUsage();
+}
@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../QfsDecompressor.h"
+#include <algorithm>
+#include <string_view>
+
+static constexpr std::string_view ExpectedText = "ABCDABCDABCDABCDE";
+
+namespace
+{
+	// A stream that uses each of the short copy codes, it decompresses to ExpectedText.
+	std::vector<uint8_t> CreateStream()
+	{
+		return std::vector<uint8_t>
+		{
+			0x00, 0x00, 0x00, 0x00,
+			0x10, 0xFB, 0x00, 0x00, 0x11,
+			0xE0, 'A', 'B', 'C', 'D',   // 4 literal bytes
+			0x14, 0x03,                 // copy 8 bytes from 4 bytes back
+			0x80, 0x00, 0x0B,           // copy 4 bytes from 12 bytes back
+			0xFD, 'E',                  // end of stream with 1 literal byte
+		};
+	}
+
+	bool OutputEquals(const std::vector<uint8_t>& output, std::string_view text)
+	{
+		return output.size() == text.size() && std::equal(output.begin(), output.end(), text.begin());
+	}
+
+	void TestDecompress()
+	{
+		std::vector<uint8_t> output;
+
+		CHECK(QfsDecompress(CreateStream(), ExpectedText.size(), output));
+		CHECK(OutputEquals(output, ExpectedText));
+
+		// The output buffer is reused when it is larger than the entry.
+		output.assign(1000, 0);
+
+		CHECK(QfsDecompress(CreateStream(), ExpectedText.size(), output));
+		CHECK(OutputEquals(output, ExpectedText));
+	}
+
+	void TestLongCopy()
+	{
+		// The 4-byte code copies up to 1028 bytes from up to 128 KB back.
+		std::vector<uint8_t> stream
+		{
+			0x00, 0x00, 0x00, 0x00,
+			0x10, 0xFB, 0x00, 0x01, 0x04,
+			0xE0, 'W', 'X', 'Y', 'Z',
+			0xC0, 0x00, 0x03, 0xFB,     // copy 256 bytes from 4 bytes back
+			0xFC,
+		};
+
+		std::vector<uint8_t> output;
+
+		CHECK(QfsDecompress(stream, 260, output));
+		CHECK(output.size() == 260 && output[0] == 'W' && output[255] == 'Z' && output[259] == 'Z');
+	}
+
+	void TestHeaderFlags()
+	{
+		// The high bit selects 4-byte sizes and the low bit adds a compressed size field.
+		std::vector<uint8_t> stream
+		{
+			0x00, 0x00, 0x00, 0x00,
+			0x91, 0xFB,
+			0x00, 0x00, 0x00, 0x13,
+			0x00, 0x00, 0x00, 0x03,
+			0xFF, 'x', 'y', 'z',
+		};
+
+		std::vector<uint8_t> output;
+
+		CHECK(QfsDecompress(stream, 3, output));
+		CHECK(OutputEquals(output, "xyz"));
+	}
+
+	void TestLiteralEntry()
+	{
+		std::vector<uint8_t> data(1001);
+
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = static_cast<uint8_t>(i * 7);
+		}
+
+		std::vector<uint8_t> output;
+
+		CHECK(QfsDecompress(CreateQfsEntry(data), data.size(), output));
+		CHECK(output == data);
+	}
+
+	void TestSizeMismatch()
+	{
+		std::vector<uint8_t> output;
+
+		CHECK(!QfsDecompress(CreateStream(), ExpectedText.size() - 1, output));
+		CHECK(!QfsDecompress(CreateStream(), ExpectedText.size() + 1, output));
+
+		// The stream ends before the size in the header has been written.
+		std::vector<uint8_t> stream = CreateStream();
+		stream[8] = 0x12;
+
+		CHECK(!QfsDecompress(stream, 0x12, output));
+	}
+
+	void TestMaximumSize()
+	{
+		const size_t size = QfsMaximumUncompressedSize + 1;
+
+		std::vector<uint8_t> stream
+		{
+			0x00, 0x00, 0x00, 0x00,
+			0x90, 0xFB,
+			static_cast<uint8_t>(size >> 24),
+			static_cast<uint8_t>(size >> 16),
+			static_cast<uint8_t>(size >> 8),
+			static_cast<uint8_t>(size),
+			0xFC,
+		};
+
+		std::vector<uint8_t> output;
+
+		CHECK(!QfsDecompress(stream, size, output));
+		CHECK(output.empty());
+	}
+
+	void TestTruncatedStream()
+	{
+		const std::vector<uint8_t> stream = CreateStream();
+
+		std::vector<uint8_t> output;
+
+		for (size_t length = 0; length < stream.size(); length++)
+		{
+			CHECK(!QfsDecompress(std::span<const uint8_t>(stream.data(), length), ExpectedText.size(), output));
+		}
+
+		const std::vector<uint8_t> entry = CreateQfsEntry(std::vector<uint8_t>(301, 'q'));
+
+		for (size_t length = 0; length < entry.size(); length++)
+		{
+			CHECK(!QfsDecompress(std::span<const uint8_t>(entry.data(), length), 301, output));
+		}
+	}
+
+	void TestCorruptStream()
+	{
+		std::vector<uint8_t> output;
+
+		// The signature is not 0x10FB.
+		std::vector<uint8_t> stream = CreateStream();
+		stream[5] = 0xFA;
+		CHECK(!QfsDecompress(stream, ExpectedText.size(), output));
+
+		stream = CreateStream();
+		stream[4] = 0x12;
+		CHECK(!QfsDecompress(stream, ExpectedText.size(), output));
+
+		// A copy offset before the start of the output.
+		stream = CreateStream();
+		stream[15] = 0x04;
+		CHECK(!QfsDecompress(stream, ExpectedText.size(), output));
+
+		stream = CreateStream();
+		stream[18] = 0x0C;
+		CHECK(!QfsDecompress(stream, ExpectedText.size(), output));
+
+		// A copy past the end of the output.
+		stream = CreateStream();
+		stream[16] = 0x85;
+		CHECK(!QfsDecompress(stream, ExpectedText.size(), output));
+
+		// A literal run past the end of the output.
+		stream = CreateStream();
+		stream[19] = 0xFF;
+		stream.push_back('F');
+		stream.push_back('G');
+		CHECK(!QfsDecompress(stream, ExpectedText.size(), output));
+
+		// A literal run past the end of the input.
+		stream = CreateStream();
+		stream[9] = 0xFB;
+		CHECK(!QfsDecompress(stream, ExpectedText.size(), output));
+
+		// Random damage must not read or write outside of the buffers.
+		uint32_t seed = 12345;
+
+		for (int i = 0; i < 10000; i++)
+		{
+			stream = CreateStream();
+
+			seed = (seed * 1103515245) + 12345;
+			const size_t position = 9 + ((seed >> 16) % (stream.size() - 9));
+			seed = (seed * 1103515245) + 12345;
+			stream[position] = static_cast<uint8_t>(seed >> 16);
+
+			if (QfsDecompress(stream, ExpectedText.size(), output))
+			{
+				CHECK(output.size() == ExpectedText.size());
+			}
+		}
+	}
+}
+
+void RunQfsDecompressorTests()
+{
+	TestDecompress();
+	TestLongCopy();
+	TestHeaderFlags();
+	TestLiteralEntry();
+	TestSizeMismatch();
+	TestMaximumSize();
+	TestTruncatedStream();
+	TestCorruptStream();
+}
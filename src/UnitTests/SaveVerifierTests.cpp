@@ -0,0 +1,309 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "UnitTests.h"
+#include "../SaveVerifier.h"
+#include <fstream>
+#include <sstream>
+#include <stop_token>
+#include <string>
+
+static constexpr uint32_t DirectoryType = 0xE86B1EEF;
+static constexpr uint32_t DirectoryGroup = 0xE86B1EEF;
+static constexpr uint32_t DirectoryInstance = 0x286B1F03;
+
+static constexpr uint32_t EntryType = 0x12345678;
+static constexpr uint32_t EntryGroup = 0x9ABCDEF0;
+
+namespace
+{
+	struct SaveFile
+	{
+		std::vector<TestDBPFEntry> entries;
+		std::vector<uint8_t> directory;
+	};
+
+	std::vector<uint8_t> CreateEntryData(size_t size, uint32_t seed)
+	{
+		std::vector<uint8_t> data(size);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			data[i] = static_cast<uint8_t>((i * 31) + seed);
+		}
+
+		return data;
+	}
+
+	void AppendUInt32(std::vector<uint8_t>& data, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+	}
+
+	// Adds a compressed entry and its directory record.
+	void AddCompressedEntry(SaveFile& file, uint32_t instance, const std::vector<uint8_t>& data)
+	{
+		file.entries.push_back(TestDBPFEntry{ EntryType, EntryGroup, instance, CreateQfsEntry(data) });
+
+		AppendUInt32(file.directory, EntryType);
+		AppendUInt32(file.directory, EntryGroup);
+		AppendUInt32(file.directory, instance);
+		AppendUInt32(file.directory, static_cast<uint32_t>(data.size()));
+	}
+
+	SaveFile CreateSaveFile(size_t compressedEntryCount)
+	{
+		SaveFile file;
+
+		for (size_t i = 0; i < compressedEntryCount; i++)
+		{
+			const uint32_t instance = static_cast<uint32_t>(i + 1);
+
+			AddCompressedEntry(file, instance, CreateEntryData(1000 + (i * 517), instance));
+		}
+
+		// An uncompressed entry that is not listed in the directory.
+		file.entries.push_back(TestDBPFEntry{ EntryType, EntryGroup, 0xFFFF, CreateEntryData(64, 0) });
+
+		return file;
+	}
+
+	bool WriteSaveFile(const std::filesystem::path& path, const SaveFile& file)
+	{
+		std::vector<TestDBPFEntry> entries = file.entries;
+
+		entries.push_back(TestDBPFEntry{ DirectoryType, DirectoryGroup, DirectoryInstance, file.directory });
+
+		return WriteBinaryFile(path, CreateDBPFFile(entries));
+	}
+
+	SaveVerificationResult Verify(const std::filesystem::path& path, uint32_t threadCount)
+	{
+		std::stop_source stopSource;
+
+		return SaveVerifier(threadCount).Verify(path, stopSource.get_token());
+	}
+
+	void TestValidSave()
+	{
+		const std::filesystem::path folder = GetTestFolder("SaveVerifierValid");
+		const std::filesystem::path path = folder / "City.sc4";
+
+		const SaveFile file = CreateSaveFile(20);
+
+		CHECK(WriteSaveFile(path, file));
+
+		uint64_t expectedBytes = 0;
+
+		for (size_t i = 0; i < 20; i++)
+		{
+			expectedBytes += 1000 + (i * 517);
+		}
+
+		for (uint32_t threadCount : { 0u, 1u, 4u, 32u })
+		{
+			const SaveVerificationResult result = Verify(path, threadCount);
+
+			CHECK(result.valid);
+			CHECK(result.errorMessage.empty());
+			CHECK(result.entryCount == 22);
+			CHECK(result.compressedEntryCount == 20);
+			CHECK(result.fileSize == std::filesystem::file_size(path));
+			CHECK(result.uncompressedBytes == expectedBytes);
+		}
+	}
+
+	void TestLargeEntries()
+	{
+		const std::filesystem::path path = GetTestFolder("SaveVerifierLarge") / "City.sc4";
+
+		// The entries are larger than the buffer that a worker keeps between entries.
+		SaveFile file;
+		AddCompressedEntry(file, 1, CreateEntryData(6 * 1024 * 1024, 1));
+		AddCompressedEntry(file, 2, CreateEntryData(5 * 1024 * 1024, 2));
+		AddCompressedEntry(file, 3, CreateEntryData(100, 3));
+
+		CHECK(WriteSaveFile(path, file));
+
+		const SaveVerificationResult result = Verify(path, 1);
+
+		CHECK(result.valid);
+		CHECK(result.uncompressedBytes == (11 * 1024 * 1024) + 100);
+	}
+
+	void TestWithoutDirectory()
+	{
+		const std::filesystem::path path = GetTestFolder("SaveVerifierNoDirectory") / "City.sc4";
+
+		const std::vector<TestDBPFEntry> entries
+		{
+			TestDBPFEntry{ EntryType, EntryGroup, 1, CreateEntryData(100, 1) },
+		};
+
+		CHECK(WriteBinaryFile(path, CreateDBPFFile(entries)));
+
+		const SaveVerificationResult result = Verify(path, 0);
+
+		CHECK(result.valid);
+		CHECK(result.entryCount == 1);
+		CHECK(result.compressedEntryCount == 0);
+	}
+
+	void TestDamagedEntries()
+	{
+		const std::filesystem::path folder = GetTestFolder("SaveVerifierDamaged");
+
+		// A corrupt RefPack stream.
+		{
+			SaveFile file = CreateSaveFile(8);
+			file.entries[3].data[9] = 0x00;
+
+			const std::filesystem::path path = folder / "Corrupt.sc4";
+			CHECK(WriteSaveFile(path, file));
+
+			const SaveVerificationResult result = Verify(path, 4);
+
+			CHECK(!result.valid);
+			CHECK(result.errorMessage == "A compressed DBPF entry is damaged or does not match the size in the directory.");
+		}
+
+		// A truncated RefPack stream.
+		{
+			SaveFile file = CreateSaveFile(8);
+			file.entries[5].data.resize(file.entries[5].data.size() / 2);
+
+			const std::filesystem::path path = folder / "Truncated.sc4";
+			CHECK(WriteSaveFile(path, file));
+
+			CHECK(!Verify(path, 4).valid);
+		}
+
+		// The directory size does not match the size in the QFS header.
+		{
+			SaveFile file = CreateSaveFile(8);
+			file.directory[12]++;
+
+			const std::filesystem::path path = folder / "SizeMismatch.sc4";
+			CHECK(WriteSaveFile(path, file));
+
+			CHECK(!Verify(path, 4).valid);
+		}
+	}
+
+	void TestDamagedDirectory()
+	{
+		const std::filesystem::path folder = GetTestFolder("SaveVerifierDirectory");
+
+		{
+			SaveFile file = CreateSaveFile(4);
+			file.directory.pop_back();
+
+			const std::filesystem::path path = folder / "InvalidSize.sc4";
+			CHECK(WriteSaveFile(path, file));
+
+			const SaveVerificationResult result = Verify(path, 0);
+
+			CHECK(!result.valid);
+			CHECK(result.errorMessage == "The DBPF directory record has an invalid size.");
+		}
+
+		{
+			SaveFile file = CreateSaveFile(4);
+			AppendUInt32(file.directory, EntryType);
+			AppendUInt32(file.directory, EntryGroup);
+			AppendUInt32(file.directory, 0x1000);
+			AppendUInt32(file.directory, 100);
+
+			const std::filesystem::path path = folder / "MissingEntry.sc4";
+			CHECK(WriteSaveFile(path, file));
+
+			const SaveVerificationResult result = Verify(path, 0);
+
+			CHECK(!result.valid);
+			CHECK(result.errorMessage == "The DBPF directory references an entry that is not in the index.");
+		}
+	}
+
+	void TestInvalidFile()
+	{
+		const std::filesystem::path folder = GetTestFolder("SaveVerifierInvalid");
+
+		CHECK(WriteTextFile(folder / "Text.sc4", std::string(200, 'x')));
+
+		SaveVerificationResult result = Verify(folder / "Text.sc4", 0);
+
+		CHECK(!result.valid);
+		CHECK(result.errorMessage == "The file is not a SimCity 4 DBPF file.");
+
+		result = Verify(folder / "Missing.sc4", 0);
+
+		CHECK(!result.valid);
+		CHECK(result.errorMessage == "Failed to open the DBPF file.");
+	}
+
+	void TestCanceled()
+	{
+		const std::filesystem::path path = GetTestFolder("SaveVerifierCanceled") / "City.sc4";
+
+		CHECK(WriteSaveFile(path, CreateSaveFile(4)));
+
+		std::stop_source stopSource;
+		stopSource.request_stop();
+
+		const SaveVerificationResult result = SaveVerifier(2).Verify(path, stopSource.get_token());
+
+		CHECK(!result.valid);
+		CHECK(result.errorMessage == "The verification was canceled.");
+	}
+
+	void TestAppendRecord()
+	{
+		const std::filesystem::path folder = GetTestFolder("SaveVerifierRecord");
+		const std::filesystem::path recordPath = folder / "Verification.log";
+
+		SaveVerificationResult result{};
+		result.valid = true;
+		result.entryCount = 10;
+		result.compressedEntryCount = 7;
+		result.elapsedMilliseconds = 42;
+
+		CHECK(SaveVerifier::AppendRecord(recordPath, "Generation 1", folder / "City.sc4", result));
+
+		result = SaveVerificationResult{};
+		result.errorMessage = "The file is not a SimCity 4 DBPF file.";
+
+		CHECK(SaveVerifier::AppendRecord(recordPath, "Generation 2", folder / "City.sc4", result));
+
+		std::ifstream stream(recordPath);
+		std::stringstream text;
+		text << stream.rdbuf();
+
+		CHECK(text.str() ==
+			"Generation 1\tCity.sc4\tOK\t10 entries, 7 compressed, 42 ms\n"
+			"Generation 2\tCity.sc4\tFAILED\tThe file is not a SimCity 4 DBPF file.\n");
+	}
+}
+
+void RunSaveVerifierTests()
+{
+	TestValidSave();
+	TestLargeEntries();
+	TestWithoutDirectory();
+	TestDamagedEntries();
+	TestDamagedDirectory();
+	TestInvalidFile();
+	TestCanceled();
+	TestAppendRecord();
+}
@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+// Tests the parts of the plugin that do not depend on the game.
+//
+// The tests only use the C++ standard library and zlib, they can be built and run on Linux
+// from the UnitTests folder with:
+//   g++ -std=c++20 -O2 -I.. *.cpp ../BackupCatalog.cpp ../BackupRetention.cpp ../DBPFReader.cpp ../IniParser.cpp ../MemoryMappedFile.cpp ../MemoryMonitor.cpp ../QfsDecompressor.cpp ../SaveProfiles.cpp ../SaveVerifier.cpp ../Settings.cpp ../Stopwatch.cpp -lz -o UnitTests
+//   ./UnitTests
+//
+// Usage: UnitTests [--benchmark]
+//   --benchmark   Also measures the time that the parsers take.
+
+#include "UnitTests.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+static constexpr std::string_view TestRootFolderName = "SC4AutoSaveUnitTests";
+
+static constexpr size_t DBPFHeaderSize = 96;
+static constexpr size_t DBPFIndexEntrySize = 20;
+
+namespace
+{
+	int checkCount = 0;
+	int failedCheckCount = 0;
+
+	std::filesystem::path GetTestRootFolder()
+	{
+		return std::filesystem::temp_directory_path() / TestRootFolderName;
+	}
+
+	void WriteUInt32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+	{
+		std::memcpy(data.data() + offset, &value, sizeof(value));
+	}
+
+	void AppendUInt32(std::vector<uint8_t>& data, uint32_t value)
+	{
+		const size_t offset = data.size();
+
+		data.resize(offset + sizeof(value));
+		WriteUInt32(data, offset, value);
+	}
+}
+
+void CheckCondition(bool condition, const char* expression, const char* file, int line)
+{
+	checkCount++;
+
+	if (!condition)
+	{
+		failedCheckCount++;
+		std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+	}
+}
+
+std::filesystem::path GetTestFolder(std::string_view name)
+{
+	const std::filesystem::path folder = GetTestRootFolder() / name;
+
+	std::error_code ec;
+	std::filesystem::remove_all(folder, ec);
+	std::filesystem::create_directories(folder, ec);
+
+	return folder;
+}
+
+bool WriteTextFile(const std::filesystem::path& path, std::string_view text)
+{
+	std::ofstream stream(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+	stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+
+	return static_cast<bool>(stream);
+}
+
+bool WriteBinaryFile(const std::filesystem::path& path, std::span<const uint8_t> data)
+{
+	std::ofstream stream(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+	stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+	return static_cast<bool>(stream);
+}
+
+std::vector<uint8_t> CreateDBPFFile(const std::vector<TestDBPFEntry>& entries)
+{
+	std::vector<uint8_t> file(DBPFHeaderSize);
+
+	std::memcpy(file.data(), "DBPF", 4);
+	WriteUInt32(file, 4, 1);
+	WriteUInt32(file, 8, 0);
+	WriteUInt32(file, 32, 7);
+
+	std::vector<uint32_t> entryOffsets;
+
+	for (const TestDBPFEntry& entry : entries)
+	{
+		entryOffsets.push_back(static_cast<uint32_t>(file.size()));
+		file.insert(file.end(), entry.data.begin(), entry.data.end());
+	}
+
+	const size_t indexOffset = file.size();
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		AppendUInt32(file, entries[i].type);
+		AppendUInt32(file, entries[i].group);
+		AppendUInt32(file, entries[i].instance);
+		AppendUInt32(file, entryOffsets[i]);
+		AppendUInt32(file, static_cast<uint32_t>(entries[i].data.size()));
+	}
+
+	WriteUInt32(file, 36, static_cast<uint32_t>(entries.size()));
+	WriteUInt32(file, 40, static_cast<uint32_t>(indexOffset));
+	WriteUInt32(file, 44, static_cast<uint32_t>(entries.size() * DBPFIndexEntrySize));
+
+	return file;
+}
+
+std::vector<uint8_t> CreateQfsEntry(std::span<const uint8_t> data)
+{
+	// The compressed size is followed by the QFS header with a 3-byte big-endian uncompressed size.
+	std::vector<uint8_t> entry
+	{
+		0x00, 0x00, 0x00, 0x00,
+		0x10, 0xFB,
+		static_cast<uint8_t>(data.size() >> 16),
+		static_cast<uint8_t>(data.size() >> 8),
+		static_cast<uint8_t>(data.size()),
+	};
+
+	size_t position = 0;
+
+	// A literal run is a multiple of 4 bytes up to 112 bytes, the end of stream
+	// code holds the last 0 to 3 bytes.
+	while (data.size() - position >= 4)
+	{
+		const size_t length = std::min<size_t>(112, (data.size() - position) & ~static_cast<size_t>(3));
+
+		entry.push_back(static_cast<uint8_t>(0xE0 + ((length - 4) / 4)));
+		entry.insert(entry.end(), data.begin() + position, data.begin() + position + length);
+		position += length;
+	}
+
+	entry.push_back(static_cast<uint8_t>(0xFC + (data.size() - position)));
+	entry.insert(entry.end(), data.begin() + position, data.end());
+
+	WriteUInt32(entry, 0, static_cast<uint32_t>(entry.size()));
+
+	return entry;
+}
+
+std::filesystem::path GetSourceFolder()
+{
+	// A relative path is relative to the folder that the program was built from.
+	return std::filesystem::absolute(__FILE__).parent_path().parent_path();
+}
+
+int main(int argc, char** argv)
+{
+	bool benchmark = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--benchmark") == 0)
+		{
+			benchmark = true;
+		}
+		else
+		{
+			std::fprintf(stderr, "Usage: UnitTests [--benchmark]\n");
+			return 1;
+		}
+	}
+
+	RunBackupCatalogTests();
+	RunBackupRetentionTests();
+	RunDBPFReaderTests();
+	RunIniParserTests();
+	RunMemoryMappedFileTests();
+	RunMemoryMonitorTests();
+	RunQfsDecompressorTests();
+	RunSaveVerifierTests();
+
+	if (benchmark)
+	{
+		RunIniParserBenchmark();
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(GetTestRootFolder(), ec);
+
+	if (failedCheckCount > 0)
+	{
+		std::printf("%d of %d checks failed.\n", failedCheckCount, checkCount);
+		return 2;
+	}
+
+	std::printf("All %d checks passed.\n", checkCount);
+	return 0;
+}
@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of sc4-auto-save, a DLL Plugin for SimCity 4
+// that automatically saves a city at user-specified intervals.
+//
+// Copyright (c) 2024 Nicholas Hayes
+//
+// This file is licensed under terms of the MIT License.
+// See LICENSE.txt for more information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <filesystem>
+#include <span>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+// Records a failed check and continues with the rest of the test.
+#define CHECK(expression) CheckCondition((expression), #expression, __FILE__, __LINE__)
+
+void CheckCondition(bool condition, const char* expression, const char* file, int line);
+
+// Gets an empty folder for the test files, it is deleted when the tests have completed.
+std::filesystem::path GetTestFolder(std::string_view name);
+
+bool WriteTextFile(const std::filesystem::path& path, std::string_view text);
+
+bool WriteBinaryFile(const std::filesystem::path& path, std::span<const uint8_t> data);
+
+struct TestDBPFEntry
+{
+	uint32_t type;
+	uint32_t group;
+	uint32_t instance;
+	std::vector<uint8_t> data;
+};
+
+// Creates a SimCity 4 DBPF file, the index follows the entry data.
+std::vector<uint8_t> CreateDBPFFile(const std::vector<TestDBPFEntry>& entries);
+
+// Creates a QFS compressed DBPF entry that stores the data as literals.
+std::vector<uint8_t> CreateQfsEntry(std::span<const uint8_t> data);
+
+// The folder that contains the plugin source files.
+std::filesystem::path GetSourceFolder();
+
+void RunBackupCatalogTests();
+void RunBackupRetentionTests();
+void RunDBPFReaderTests();
+void RunIniParserTests();
+void RunIniParserBenchmark();
+void RunMemoryMappedFileTests();
+void RunMemoryMonitorTests();
+void RunQfsDecompressorTests();
+void RunSaveVerifierTests();
@@ -11,7 +11,11 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "cGZAutoSaveService.h"
+#include "AutoSaveCommand.h"
+#include "EventLog.h"
 #include "Logger.h"
+#include "MessageTrace.h"
+#include "SC4Messages.h"
 #include "Settings.h"
 #include "version.h"
 #include "cIGZFrameWork.h"
@@ -35,21 +39,12 @@
 #include "wil/resource.h"
 #include "wil/filesystem.h"
 
-static constexpr uint32_t kSC4MessageCityEstablished = 0x26D31EC4;
-static constexpr uint32_t kSC4MessagePostCityInit = 0x26d31ec1;
-static constexpr uint32_t kSC4MessagePreCityShutdown = 0x26D31EC2;
-static constexpr uint32_t kSC4MessageSimPauseChange = 0xAA7FB7E0;
-static constexpr uint32_t kSC4MessageSimHiddenPauseChange = 0x4A7FB7E2;
-static constexpr uint32_t kSC4MessageSimEmergencyPauseChange = 0x4A7FB807;
-static constexpr uint32_t kMessageTypeAppGainLoseFocus = 0x4348B111;
-
 static constexpr uint32_t kAutoSavePluginDirectorID = 0xb0bd667d;
 
-static constexpr int kMinimumSaveIntervalInMinutes = 1;
-static constexpr int kMaximumSaveIntervalInMinutes = 120;
-
 static constexpr std::string_view PluginConfigFileName = "SC4AutoSave.ini";
 static constexpr std::string_view PluginLogFileName = "SC4AutoSave.log";
+static constexpr std::string_view PluginEventLogFileName = "SC4AutoSave.events.jsonl";
+static constexpr std::string_view PluginTraceFileName = "SC4AutoSave.trace";
 
 class cGZAutoSaveDllDirector : public cRZMessage2COMDirector
 {
@@ -57,9 +52,6 @@ public:
 
 	cGZAutoSaveDllDirector()
 		: autoSaveService(),
-		  loseFocusEventCount(0),
-		  pauseEventCount(0),
-		  cityEstablished(false),
 		  settings()
 	{
 		std::filesystem::path dllFolder = GetDllFolderPath();
@@ -81,125 +73,75 @@ public:
 		return kAutoSavePluginDirectorID;
 	}
 
-	void CityEstablished()
+	void PostCityInit(cIGZMessage2Standard* pStandardMsg)
 	{
-		cityEstablished = true;
-		autoSaveService.StartTimer();
+		cISC4City* pCity = reinterpret_cast<cISC4City*>(pStandardMsg->GetIGZUnknown());
+
+		if (pCity)
+		{
+			autoSaveService.CityLoaded(pCity);
+			autoSaveService.HandleScheduleMessage(kSC4MessagePostCityInit, pCity->GetEstablished() ? 1 : 0);
+		}
 	}
 
-	void AppGainLoseFocus(cIGZMessage2Standard* pStandardMsg)
+	void CheatIssued(cIGZMessage2Standard* pStandardMsg)
 	{
-		if (!cityEstablished)
+		if (static_cast<uint32_t>(pStandardMsg->GetData1()) != AutoSaveCommandParser::CheatID)
 		{
 			return;
 		}
 
-		bool hasFocus = pStandardMsg->GetData1() != 0;
+		const cIGZString* pCheatString = static_cast<const cIGZString*>(pStandardMsg->GetVoid2());
 
-		if (hasFocus)
+		if (pCheatString)
 		{
-			if (loseFocusEventCount > 0)
-			{
-				loseFocusEventCount--;
+			const std::string output = autoSaveService.ExecuteCommand(
+				std::string_view(pCheatString->ToChar(), pCheatString->Strlen()));
 
-				if (loseFocusEventCount == 0)
-				{
-					autoSaveService.SetAppHasFocus(true);
-				}
-			}
+			// The box is owned by the game window so that it stays in front of the
+			// game and the game does not accept input until it is closed.
+			MessageBoxA(GetGameWindow(), output.c_str(), "SC4AutoSave", MB_OK | MB_ICONINFORMATION);
 		}
-		else
-		{
-			loseFocusEventCount++;
+	}
 
-			if (loseFocusEventCount == 1)
-			{
-				autoSaveService.SetAppHasFocus(false);
-			}
-		}
+	void PreCityShutdown()
+	{
+		autoSaveService.HandleScheduleMessage(kSC4MessagePreCityShutdown, 0);
+		autoSaveService.CityClosed();
 	}
 
-	void GamePause(cIGZMessage2Standard* pStandardMsg)
+	bool DoMessage(cIGZMessage2* pMessage)
 	{
-		if (!cityEstablished)
+		cIGZMessage2Standard* pStandardMsg = static_cast<cIGZMessage2Standard*>(pMessage);
+		uint32_t dwType = pMessage->GetType();
+
+		if (dwType == kSC4MessageInsertOccupant || dwType == kSC4MessageRemoveOccupant)
 		{
-			return;
+			// The occupant messages are sent for every building and network piece, they
+			// are not recorded in the trace because they do not affect the save schedule.
+			autoSaveService.CityChanged();
+			return true;
 		}
 
-		bool pauseActive = pStandardMsg->GetData1() != 0;
+		MessageTrace& trace = MessageTrace::GetInstance();
 
-		if (pauseActive)
+		if (trace.IsEnabled())
 		{
-			pauseEventCount++;
+			uint32_t data1 = static_cast<uint32_t>(pStandardMsg->GetData1());
 
-			if (pauseEventCount == 1)
+			if (dwType == kSC4MessagePostCityInit)
 			{
-				// When the game is paused we either stop the auto save timer
-				// or leave it running and remove the auto save service from
-				// the game's OnIdle callback.
-				// Stopping the auto save timer will also remove the auto save
-				// service from the game's OnIdle callback
-				//
-				// This prevents the game from wasting CPU on the auto save timer
-				// checks. We never save a city when the game is paused.
-
-				if (settings.IgnoreTimePaused())
-				{
-					autoSaveService.StopTimer();
-				}
-				else
-				{
-					autoSaveService.RemoveFromOnIdle();
-				}
-			}
-		}
-		else
-		{
-			if (pauseEventCount > 0)
-			{
-				pauseEventCount--;
+				// The message data is the city pointer, the replay only needs to know
+				// if the city has been established.
+				cISC4City* pCity = reinterpret_cast<cISC4City*>(pStandardMsg->GetIGZUnknown());
 
-				if (pauseEventCount == 0)
-				{
-					if (settings.IgnoreTimePaused())
-					{
-						autoSaveService.StartTimer();
-					}
-					else
-					{
-						autoSaveService.AddToOnIdle();
-					}
-				}
+				data1 = pCity && pCity->GetEstablished() ? 1 : 0;
 			}
-		}
-	}
-
-	void PostCityInit(cIGZMessage2Standard* pStandardMsg)
-	{
-		cISC4City* pCity = reinterpret_cast<cISC4City*>(pStandardMsg->GetIGZUnknown());
 
-		if (pCity)
-		{
-			// We only enable auto-save after a city has been established.
-			// There is no point in running it before then.
-			if (pCity->GetEstablished())
-			{
-				cityEstablished = true;
-				autoSaveService.StartTimer();
-			}
+			// The message is recorded before it is handled, so that it comes before
+			// the auto-save decisions that it causes.
+			trace.RecordMessage(dwType, data1);
 		}
-	}
-
-	void PreCityShutdown()
-	{
-		cityEstablished = false;
-		autoSaveService.StopTimer();
-	}
-
-	bool DoMessage(cIGZMessage2* pMessage)
-	{
-		cIGZMessage2Standard* pStandardMsg = static_cast<cIGZMessage2Standard*>(pMessage);
-		uint32_t dwType = pMessage->GetType();
 
 		switch (dwType)
 		{
@@ -210,15 +152,18 @@ public:
 			PreCityShutdown();
 			break;
 		case kSC4MessageCityEstablished:
-			CityEstablished();
-			break;
 		case kSC4MessageSimPauseChange:
 		case kSC4MessageSimHiddenPauseChange:
 		case kSC4MessageSimEmergencyPauseChange:
-			GamePause(pStandardMsg);
-			break;
 		case kMessageTypeAppGainLoseFocus:
-			AppGainLoseFocus(pStandardMsg);
+			// The service counts the nested pause and focus messages.
+			autoSaveService.HandleScheduleMessage(dwType, static_cast<uint32_t>(pStandardMsg->GetData1()));
+			break;
+		case kSC4MessageSimNewMonth:
+			autoSaveService.SimNewMonth();
+			break;
+		case kMessageCheatIssued:
+			CheatIssued(pStandardMsg);
 			break;
 		}
 
@@ -229,32 +174,11 @@ public:
 	{
 		try
 		{
-			settings.Load(configFilePath);
-
-			int saveInterval = settings.SaveIntervalInMinutes();
+			std::string errors;
 
-			if (saveInterval < kMinimumSaveIntervalInMinutes)
+			if (!settings.Load(configFilePath, errors))
 			{
-				char buffer[1024]{};
-
-				std::snprintf(buffer,
-						      sizeof(buffer),
-							  "The save interval is less than %d minute(s).",
-							  kMinimumSaveIntervalInMinutes);
-
-				MessageBoxA(nullptr, buffer, "SC4AutoSave - Error when loading settings", MB_OK | MB_ICONERROR);
-				return false;
-			}
-			else if (saveInterval > kMaximumSaveIntervalInMinutes)
-			{
-				char buffer[1024]{};
-
-				std::snprintf(buffer,
-							  sizeof(buffer),
-							  "The save interval is greater than %d minute(s).",
-							  kMaximumSaveIntervalInMinutes);
-
-				MessageBoxA(nullptr, buffer, "SC4AutoSave - Error when loading settings", MB_OK | MB_ICONERROR);
+				MessageBoxA(nullptr, errors.c_str(), "SC4AutoSave - Error when loading settings", MB_OK | MB_ICONERROR);
 				return false;
 			}
 		}
@@ -275,6 +199,9 @@ public:
 			requiredNotifications.push_back(kSC4MessageSimPauseChange);
 			requiredNotifications.push_back(kSC4MessageSimHiddenPauseChange);
 			requiredNotifications.push_back(kSC4MessageSimEmergencyPauseChange);
+			requiredNotifications.push_back(kSC4MessageSimNewMonth);
+			requiredNotifications.push_back(kSC4MessageInsertOccupant);
+			requiredNotifications.push_back(kSC4MessageRemoveOccupant);
 
 			for (uint32_t messageID : requiredNotifications)
 			{
@@ -291,20 +218,56 @@ public:
 			return false;
 		}
 
+		if (settings.AsyncLogging())
+		{
+			Logger::GetInstance().StartAsyncWriter();
+		}
+
+		EventLog& eventLog = EventLog::GetInstance();
+
+		eventLog.Init(
+			GetDllFolderPath() / PluginEventLogFileName,
+			static_cast<uint64_t>(settings.EventLogMaxSizeInMB()) * 1024 * 1024);
+
+		if (settings.TraceMessages())
+		{
+			if (!MessageTrace::GetInstance().Init(GetDllFolderPath() / PluginTraceFileName))
+			{
+				Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to create the message trace file.");
+			}
+		}
+
+		EventRecord startRecord;
+		startRecord.event = "start";
+		startRecord.detail = "SC4AutoSave v" PLUGIN_VERSION_STR;
+		eventLog.Write(startRecord);
+
 		cIGZFrameWork* pFramework = FrameWork();
 
-		if (!autoSaveService.PostAppInit(pFramework, settings))
+		if (!autoSaveService.PostAppInit(pFramework, settings, configFilePath))
 		{
 			MessageBoxA(nullptr, "Failed to initialize the auto save service.", "SC4AutoSave", MB_OK | MB_ICONERROR);
 			return false;
 		}
 
+		autoSaveService.RegisterCommands(this);
+
 		return true;
 	}
 
 	bool PreAppShutdown()
 	{
+		autoSaveService.UnregisterCommands(this);
 		autoSaveService.PreAppShutdown();
+
+		EventRecord stopRecord;
+		stopRecord.event = "stop";
+		EventLog::GetInstance().Write(stopRecord);
+
+		MessageTrace::GetInstance().Close();
+
+		// The background threads have been stopped, write any queued log messages.
+		Logger::GetInstance().StopAsyncWriter();
 		return true;
 	}
 
@@ -326,6 +289,33 @@ public:
 
 private:
 
+	static BOOL CALLBACK FindGameWindowProc(HWND hwnd, LPARAM lParam)
+	{
+		if (IsWindowVisible(hwnd) && GetWindow(hwnd, GW_OWNER) == nullptr)
+		{
+			*reinterpret_cast<HWND*>(lParam) = hwnd;
+			return FALSE;
+		}
+
+		return TRUE;
+	}
+
+	// The game does not expose the handle of its main window. The cheat messages are
+	// sent on the thread that owns the window, normally while it is the active window.
+	static HWND GetGameWindow()
+	{
+		HWND hwnd = GetActiveWindow();
+
+		if (hwnd)
+		{
+			return GetAncestor(hwnd, GA_ROOTOWNER);
+		}
+
+		EnumThreadWindows(GetCurrentThreadId(), &FindGameWindowProc, reinterpret_cast<LPARAM>(&hwnd));
+
+		return hwnd;
+	}
+
 	std::filesystem::path GetDllFolderPath()
 	{
 		wil::unique_cotaskmem_string modulePath = wil::GetModuleFileNameW(wil::GetModuleInstanceHandle());
@@ -336,9 +326,6 @@ private:
 	}
 
 	cGZAutoSaveService autoSaveService;
-	int pauseEventCount;
-	int loseFocusEventCount;
-	bool cityEstablished;
 	Settings settings;
 	std::filesystem::path configFilePath;
 };
@@ -11,10 +11,26 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "cGZAutoSaveService.h"
+#include "EventLog.h"
+#include "LocalTime.h"
+#include "MessageTrace.h"
+#include "SaveVerifier.h"
+#include "Stopwatch.h"
 #include "cIGZApp.h"
+#include "cIGZCheatCodeManager.h"
 #include "cISC4App.h"
+#include "cISC4BudgetSimulator.h"
 #include "cISC4City.h"
+#include "cISC4Region.h"
+#include "cISC4RegionalCity.h"
 #include "cISC4Simulator.h"
+#include "cIGZDate.h"
+#include "cRZBaseString.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
 #include <string>
 #include <Windows.h>
 
@@ -22,6 +38,35 @@ static constexpr uint32_t kAutoSaveServiceID = 0x3fa8cbb9;
 
 static constexpr uint32_t GZIID_cISC4App = 0x26ce01c0;
 
+static constexpr int64_t MillisecondsPerMinute = 60 * 1000;
+
+// How often the main thread checks for settings that were reloaded by the settings watcher.
+static constexpr UINT SettingsCheckIntervalInMilliseconds = 1000;
+
+// How often the memory usage is checked while a city is running.
+static constexpr UINT MemoryCheckIntervalInMilliseconds = 10000;
+
+// The free disk space is checked when a save becomes due, and at this interval while
+// the save is waiting for disk space to be freed.
+static constexpr int64_t DiskSpaceCheckIntervalInMilliseconds = 60000;
+
+// The delay between the game losing focus and the focus loss save, this allows the
+// game to finish switching away before it is stalled by the save.
+static constexpr UINT FocusLossSaveDelayInMilliseconds = 2000;
+
+// The file is hashed in blocks to limit the address space that is used by the mapped views.
+static constexpr size_t FileHashBlockSize = 16 * 1024 * 1024;
+
+// The number of auto-saves that are shown by the AutoSave history command.
+static constexpr size_t HistoryRecordCount = 10;
+
+// The folder in the backup root folder that holds the copies of the city
+// file that are read by the background tasks.
+static constexpr std::string_view SnapshotFolderName = "Snapshots";
+
+// The service is a singleton, SetTimer does not allow the timer callbacks to have a context pointer.
+static cGZAutoSaveService* pTimerService = nullptr;
+
 namespace
 {
 #ifdef _DEBUG
@@ -59,24 +104,321 @@ namespace
 		PrintLineToDebugOutput(buffer);
 	}
 #endif // _DEBUG
+
+	void ReplaceToken(std::string& text, const std::string_view& token, const std::string& value)
+	{
+		size_t index = text.find(token);
+
+		while (index != std::string::npos)
+		{
+			text.replace(index, token.size(), value);
+			index = text.find(token, index + value.size());
+		}
+	}
+
+	void RemoveInvalidFileNameCharacters(std::string& fileName)
+	{
+		for (char& c : fileName)
+		{
+			if (static_cast<unsigned char>(c) < 32)
+			{
+				c = '_';
+			}
+			else
+			{
+				switch (c)
+				{
+				case '<':
+				case '>':
+				case ':':
+				case '"':
+				case '/':
+				case '\\':
+				case '|':
+				case '?':
+				case '*':
+					c = '_';
+					break;
+				}
+			}
+		}
+	}
+
+	std::filesystem::path GetUserDataBackupFolder(cISC4App* pSC4App)
+	{
+		std::filesystem::path folder;
+
+		cRZBaseString userDataDirectory;
+
+		if (pSC4App->GetUserDataDirectory(userDataDirectory))
+		{
+			folder = std::filesystem::path(userDataDirectory.ToChar());
+			folder /= "SC4AutoSave";
+		}
+
+		return folder;
+	}
+
+	std::filesystem::path GetCitySaveFilePath(cISC4City* pCity)
+	{
+		std::filesystem::path path;
+
+		cRZBaseString cityFilePath;
+
+		if (pCity->GetCitySaveFilePath(cityFilePath) && cityFilePath.Strlen() > 0)
+		{
+			path = std::filesystem::path(cityFilePath.ToChar());
+		}
+
+		return path;
+	}
+
+	std::string GetCityName(cISC4City* pCity)
+	{
+		cRZBaseString cityName;
+
+		if (pCity && pCity->GetCityName(cityName))
+		{
+			return std::string(cityName.ToChar());
+		}
+
+		return std::string();
+	}
+
+	// Gets the number of months since the start of the calendar, the difference
+	// between two month numbers is the number of months between the dates.
+	int32_t GetMonthNumber(cIGZDate* pDate)
+	{
+		return static_cast<int32_t>(pDate->Year()) * 12 + static_cast<int32_t>(pDate->Month()) - 1;
+	}
+
+	// Gets the in-game date in the YYYY-MM-DD format.
+	std::string GetSimDateString(cISC4City* pCity)
+	{
+		char simDate[64]{};
+
+		cISC4Simulator* pSimulator = pCity ? pCity->GetSimulator() : nullptr;
+
+		if (pSimulator)
+		{
+			cIGZDate* pDate = pSimulator->GetSimDate();
+
+			if (pDate)
+			{
+				std::snprintf(
+					simDate,
+					sizeof(simDate),
+					"%04u-%02u-%02u",
+					pDate->Year(),
+					pDate->Month(),
+					pDate->DayOfMonth());
+			}
+		}
+
+		return std::string(simDate);
+	}
+
+	bool CreateFolder(const std::filesystem::path& folder)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(folder, ec);
+
+		if (ec)
+		{
+			Logger::GetInstance().WriteLineFormatted(
+				LogLevel::Error,
+				"Failed to create the auto-save backup folder: %s",
+				ec.message().c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	std::string GetFileNameTimeStamp()
+	{
+		SYSTEMTIME time;
+		GetLocalTime(&time);
+
+		char buffer[64]{};
+
+		std::snprintf(
+			buffer,
+			sizeof(buffer),
+			"%04hu-%02hu-%02hu %02hu-%02hu-%02hu",
+			time.wYear,
+			time.wMonth,
+			time.wDay,
+			time.wHour,
+			time.wMinute,
+			time.wSecond);
+
+		return std::string(buffer);
+	}
+
+	bool ComputeFileHash(const std::filesystem::path& path, Sha256Digest& digest, std::stop_token stopToken)
+	{
+		MemoryMappedFile file;
+		Sha256 sha256;
+
+		if (!file.Open(path) || !sha256.IsValid())
+		{
+			return false;
+		}
+
+		const uint64_t fileSize = file.GetSize();
+
+		for (uint64_t offset = 0; offset < fileSize; offset += FileHashBlockSize)
+		{
+			if (stopToken.stop_requested())
+			{
+				return false;
+			}
+
+			const size_t length = static_cast<size_t>(std::min<uint64_t>(FileHashBlockSize, fileSize - offset));
+			const MemoryMappedView view = file.MapView(offset, length);
+
+			if (!view.IsValid() || !sha256.Update(view.GetData().data(), length))
+			{
+				return false;
+			}
+		}
+
+		return sha256.Finish(digest);
+	}
+
+	bool GetFileStamp(const std::filesystem::path& path, uintmax_t& size, std::filesystem::file_time_type& lastWriteTime)
+	{
+		std::error_code ec;
+
+		size = std::filesystem::file_size(path, ec);
+
+		if (!ec)
+		{
+			lastWriteTime = std::filesystem::last_write_time(path, ec);
+		}
+
+		return !ec;
+	}
+
+	// Copies the saved file, the copy fails if the game saved over the file while it was being copied.
+	bool CopySaveSnapshot(const std::filesystem::path& savedFilePath, const std::filesystem::path& snapshotFilePath)
+	{
+		uintmax_t sizeBefore = 0;
+		std::filesystem::file_time_type writeTimeBefore;
+
+		if (!GetFileStamp(savedFilePath, sizeBefore, writeTimeBefore))
+		{
+			return false;
+		}
+
+		std::error_code ec;
+		std::filesystem::copy_file(savedFilePath, snapshotFilePath, std::filesystem::copy_options::overwrite_existing, ec);
+
+		if (ec)
+		{
+			return false;
+		}
+
+		uintmax_t sizeAfter = 0;
+		std::filesystem::file_time_type writeTimeAfter;
+
+		return GetFileStamp(savedFilePath, sizeAfter, writeTimeAfter)
+			&& sizeAfter == sizeBefore
+			&& writeTimeAfter == writeTimeBefore;
+	}
+
+	// The snapshot task deletes a snapshot that could not be copied, it has already logged the error.
+	bool SourceFileExists(const std::filesystem::path& sourceFilePath)
+	{
+		std::error_code ec;
+
+		return std::filesystem::exists(sourceFilePath, ec);
+	}
+
+	const char* GetVerificationStatusName(BackupVerificationStatus status)
+	{
+		switch (status)
+		{
+		case BackupVerificationStatus::Valid:
+			return "verified";
+		case BackupVerificationStatus::Invalid:
+			return "failed verification";
+		case BackupVerificationStatus::NotVerified:
+		default:
+			return "not verified";
+		}
+	}
 }
 
 cGZAutoSaveService::cGZAutoSaveService()
 	: ServiceBase(kAutoSaveServiceID, 1000000),
 	  addedSystemService(false),
 	  addedToOnIdle(false),
-	  running(false),
 	  saveIntervalInMinutes(15),
 	  fastSave(true),
+	  ignoreTimePaused(true),
 	  logSaveEvents(true),
-	  appHasFocus(true),
-	  autoSaveTimer(),
+	  saveOnFocusLoss(false),
+	  focusLossMinimumAge(5 * MillisecondsPerMinute),
+	  focusLossTimerID(0),
+	  lastSaveTime(0),
+	  fullSaveIntervalInMinutes(0),
+	  fullSaveOnCityClose(false),
+	  lastFullSaveTime(0),
+	  fastSavedSinceFullSave(false),
+	  skipUnchangedSaves(true),
+	  changeTracker(),
+	  simIntervalInMonths(0),
+	  monthAtLastSave(0),
+	  saveOnNewYear(false),
+	  fundsChangeTriggerAmount(0),
+	  fundsAtLastSave(0),
+	  triggers(),
+	  memoryMonitor(),
+	  memoryTimerID(0),
+	  saveSlotCount(0),
+	  saveSlotNameFormat(),
+	  defaultProfile(),
+	  profiles(),
+	  profileCityName(),
+	  profileRegionName(),
+	  backupRootFolder(),
+	  saveSlotRing(),
+	  compressBackups(false),
+	  compressionPipeline(),
+	  pruneCompressedBackups(false),
+	  cityBackupQuota(0),
+	  totalBackupQuota(0),
+	  minimumFreeDiskSpace(0),
+	  lowDiskSpace(false),
+	  nextDiskSpaceCheckTime(0),
+	  deduplicateBackups(false),
+	  deduplicatedGenerationCount(20),
+	  catalogBackups(false),
+	  verifySaves(false),
+	  verificationThreadCount(0),
+	  recordSaveMetrics(true),
+	  saveMetrics(),
+	  useAdaptiveInterval(false),
+	  adaptiveInterval(),
+	  deduplicatingStore(),
+	  backupRetention(),
+	  backgroundTasks(),
+	  controller(),
+	  scheduleTimerID(0),
+	  settingsWatcher(),
+	  settingsTimerID(0),
 	  pFramework(nullptr),
 	  pSC4App(nullptr)
 {
+	pTimerService = this;
 }
 
-bool cGZAutoSaveService::PostAppInit(cIGZFrameWork* pFramework, const Settings& settings)
+bool cGZAutoSaveService::PostAppInit(
+	cIGZFrameWork* pFramework,
+	const Settings& settings,
+	const std::filesystem::path& settingsFilePath)
 {
 	Logger& logger = Logger::GetInstance();
 
@@ -94,9 +436,21 @@ bool cGZAutoSaveService::PostAppInit(cIGZFrameWork* pFramework, const Settings&
 			{
 				if (pApp->QueryInterface(GZIID_cISC4App, pSC4App.AsPPVoidParam()))
 				{
-					saveIntervalInMinutes = settings.SaveIntervalInMinutes();
-					fastSave = settings.FastSave();
-					logSaveEvents = settings.LogSaveEvents();
+					ApplySettings(settings);
+
+					if (settings.HotReloadSettings())
+					{
+						if (settingsWatcher.Start(settingsFilePath))
+						{
+							settingsTimerID = SetTimer(nullptr, 0, SettingsCheckIntervalInMilliseconds, &SettingsTimerProc);
+						}
+
+						if (settingsTimerID == 0)
+						{
+							logger.WriteLine(LogLevel::Error, "Failed to start watching the settings file.");
+							settingsWatcher.Stop();
+						}
+					}
 
 					result = Init();
 				}
@@ -127,6 +481,32 @@ bool cGZAutoSaveService::PreAppShutdown()
 {
 	bool result = Shutdown();
 
+	CancelScheduleTimer();
+	CancelFocusLossTimer();
+
+	if (memoryTimerID != 0)
+	{
+		KillTimer(nullptr, memoryTimerID);
+		memoryTimerID = 0;
+	}
+
+	if (settingsTimerID != 0)
+	{
+		KillTimer(nullptr, settingsTimerID);
+		settingsTimerID = 0;
+	}
+
+	settingsWatcher.Stop();
+	compressionPipeline.Stop();
+	backgroundTasks.Stop();
+
+	if (!backupRootFolder.empty())
+	{
+		// The snapshots of the tasks that were discarded when the queue was stopped.
+		std::error_code ec;
+		std::filesystem::remove_all(backupRootFolder / SnapshotFolderName, ec);
+	}
+
 	pSC4App.Reset();
 	pWinMgr.Reset();
 	pFramework.Reset();
@@ -134,142 +514,1982 @@ bool cGZAutoSaveService::PreAppShutdown()
 	return result;
 }
 
-void cGZAutoSaveService::StartTimer()
+void cGZAutoSaveService::HandleScheduleMessage(uint32_t messageType, uint32_t data1)
 {
-	if (!running)
-	{
-		AddToOnIdle();
-		autoSaveTimer.Start();
-		running = true;
-	}
+	const SaveControllerState previous = controller.GetState();
+
+	controller.HandleMessage(messageType, data1, ignoreTimePaused, static_cast<int64_t>(GetTickCount64()));
+	ControllerStateChanged(previous);
 }
 
-void cGZAutoSaveService::StopTimer()
+void cGZAutoSaveService::ControllerStateChanged(const SaveControllerState& previous)
 {
-	if (running)
+	const bool running = controller.IsRunning();
+
+	if (running != previous.running)
 	{
-		RemoveFromOnIdle();
-		autoSaveTimer.Stop();
-		running = false;
+		MessageTrace::GetInstance().Record(running ? TraceRecordType::TimerStarted : TraceRecordType::TimerStopped, 0, 0);
 	}
-}
 
-void cGZAutoSaveService::AddToOnIdle()
-{
-	if (!addedToOnIdle)
+	LogSaveBlockersChanged(previous.blockers);
+
+	// When the game loses focus or is paused we cancel the schedule timer and remove
+	// the auto save service from the game's OnIdle callback, the time keeps counting
+	// towards the next save unless the pause stopped the timer.
+	// The city is only saved in the background by the opt-in focus loss save.
+	UpdateSchedule();
+
+	if (running != previous.running)
 	{
-		addedToOnIdle = pFramework->AddToOnIdle(this);
+		UpdateMemoryTimer();
 	}
-}
 
-void cGZAutoSaveService::RemoveFromOnIdle()
-{
-	if (addedToOnIdle)
+	const bool hadFocus = (previous.blockers & static_cast<uint32_t>(SaveBlocker::AppInBackground)) == 0;
+
+	if (controller.HasFocus() != hadFocus)
 	{
-		pFramework->RemoveFromOnIdle(this);
-		addedToOnIdle = false;
+		CancelFocusLossTimer();
+
+		if (!controller.HasFocus() && saveOnFocusLoss && running && !controller.IsGamePaused())
+		{
+			const int64_t now = static_cast<int64_t>(GetTickCount64());
+
+			if ((now - lastSaveTime) >= focusLossMinimumAge)
+			{
+				focusLossTimerID = SetTimer(nullptr, 0, FocusLossSaveDelayInMilliseconds, &FocusLossTimerProc);
+			}
+		}
 	}
 }
 
-void cGZAutoSaveService::SetAppHasFocus(bool value)
+void cGZAutoSaveService::CityLoaded(cISC4City* pCity)
+{
+	SelectCityProfile(pCity);
+
+	const int64_t now = static_cast<int64_t>(GetTickCount64());
+
+	// The region thumbnail is current when the city is loaded.
+	lastSaveTime = now;
+	lastFullSaveTime = now;
+	fastSavedSinceFullSave = false;
+
+	// The minimum spacing of the triggered saves is counted from the time the city was loaded.
+	triggers.SaveCompleted(now);
+
+	// The city is unchanged until the simulation runs or it is edited, the
+	// occupant messages that are sent while the city is loading are ignored.
+	ResetCityChanges(pCity);
+}
+
+void cGZAutoSaveService::CityChanged()
 {
-	appHasFocus = value;
+	changeTracker.MarkChanged();
+}
 
-	// When the game loses focus we remove the auto save service
-	// from the game's OnIdle callback.
-	//
-	// This prevents the game from wasting CPU on the auto save timer
-	// checks. We never save a city when the game is in the background.
-	if (appHasFocus)
+void cGZAutoSaveService::SimNewMonth()
+{
+	if (!controller.IsRunning() || (simIntervalInMonths <= 0 && !saveOnNewYear && fundsChangeTriggerAmount <= 0))
 	{
-		AddToOnIdle();
+		return;
 	}
-	else
+
+	cISC4City* pCity = pSC4App ? pSC4App->GetCity() : nullptr;
+
+	if (!pCity)
 	{
-		RemoveFromOnIdle();
+		return;
 	}
-}
 
-bool cGZAutoSaveService::CanSaveCity() const
-{
-	bool canSave = false;
+	const int64_t now = static_cast<int64_t>(GetTickCount64());
+
+	cISC4Simulator* pSimulator = pCity->GetSimulator();
+	cIGZDate* pDate = pSimulator ? pSimulator->GetSimDate() : nullptr;
 
-	if (appHasFocus && pSC4App)
+	if (pDate)
 	{
-		if (pWinMgr && !pWinMgr->IsModal())
+		if (saveOnNewYear && pDate->Month() == 1)
 		{
-			cISC4City* pCity = pSC4App->GetCity();
+			TriggerSave(SaveTrigger::NewYear, now);
+		}
 
-			if (pCity && !pCity->IsSaveDisabled())
-			{
-				cISC4Simulator* pSimulator = pCity->GetSimulator();
+		if (simIntervalInMonths > 0 && GetMonthNumber(pDate) - monthAtLastSave >= simIntervalInMonths)
+		{
+			TriggerSave(SaveTrigger::SimInterval, now);
+		}
+	}
 
-				if (pSimulator && !pSimulator->IsAnyPaused())
-				{
-					canSave = true;
-				}
+	if (fundsChangeTriggerAmount > 0)
+	{
+		cISC4BudgetSimulator* pBudgetSimulator = pCity->GetBudgetSimulator();
+
+		if (pBudgetSimulator)
+		{
+			const int64_t fundsChange = pBudgetSimulator->GetTotalFunds() - fundsAtLastSave;
+
+			if (fundsChange >= fundsChangeTriggerAmount || fundsChange <= -fundsChangeTriggerAmount)
+			{
+				TriggerSave(SaveTrigger::FundsChanged, now);
 			}
 		}
 	}
-
-	return canSave;
 }
 
-bool cGZAutoSaveService::Init()
+void cGZAutoSaveService::SelectCityProfile(cISC4City* pCity)
 {
-	if (!addedSystemService)
+	profileCityName = GetCityName(pCity);
+	profileRegionName.clear();
+
+	cISC4Region* pRegion = pSC4App ? pSC4App->GetRegion() : nullptr;
+	const char* regionDirectoryName = pRegion ? pRegion->GetDirectoryName() : nullptr;
+
+	if (regionDirectoryName && regionDirectoryName[0] != '\0')
 	{
-		addedSystemService = pFramework->AddSystemService(this);
+		profileRegionName = regionDirectoryName;
+	}
+	else
+	{
+		// The city is saved in its region folder.
+		profileRegionName = GetCitySaveFilePath(pCity).parent_path().filename().string();
 	}
 
-	return addedSystemService;
+	const SaveProfile& profile = GetCityProfile();
+
+	ApplyProfile(profile);
+	UpdateSaveInterval(static_cast<int64_t>(GetTickCount64()));
+
+	if (logSaveEvents && !profile.name.empty())
+	{
+		Logger::GetInstance().WriteLineFormatted(
+			LogLevel::Info,
+			"Using the [%s] save profile, the save interval is %d minute(s).",
+			profile.name.c_str(),
+			profile.saveIntervalInMinutes);
+	}
 }
 
-bool cGZAutoSaveService::Shutdown()
+void cGZAutoSaveService::CityClosed()
 {
-	bool result = true;
-
-	if (addedSystemService)
+	if (fullSaveOnCityClose && fastSavedSinceFullSave)
 	{
-		StopTimer();
-		pFramework->RemoveSystemService(this);
-		addedSystemService = false;
+		SaveCityOnClose();
 	}
 
-	return true;
+	fastSavedSinceFullSave = false;
+	triggers.Clear();
+
+	WriteSaveMetricsSummary();
+
+	// The next city starts with the configured interval until its save time is known.
+	adaptiveInterval.Reset();
+
+	profileCityName.clear();
+	profileRegionName.clear();
+	ApplyProfile(defaultProfile);
+	UpdateSaveInterval(static_cast<int64_t>(GetTickCount64()));
 }
 
-bool cGZAutoSaveService::OnIdle(uint32_t unknown1)
+void cGZAutoSaveService::ApplySettings(const Settings& settings)
 {
-	int64_t elapsedMinutes = autoSaveTimer.ElapsedMinutes();
+	ignoreTimePaused = settings.IgnoreTimePaused();
+	logSaveEvents = settings.LogSaveEvents();
+	saveOnFocusLoss = settings.SaveOnFocusLoss();
+	focusLossMinimumAge = static_cast<int64_t>(settings.FocusLossMinimumAgeInMinutes()) * MillisecondsPerMinute;
+	skipUnchangedSaves = settings.SkipUnchangedSaves();
+	fullSaveIntervalInMinutes = settings.FullSaveIntervalInMinutes();
+	fullSaveOnCityClose = settings.FullSaveOnCityClose();
+	simIntervalInMonths = settings.SimIntervalInMonths();
+	saveOnNewYear = settings.SaveOnNewYear();
+	fundsChangeTriggerAmount = settings.FundsChangeTriggerAmount();
+	triggers.SetTiming(
+		static_cast<int64_t>(settings.TriggerDebounceInSeconds()) * 1000,
+		static_cast<int64_t>(settings.TriggerMinimumSpacingInMinutes()) * 60 * 1000);
+	memoryMonitor.SetThresholds(
+		static_cast<double>(settings.AddressSpaceThresholdPercent()),
+		static_cast<uint64_t>(settings.CommittedMemoryThresholdInMB()) * 1024 * 1024);
+	UpdateMemoryTimer();
+	defaultProfile = settings.DefaultProfile();
+	profiles = settings.Profiles();
+
+	ApplyProfile(GetCityProfile());
+
+	saveSlotNameFormat = settings.SaveSlotNameFormat();
+	backupRootFolder = settings.BackupDirectory();
 
-	if (elapsedMinutes >= saveIntervalInMinutes)
+	if (backupRootFolder.empty())
 	{
-		if (CanSaveCity())
+		backupRootFolder = GetUserDataBackupFolder(pSC4App);
+	}
+
+	compressBackups = settings.CompressBackups();
+
+	if (compressBackups)
+	{
+		// The thread count cannot be changed after the pipeline has been started.
+		compressionPipeline.Start(static_cast<uint32_t>(settings.CompressionThreadCount()));
+	}
+
+	pruneCompressedBackups = settings.PruneCompressedBackups();
+	cityBackupQuota = static_cast<uint64_t>(settings.CityBackupQuotaInMB()) * 1024 * 1024;
+	totalBackupQuota = static_cast<uint64_t>(settings.TotalBackupQuotaInMB()) * 1024 * 1024;
+	minimumFreeDiskSpace = static_cast<uint64_t>(settings.MinimumFreeDiskSpaceInMB()) * 1024 * 1024;
+	nextDiskSpaceCheckTime = 0;
+	deduplicateBackups = settings.DeduplicateBackups();
+	catalogBackups = settings.CatalogBackups();
+	verifySaves = settings.VerifySaves();
+	verificationThreadCount = static_cast<uint32_t>(settings.VerificationThreadCount());
+	recordSaveMetrics = settings.RecordSaveMetrics();
+
+	const bool adaptiveIntervalEnabled = settings.AdaptiveInterval() && !useAdaptiveInterval;
+
+	useAdaptiveInterval = settings.AdaptiveInterval();
+
+	if (useAdaptiveInterval)
+	{
+		adaptiveInterval.Configure(
+			settings.StallBudgetPercent(),
+			static_cast<int64_t>(settings.MinimumIntervalInMinutes()) * MillisecondsPerMinute,
+			static_cast<int64_t>(settings.MaximumIntervalInMinutes()) * MillisecondsPerMinute);
+
+		if (adaptiveIntervalEnabled)
 		{
-			const char* status = nullptr;
-#ifdef _DEBUG
-			PrintLineToDebugOutputFormatted("Saving city, FastSave=%s", fastSave ? "true" : "false");
-#endif // _DEBUG
-			if (pSC4App->SaveCity(fastSave))
-			{
-				status = "City saved.";
-			}
-			else
-			{
-				status = "The games's SaveCity command failed.";
-			}
+			SeedAdaptiveInterval();
+		}
+	}
+	else
+	{
+		adaptiveInterval.Reset();
+	}
 
-#ifdef _DEBUG
-			PrintLineToDebugOutput(status);
-#endif // _DEBUG
+	if (compressBackups || deduplicateBackups || catalogBackups || verifySaves)
+	{
+		backgroundTasks.Start();
+	}
 
-			if (logSaveEvents)
-			{
-				Logger::GetInstance().WriteLine(LogLevel::Info, status);
-			}
+	UpdateSaveInterval(static_cast<int64_t>(GetTickCount64()));
+}
+
+void cGZAutoSaveService::ApplyUpdatedSettings()
+{
+	const std::shared_ptr<const Settings> settings = settingsWatcher.TakeUpdatedSettings();
+
+	if (!settings)
+	{
+		return;
+	}
+
+	ApplySettings(*settings);
+
+	// The new interval may have moved the due time.
+	UpdateSchedule();
+
+	Logger::GetInstance().WriteLineFormatted(
+		LogLevel::Info,
+		"Reloaded the settings file, the save interval is %d minute(s).",
+		saveIntervalInMinutes);
+
+	if (!settings->HotReloadSettings())
+	{
+		KillTimer(nullptr, settingsTimerID);
+		settingsTimerID = 0;
+		settingsWatcher.Stop();
+	}
+}
+
+const SaveProfile& cGZAutoSaveService::GetCityProfile() const
+{
+	const SaveProfile* profile = profiles.Find(profileCityName, profileRegionName);
+
+	return profile ? *profile : defaultProfile;
+}
+
+void cGZAutoSaveService::ApplyProfile(const SaveProfile& profile)
+{
+	saveIntervalInMinutes = profile.saveIntervalInMinutes;
+	fastSave = profile.fastSave;
+	deduplicatedGenerationCount = static_cast<size_t>(profile.deduplicatedGenerationCount);
+
+	if (saveSlotCount != profile.saveSlotCount)
+	{
+		// The slot index is loaded again with the new slot count by the next save.
+		saveSlotCount = profile.saveSlotCount;
+		saveSlotRing.Reset();
+	}
+}
+
+void CALLBACK cGZAutoSaveService::SettingsTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time)
+{
+	cGZAutoSaveService* pService = pTimerService;
+
+	if (pService && pService->settingsTimerID == timerID)
+	{
+		// The settings are only changed on the game's main thread.
+		pService->ApplyUpdatedSettings();
+	}
+	else
+	{
+		KillTimer(nullptr, timerID);
+	}
+}
+
+void cGZAutoSaveService::SeedAdaptiveInterval()
+{
+	const std::span<const SaveMetricsRecord> records = saveMetrics.GetRecords();
+	const size_t seedCount = std::min<size_t>(records.size(), 10);
+
+	for (const SaveMetricsRecord& item : records.last(seedCount))
+	{
+		adaptiveInterval.AddSample(item.saveMilliseconds);
+	}
+}
+
+void cGZAutoSaveService::UpdateSaveInterval(int64_t now)
+{
+	int64_t interval = static_cast<int64_t>(saveIntervalInMinutes) * MillisecondsPerMinute;
+
+	// The configured interval is used until the city's save time is known.
+	if (useAdaptiveInterval && adaptiveInterval.HasSamples())
+	{
+		interval = adaptiveInterval.GetIntervalMilliseconds(interval);
+	}
+
+	SetSaveInterval(interval, now);
+}
+
+void cGZAutoSaveService::SetSaveInterval(int64_t interval, int64_t now)
+{
+	if (interval != controller.GetScheduler().GetIntervalInMilliseconds())
+	{
+		MessageTrace::GetInstance().Record(
+			TraceRecordType::IntervalChanged,
+			0,
+			static_cast<uint32_t>(std::min<int64_t>(interval, UINT32_MAX)));
+	}
+
+	controller.GetScheduler().SetIntervalInMilliseconds(interval, now);
+}
+
+void cGZAutoSaveService::BeginSaveDue()
+{
+	const int64_t dueTime = GetSaveDueTime();
+	SaveReadiness& readiness = controller.GetReadiness();
+
+	if (!readiness.IsDue())
+	{
+		nextDiskSpaceCheckTime = 0;
+
+		// The data is the SaveTrigger flags when the save was requested by a game event.
+		const uint32_t pendingTriggers = dueTime == triggers.GetDueTime() ? triggers.GetPendingTriggers() : 0;
+
+		MessageTrace::GetInstance().Record(
+			TraceRecordType::SaveDue,
+			pendingTriggers,
+			static_cast<uint32_t>(std::min<int64_t>(controller.GetScheduler().GetIntervalInMilliseconds(), UINT32_MAX)));
+
+		if (logSaveEvents && pendingTriggers != 0)
+		{
+			Logger::GetInstance().WriteLineFormatted(
+				LogLevel::Info,
+				"An auto-save was triggered by: %s.",
+				SaveTriggers::GetTriggerNames(pendingTriggers).c_str());
+		}
+	}
+
+	readiness.BeginDue(dueTime);
+}
+
+void cGZAutoSaveService::UpdateLowDiskSpace(int64_t now)
+{
+	if (now < nextDiskSpaceCheckTime)
+	{
+		return;
+	}
+
+	nextDiskSpaceCheckTime = now + DiskSpaceCheckIntervalInMilliseconds;
+	lowDiskSpace = false;
+
+	cISC4City* pCity = pSC4App ? pSC4App->GetCity() : nullptr;
+
+	if (minimumFreeDiskSpace > 0 && pCity)
+	{
+		const std::filesystem::path folder = GetSaveTargetFolder(pCity);
+
+		if (!folder.empty())
+		{
+			std::error_code ec;
+			const std::filesystem::space_info space = std::filesystem::space(folder, ec);
+
+			lowDiskSpace = !ec && space.available < minimumFreeDiskSpace;
+		}
+	}
+}
+
+int64_t cGZAutoSaveService::GetSaveDueTime() const
+{
+	if (!controller.GetScheduler().IsRunning())
+	{
+		return SaveScheduler::NotScheduled;
+	}
+
+	if (simIntervalInMonths > 0)
+	{
+		// The in-game interval is a trigger that is checked at the start of each month,
+		// the real time interval is not used.
+		return triggers.GetDueTime();
+	}
+
+	// A triggered save replaces the next interval save, a burst of
+	// triggers and the interval never cause more than one save.
+	return std::min(controller.GetScheduler().GetDueTime(), triggers.GetDueTime());
+}
+
+void cGZAutoSaveService::TriggerSave(SaveTrigger trigger, int64_t now)
+{
+	triggers.Trigger(trigger, now);
+	UpdateSchedule();
+}
+
+void cGZAutoSaveService::UpdateMemoryTimer()
+{
+	const bool enabled = controller.IsRunning() && memoryMonitor.IsEnabled();
+
+	if (enabled && memoryTimerID == 0)
+	{
+		memoryTimerID = SetTimer(nullptr, 0, MemoryCheckIntervalInMilliseconds, &MemoryTimerProc);
+
+		if (memoryTimerID == 0)
+		{
+			Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to create the memory check timer.");
+		}
+	}
+	else if (!enabled && memoryTimerID != 0)
+	{
+		KillTimer(nullptr, memoryTimerID);
+		memoryTimerID = 0;
+	}
+}
+
+void cGZAutoSaveService::CheckMemoryUsage()
+{
+	MemoryUsage usage{};
+
+	if (!MemoryMonitor::GetProcessUsage(usage) || !memoryMonitor.Update(usage))
+	{
+		return;
+	}
+
+	constexpr double BytesPerMB = 1024.0 * 1024.0;
+
+	Logger::GetInstance().WriteLineFormatted(
+		LogLevel::Error,
+		"Warning: the memory usage is high, %.0f MB committed and %.0f of %.0f MB address space used (%.0f%%). Saving the city early.",
+		static_cast<double>(usage.committedBytes) / BytesPerMB,
+		static_cast<double>(usage.addressSpaceUsedBytes) / BytesPerMB,
+		static_cast<double>(usage.addressSpaceTotalBytes) / BytesPerMB,
+		usage.GetAddressSpacePercent());
+
+	triggers.TriggerImmediate(SaveTrigger::MemoryPressure, static_cast<int64_t>(GetTickCount64()));
+	UpdateSchedule();
+}
+
+void cGZAutoSaveService::RegisterCommands(cIGZMessageTarget2* pTarget)
+{
+	cIGZCheatCodeManager* pCheatManager = pSC4App ? pSC4App->GetCheatCodeManager() : nullptr;
+
+	if (pCheatManager)
+	{
+		const cRZBaseString cheatName(std::string(AutoSaveCommandParser::CheatName));
+
+		if (!pCheatManager->AddNotification2(pTarget, 0)
+			|| !pCheatManager->RegisterCheatCode(AutoSaveCommandParser::CheatID, cheatName))
+		{
+			Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to register the AutoSave cheat code.");
+		}
+	}
+}
+
+void cGZAutoSaveService::UnregisterCommands(cIGZMessageTarget2* pTarget)
+{
+	cIGZCheatCodeManager* pCheatManager = pSC4App ? pSC4App->GetCheatCodeManager() : nullptr;
+
+	if (pCheatManager)
+	{
+		pCheatManager->UnregisterCheatCode(AutoSaveCommandParser::CheatID);
+		pCheatManager->RemoveNotification2(pTarget, 0);
+	}
+}
+
+std::string cGZAutoSaveService::ExecuteCommand(std::string_view cheatString)
+{
+	AutoSaveCommand command{};
+	std::string error;
+
+	if (!AutoSaveCommandParser::Parse(cheatString, command, error))
+	{
+		error.append("\n\n");
+		error.append(AutoSaveCommandParser::GetHelpText());
+		return error;
+	}
+
+	const int64_t now = static_cast<int64_t>(GetTickCount64());
+	Logger& logger = Logger::GetInstance();
+	char buffer[256]{};
+
+	switch (command.type)
+	{
+	case AutoSaveCommandType::SaveNow:
+		if (!controller.IsRunning())
+		{
+			return "The city cannot be saved now, it is not established or the game is paused.";
+		}
+
+		logger.WriteLine(LogLevel::Info, "The AutoSave now command was used.");
+		triggers.TriggerImmediate(SaveTrigger::Command, now);
+		UpdateSchedule();
+		return "The city will be saved when the game is ready.";
+	case AutoSaveCommandType::Pause:
+		SetPausedByCommand(true, now);
+		return "The auto-saves are paused, use AutoSave resume to resume them.";
+	case AutoSaveCommandType::Resume:
+		SetPausedByCommand(false, now);
+		return "The auto-saves have been resumed.";
+	case AutoSaveCommandType::Stats:
+		return GetStatsText(now);
+	case AutoSaveCommandType::Interval:
+		if (command.value < Settings::MinimumSaveIntervalInMinutes
+			|| command.value > Settings::MaximumSaveIntervalInMinutes)
+		{
+			std::snprintf(
+				buffer,
+				sizeof(buffer),
+				"The interval must be between %d and %d minutes.",
+				Settings::MinimumSaveIntervalInMinutes,
+				Settings::MaximumSaveIntervalInMinutes);
+			return buffer;
+		}
+
+		saveIntervalInMinutes = command.value;
+		UpdateSaveInterval(now);
+		UpdateSchedule();
+
+		std::snprintf(
+			buffer,
+			sizeof(buffer),
+			"The save interval is now %d minute(s) until the game is restarted or the settings are reloaded.",
+			saveIntervalInMinutes);
+		logger.WriteLine(LogLevel::Info, buffer);
+
+		if (simIntervalInMonths > 0 || useAdaptiveInterval)
+		{
+			return std::string(buffer).append(
+				"\nThe interval is not used while SimIntervalInMonths or AdaptiveInterval is enabled.");
+		}
+
+		return buffer;
+	case AutoSaveCommandType::History:
+		return GetHistoryText();
+	case AutoSaveCommandType::Restore:
+		return QueueDeduplicatedRestore();
+	case AutoSaveCommandType::Help:
+	default:
+		return AutoSaveCommandParser::GetHelpText();
+	}
+}
+
+std::string cGZAutoSaveService::GetHistoryText() const
+{
+	cISC4City* pCity = pSC4App ? pSC4App->GetCity() : nullptr;
+
+	if (!pCity)
+	{
+		return "There is no city loaded.";
+	}
+
+	BackupCatalog catalog;
+
+	if (backupRootFolder.empty() || !catalog.Open(backupRootFolder))
+	{
+		return catalogBackups
+			? "The backup catalog does not contain any auto-saves."
+			: "The backup catalog is empty, CatalogBackups is disabled.";
+	}
+
+	const uint32_t citySerialNumber = pCity->GetCitySerialNumber();
+	const std::string regionName = GetCitySaveFilePath(pCity).parent_path().filename().string();
+
+	std::string text;
+	char buffer[256]{};
+	size_t count = 0;
+
+	// The catalog contains the records for every city, it is searched from the newest record.
+	const std::span<const BackupCatalogRecord> records = catalog.GetRecords();
+
+	for (size_t i = records.size(); i-- > 0 && count < HistoryRecordCount;)
+	{
+		const BackupCatalogRecord& record = records[i];
+
+		if (record.citySerialNumber != citySerialNumber
+			|| BackupCatalog::GetText(record.regionName) != regionName
+			|| !BackupCatalog::IsRecordValid(record))
+		{
+			continue;
+		}
+
+		SYSTEMTIME localTime{};
+		char timeText[32]{};
+
+		if (UnixTimeToLocalTime(record.time, localTime))
+		{
+			std::snprintf(
+				timeText,
+				sizeof(timeText),
+				"%04hu-%02hu-%02hu %02hu:%02hu",
+				localTime.wYear,
+				localTime.wMonth,
+				localTime.wDay,
+				localTime.wHour,
+				localTime.wMinute);
+		}
+
+		const std::string_view simDate = BackupCatalog::GetText(record.simDate);
+
+		std::snprintf(
+			buffer,
+			sizeof(buffer),
+			"%s  %.*s  pop %d  %.1f MB  %s, %s\n",
+			timeText,
+			static_cast<int>(simDate.size()),
+			simDate.data(),
+			record.population,
+			static_cast<double>(record.fileSize) / (1024.0 * 1024.0),
+			(record.flags & BackupCatalog::FastSaveFlag) != 0 ? "fast save" : "full save",
+			GetVerificationStatusName(record.verificationStatus));
+		text.append(buffer);
+		count++;
+	}
+
+	if (count == 0)
+	{
+		return "The backup catalog does not contain any auto-saves for this city.";
+	}
+
+	return text;
+}
+
+std::string cGZAutoSaveService::GetStatsText(int64_t now) const
+{
+	std::string text;
+	char buffer[256]{};
+
+	const int64_t dueTime = GetSaveDueTime();
+
+	if (dueTime == SaveScheduler::NotScheduled)
+	{
+		text = "Next auto-save: the timer is stopped.\n";
+	}
+	else if (dueTime <= now)
+	{
+		const uint32_t blockers = controller.GetReadiness().GetBlockers();
+
+		text = "Next auto-save: due now";
+
+		if (blockers != 0)
+		{
+			text.append(", waiting for: ");
+			text.append(SaveReadiness::GetBlockerNames(blockers));
+		}
+
+		text.append(".\n");
+	}
+	else
+	{
+		const int64_t seconds = (dueTime - now + 999) / 1000;
+
+		std::snprintf(buffer, sizeof(buffer), "Next auto-save: in %lld min %lld s.\n", seconds / 60, seconds % 60);
+		text.append(buffer);
+	}
+
+	std::snprintf(
+		buffer,
+		sizeof(buffer),
+		"Save interval: %lld minute(s).\n",
+		controller.GetScheduler().GetIntervalInMilliseconds() / MillisecondsPerMinute);
+	text.append(buffer);
+
+	const std::span<const SaveMetricsRecord> records = saveMetrics.GetRecords();
+	const size_t sessionCount = std::min(saveMetrics.GetSessionRecordCount(), records.size());
+
+	if (sessionCount == 0)
+	{
+		text.append("No auto-saves have been recorded for this city in this session.");
+
+		if (!recordSaveMetrics)
+		{
+			text.append(" RecordSaveMetrics is disabled.");
+		}
+
+		return text;
+	}
+
+	const SaveMetricsRecord& last = records.back();
+	uint64_t sessionBytes = 0;
+
+	for (const SaveMetricsRecord& record : records.last(sessionCount))
+	{
+		sessionBytes += record.fileSize;
+	}
+
+	constexpr double BytesPerMB = 1024.0 * 1024.0;
+
+	std::snprintf(
+		buffer,
+		sizeof(buffer),
+		"Last save: %.1f s, %.1f MB.\nThis session: %zu save(s), %.1f MB written.\n\n",
+		static_cast<double>(last.saveMilliseconds) / 1000.0,
+		static_cast<double>(last.fileSize) / BytesPerMB,
+		sessionCount,
+		static_cast<double>(sessionBytes) / BytesPerMB);
+	text.append(buffer);
+	text.append(saveMetrics.GetSummary());
+
+	return text;
+}
+
+void cGZAutoSaveService::SetPausedByCommand(bool value, int64_t now)
+{
+	const uint32_t previousBlockers = controller.GetReadiness().GetBlockers();
+
+	controller.GetReadiness().SetBlocked(SaveBlocker::PausedByCommand, value, now);
+	LogSaveBlockersChanged(previousBlockers);
+
+	Logger::GetInstance().WriteLine(
+		LogLevel::Info,
+		value ? "The auto-saves were paused by the AutoSave pause command." : "The auto-saves were resumed by the AutoSave resume command.");
+
+	UpdateSchedule();
+}
+
+void cGZAutoSaveService::CancelFocusLossTimer()
+{
+	if (focusLossTimerID != 0)
+	{
+		KillTimer(nullptr, focusLossTimerID);
+		focusLossTimerID = 0;
+	}
+}
+
+void cGZAutoSaveService::SaveAfterFocusLoss()
+{
+	if (controller.HasFocus() || !controller.IsRunning() || controller.IsGamePaused())
+	{
+		return;
+	}
+
+	const int64_t now = static_cast<int64_t>(GetTickCount64());
+	SaveReadiness& readiness = controller.GetReadiness();
+
+	// The only blocker that is ignored is the game being in the background.
+	const uint32_t previousBlockers = readiness.GetBlockers();
+
+	UpdateLowDiskSpace(now);
+	readiness.SetPolledBlockers(PollSaveBlockers(), now);
+	LogSaveBlockersChanged(previousBlockers);
+
+	if ((readiness.GetBlockers() & ~static_cast<uint32_t>(SaveBlocker::AppInBackground)) != 0)
+	{
+		return;
+	}
+
+	cISC4City* pCity = pSC4App->GetCity();
+
+	if (skipUnchangedSaves && !HasCityChanged(pCity))
+	{
+		return;
+	}
+
+	if (logSaveEvents)
+	{
+		Logger::GetInstance().WriteLine(LogLevel::Info, "Saving the city while the game is in the background.");
+	}
+
+	// A full save renders the region thumbnail, that is not done while the game is in the background.
+	SaveCity(pCity, true, 0, now);
+
+	const int64_t saveCompletedTime = static_cast<int64_t>(GetTickCount64());
+
+	// The save replaces the next interval save.
+	controller.SaveCompleted(saveCompletedTime);
+	triggers.SaveCompleted(saveCompletedTime);
+	UpdateSchedule();
+}
+
+void CALLBACK cGZAutoSaveService::FocusLossTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time)
+{
+	// The focus loss save is a one-shot timer.
+	KillTimer(nullptr, timerID);
+
+	cGZAutoSaveService* pService = pTimerService;
+
+	if (pService && pService->focusLossTimerID == timerID)
+	{
+		pService->focusLossTimerID = 0;
+		pService->SaveAfterFocusLoss();
+	}
+}
+
+void CALLBACK cGZAutoSaveService::MemoryTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time)
+{
+	cGZAutoSaveService* pService = pTimerService;
+
+	if (pService && pService->memoryTimerID == timerID)
+	{
+		pService->CheckMemoryUsage();
+	}
+	else
+	{
+		KillTimer(nullptr, timerID);
+	}
+}
+
+void cGZAutoSaveService::WriteSaveMetricsSummary()
+{
+	if (saveMetrics.GetSessionRecordCount() > 0)
+	{
+		const std::string summary = saveMetrics.GetSummary();
+		const std::string cityName = saveMetrics.GetFilePath().parent_path().filename().string();
+
+		Logger::GetInstance().WriteLineFormatted(
+			LogLevel::Info,
+			"Save metrics for %s:\n%s",
+			cityName.c_str(),
+			summary.c_str());
+	}
+
+	saveMetrics.Reset();
+}
+
+void cGZAutoSaveService::AddToOnIdle()
+{
+	if (!addedToOnIdle)
+	{
+		addedToOnIdle = pFramework->AddToOnIdle(this);
+	}
+}
+
+void cGZAutoSaveService::RemoveFromOnIdle()
+{
+	if (addedToOnIdle)
+	{
+		pFramework->RemoveFromOnIdle(this);
+		addedToOnIdle = false;
+	}
+}
+
+void cGZAutoSaveService::UpdateSchedule()
+{
+	CancelScheduleTimer();
+
+	const int64_t now = static_cast<int64_t>(GetTickCount64());
+	const int64_t dueTime = GetSaveDueTime();
+	const int64_t timeUntilDue = dueTime == SaveScheduler::NotScheduled ? dueTime : std::max<int64_t>(dueTime - now, 0);
+
+	if (timeUntilDue == 0)
+	{
+		// The save may have become due while the schedule was suspended, the
+		// deferral time is counted from the time it became due.
+		BeginSaveDue();
+	}
+
+	if (!controller.IsRunning() || !controller.HasFocus() || controller.IsGamePaused() || !pFramework)
+	{
+		RemoveFromOnIdle();
+		return;
+	}
+
+	if (timeUntilDue == 0)
+	{
+		// The OnIdle callback is only used while a save is due, it keeps
+		// trying until the game is in a state that allows the city to be saved.
+		AddToOnIdle();
+	}
+	else
+	{
+		RemoveFromOnIdle();
+
+		const UINT timeout = static_cast<UINT>(std::min<int64_t>(timeUntilDue, USER_TIMER_MAXIMUM));
+
+		scheduleTimerID = SetTimer(nullptr, 0, timeout, &ScheduleTimerProc);
+
+		if (scheduleTimerID == 0)
+		{
+			// Fall back to checking the schedule from the OnIdle callback.
+			Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to create the auto-save timer.");
+			AddToOnIdle();
+		}
+	}
+}
+
+void cGZAutoSaveService::CancelScheduleTimer()
+{
+	if (scheduleTimerID != 0)
+	{
+		KillTimer(nullptr, scheduleTimerID);
+		scheduleTimerID = 0;
+	}
+}
+
+void CALLBACK cGZAutoSaveService::ScheduleTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time)
+{
+	cGZAutoSaveService* pService = pTimerService;
+
+	if (pService && pService->scheduleTimerID == timerID)
+	{
+		// The timer callback runs on the game's main thread from its message loop.
+		pService->UpdateSchedule();
+	}
+	else
+	{
+		KillTimer(nullptr, timerID);
+	}
+}
+
+uint32_t cGZAutoSaveService::PollSaveBlockers() const
+{
+	uint32_t blockers = 0;
+
+	if (pWinMgr && pWinMgr->IsModal())
+	{
+		blockers |= static_cast<uint32_t>(SaveBlocker::ModalDialog);
+	}
+
+	cISC4City* pCity = pSC4App ? pSC4App->GetCity() : nullptr;
+
+	if (pCity)
+	{
+		if (lowDiskSpace)
+		{
+			blockers |= static_cast<uint32_t>(SaveBlocker::LowDiskSpace);
+		}
+
+		if (pCity->IsSaveDisabled())
+		{
+			blockers |= static_cast<uint32_t>(SaveBlocker::SaveDisabled);
+		}
+		else
+		{
+			// The pause notifications should have already removed the service from
+			// the OnIdle callback, this catches any pause that was not reported.
+			// The GamePaused blocker is owned by the notifications, a poll that set
+			// it would be masked out by SetPolledBlockers.
+			cISC4Simulator* pSimulator = pCity->GetSimulator();
+
+			if (!pSimulator || pSimulator->IsAnyPaused())
+			{
+				blockers |= static_cast<uint32_t>(SaveBlocker::SimulatorPaused);
+			}
+		}
+	}
+	else
+	{
+		blockers |= static_cast<uint32_t>(SaveBlocker::NoCity);
+	}
+
+	return blockers;
+}
+
+void cGZAutoSaveService::LogSaveBlockersChanged(uint32_t previousBlockers) const
+{
+	const SaveReadiness& readiness = controller.GetReadiness();
+	const uint32_t blockers = readiness.GetBlockers();
+
+	if (blockers != previousBlockers)
+	{
+		MessageTrace::GetInstance().Record(TraceRecordType::BlockersChanged, 0, blockers);
+	}
+
+	if (logSaveEvents && readiness.IsDue() && blockers != 0 && blockers != previousBlockers)
+	{
+		Logger::GetInstance().WriteLineFormatted(
+			LogLevel::Info,
+			"The auto-save is waiting: %s.",
+			SaveReadiness::GetBlockerNames(blockers).c_str());
+	}
+}
+
+bool cGZAutoSaveService::UseFastSave(int64_t now) const
+{
+	if (!fastSave)
+	{
+		return false;
+	}
+
+	// The fast saves skip the region thumbnail render, every full save interval
+	// a full save is made instead so that the region view is kept up to date.
+	const int64_t fullSaveInterval = static_cast<int64_t>(fullSaveIntervalInMinutes) * 60 * 1000;
+
+	return fullSaveInterval <= 0 || (now - lastFullSaveTime) < fullSaveInterval;
+}
+
+void cGZAutoSaveService::SaveCityOnClose()
+{
+	cISC4City* pCity = pSC4App->GetCity();
+
+	UpdateLowDiskSpace(static_cast<int64_t>(GetTickCount64()));
+
+	// The save is skipped if the game has disabled saving for the city.
+	const uint32_t blockers = PollSaveBlockers()
+		& (static_cast<uint32_t>(SaveBlocker::SaveDisabled)
+			| static_cast<uint32_t>(SaveBlocker::NoCity)
+			| static_cast<uint32_t>(SaveBlocker::LowDiskSpace));
+
+	if (!pCity || blockers != 0)
+	{
+		return;
+	}
+
+	if (logSaveEvents)
+	{
+		Logger::GetInstance().WriteLine(
+			LogLevel::Info,
+			"Making a full save before the city is closed, only fast saves were made since the last full save.");
+	}
+
+	SaveCity(pCity, false, 0, static_cast<int64_t>(GetTickCount64()));
+}
+
+void cGZAutoSaveService::ResetCityChanges(cISC4City* pCity)
+{
+	cISC4Simulator* pSimulator = pCity ? pCity->GetSimulator() : nullptr;
+
+	if (pSimulator)
+	{
+		changeTracker.Reset(pSimulator->GetSimDateNumber(), pSimulator->GetSimTime());
+	}
+	else
+	{
+		changeTracker.MarkChanged();
+	}
+
+	cIGZDate* pDate = pSimulator ? pSimulator->GetSimDate() : nullptr;
+
+	if (pDate)
+	{
+		monthAtLastSave = GetMonthNumber(pDate);
+	}
+
+	cISC4BudgetSimulator* pBudgetSimulator = pCity ? pCity->GetBudgetSimulator() : nullptr;
+
+	if (pBudgetSimulator)
+	{
+		fundsAtLastSave = pBudgetSimulator->GetTotalFunds();
+	}
+}
+
+bool cGZAutoSaveService::HasCityChanged(cISC4City* pCity)
+{
+	cISC4Simulator* pSimulator = pCity ? pCity->GetSimulator() : nullptr;
+
+	if (pSimulator)
+	{
+		changeTracker.Update(pSimulator->GetSimDateNumber(), pSimulator->GetSimTime());
+	}
+
+	return changeTracker.IsChanged();
+}
+
+void cGZAutoSaveService::SkipUnchangedSave(cISC4City* pCity, int64_t now)
+{
+	MessageTrace::GetInstance().Record(TraceRecordType::SaveSkipped, 0, 0);
+
+	EventLog& eventLog = EventLog::GetInstance();
+
+	if (eventLog.IsEnabled())
+	{
+		EventRecord record;
+		record.event = "skip";
+		record.city = GetCityName(pCity);
+		record.simDate = GetSimDateString(pCity);
+		record.deferredMilliseconds = controller.GetReadiness().GetDeferredMilliseconds(now);
+		record.detail = "The city has not changed since it was last saved.";
+
+		eventLog.Write(record);
+	}
+
+	if (logSaveEvents)
+	{
+		Logger::GetInstance().WriteLine(
+			LogLevel::Info,
+			"Skipped the auto-save, the city has not changed since it was last saved.");
+	}
+
+	controller.SaveCompleted(now);
+	triggers.SaveCompleted(now);
+	UpdateSchedule();
+}
+
+std::filesystem::path cGZAutoSaveService::GetCityBackupFolder(const std::filesystem::path& cityFilePath) const
+{
+	// The backups are grouped by region and city file name, they cannot be
+	// stored in the region folder because the game would try to load them
+	// as part of the region.
+	std::filesystem::path folder = backupRootFolder;
+	folder /= cityFilePath.parent_path().filename();
+	folder /= cityFilePath.stem();
+
+	return folder;
+}
+
+bool cGZAutoSaveService::SaveCityToNextSlot(cISC4City* pCity, bool useFastSave, std::filesystem::path& savedFilePath)
+{
+	Logger& logger = Logger::GetInstance();
+
+	cRZBaseString cityFilePath;
+
+	if (!pCity->GetCitySaveFilePath(cityFilePath) || cityFilePath.Strlen() == 0)
+	{
+		logger.WriteLine(LogLevel::Error, "Failed to get the city save file path.");
+		return false;
+	}
+
+	if (backupRootFolder.empty())
+	{
+		logger.WriteLine(LogLevel::Error, "The auto-save backup folder is not set.");
+		return false;
+	}
+
+	const std::filesystem::path folder = GetCityBackupFolder(std::filesystem::path(cityFilePath.ToChar()));
+
+	if (saveSlotRing.GetFolder() != folder)
+	{
+		if (!CreateFolder(folder))
+		{
+			return false;
+		}
+
+		saveSlotRing.Load(folder, saveSlotCount);
+	}
+
+	const int slotNumber = saveSlotRing.GetNextSlotNumber();
+	const std::string fileName = GetSlotFileName(pCity, slotNumber);
+	const std::filesystem::path slotPath = saveSlotRing.GetNextSlotPath(fileName);
+	const cRZBaseString slotPathString(slotPath.string());
+
+	bool result = pSC4App->SaveCity(slotPathString, useFastSave);
+
+	// Saving to a different file may change the path that the game uses
+	// for the city, we restore it so that the user's manual saves continue
+	// to go to the original file.
+	cRZBaseString currentCityFilePath;
+
+	if (pCity->GetCitySaveFilePath(currentCityFilePath)
+		&& !currentCityFilePath.IsEqual(cityFilePath, false))
+	{
+		pCity->SetCitySaveFilePath(cityFilePath);
+	}
+
+	if (result)
+	{
+		saveSlotRing.CommitNextSlot(fileName);
+		savedFilePath = slotPath;
+
+		if (logSaveEvents)
+		{
+			logger.WriteLineFormatted(LogLevel::Info, "Saved auto-save slot %d: %s", slotNumber, fileName.c_str());
+		}
+	}
+
+	return result;
+}
+
+bool cGZAutoSaveService::SaveCity(cISC4City* pCity, bool useFastSave, int64_t deferredMilliseconds, int64_t now)
+{
+	const char* status = nullptr;
+#ifdef _DEBUG
+	PrintLineToDebugOutputFormatted("Saving city, FastSave=%s", useFastSave ? "true" : "false");
+#endif // _DEBUG
+	std::filesystem::path savedFilePath;
+	bool saved = false;
+
+	Stopwatch saveStopwatch;
+	saveStopwatch.Start();
+
+	if (saveSlotCount > 0)
+	{
+		saved = SaveCityToNextSlot(pCity, useFastSave, savedFilePath);
+	}
+	else
+	{
+		saved = pSC4App->SaveCity(useFastSave);
+
+		if (saved)
+		{
+			savedFilePath = GetCitySaveFilePath(pCity);
+		}
+	}
+
+	const int64_t saveMilliseconds = saveStopwatch.ElapsedMilliseconds();
+
+	MessageTrace::GetInstance().Record(
+		TraceRecordType::SaveCompleted,
+		saved ? 1 : 0,
+		static_cast<uint32_t>(std::clamp<int64_t>(saveMilliseconds, 0, UINT32_MAX)));
+
+	if (saved)
+	{
+		status = "City saved.";
+
+		ResetCityChanges(pCity);
+		lastSaveTime = now;
+
+		if (useFastSave)
+		{
+			fastSavedSinceFullSave = true;
+		}
+		else
+		{
+			lastFullSaveTime = now;
+			fastSavedSinceFullSave = false;
+		}
+
+		if (recordSaveMetrics)
+		{
+			RecordSaveMetrics(pCity, savedFilePath, useFastSave, saveMilliseconds, deferredMilliseconds);
+		}
+
+		if (useAdaptiveInterval)
+		{
+			UpdateAdaptiveInterval(saveMilliseconds, now);
+		}
+
+		std::shared_ptr<BackupVerificationStatus> verificationStatus;
+
+		if (catalogBackups)
+		{
+			verificationStatus = std::make_shared<BackupVerificationStatus>(BackupVerificationStatus::NotVerified);
+		}
+
+		// A save slot is not written again until the ring wraps around, the city's file in
+		// the region folder or a single slot can be saved over while the tasks are reading it.
+		const bool readsSavedFile = verifySaves || deduplicateBackups || catalogBackups;
+		std::filesystem::path sourceFilePath = savedFilePath;
+
+		if (readsSavedFile && saveSlotCount < 2)
+		{
+			sourceFilePath = QueueSaveSnapshot(savedFilePath);
+		}
+
+		if (!sourceFilePath.empty())
+		{
+			if (verifySaves)
+			{
+				QueueSaveVerification(pCity, savedFilePath, sourceFilePath, verificationStatus);
+			}
+
+			if (deduplicateBackups)
+			{
+				QueueDeduplicatedBackup(pCity, savedFilePath, sourceFilePath);
+			}
+
+			if (catalogBackups)
+			{
+				QueueCatalogRecord(pCity, savedFilePath, sourceFilePath, useFastSave, verificationStatus);
+			}
+
+			if (sourceFilePath != savedFilePath)
+			{
+				QueueSnapshotRemoval(sourceFilePath);
+			}
+		}
+
+		if (compressBackups)
+		{
+			QueueCompressedBackup(pCity, savedFilePath);
+		}
+	}
+	else
+	{
+		status = "The games's SaveCity command failed.";
+	}
+
+#ifdef _DEBUG
+	PrintLineToDebugOutput(status);
+#endif // _DEBUG
+
+	EventLog& eventLog = EventLog::GetInstance();
+
+	if (eventLog.IsEnabled())
+	{
+		EventRecord record;
+		record.event = "save";
+		record.city = GetCityName(pCity);
+		record.simDate = GetSimDateString(pCity);
+		record.durationMilliseconds = saveMilliseconds;
+		record.deferredMilliseconds = deferredMilliseconds;
+		record.result = saved ? "ok" : "failed";
+
+		if (saved)
+		{
+			std::error_code ec;
+			const uintmax_t fileSize = std::filesystem::file_size(savedFilePath, ec);
+
+			if (!ec)
+			{
+				record.bytes = static_cast<int64_t>(fileSize);
+			}
+
+			record.detail = savedFilePath.filename().string();
+		}
+
+		eventLog.Write(record);
+	}
+
+	if (logSaveEvents)
+	{
+		Logger& logger = Logger::GetInstance();
+
+		logger.WriteLine(LogLevel::Info, status);
+
+		if (deferredMilliseconds > 0)
+		{
+			logger.WriteLineFormatted(
+				LogLevel::Info,
+				"The auto-save was deferred for %lld seconds: %s.",
+				(deferredMilliseconds + 500) / 1000,
+				controller.GetReadiness().GetDeferralSummary(now).c_str());
+		}
+	}
+
+	return saved;
+}
+
+void cGZAutoSaveService::QueueCompressedBackup(cISC4City* pCity, const std::filesystem::path& savedFilePath)
+{
+	const std::filesystem::path cityFilePath = GetCitySaveFilePath(pCity);
+
+	if (savedFilePath.empty() || cityFilePath.empty() || backupRootFolder.empty())
+	{
+		return;
+	}
+
+	const std::filesystem::path folder = GetCityBackupFolder(cityFilePath);
+
+	if (CreateFolder(folder))
+	{
+		std::filesystem::path destination = folder;
+		destination /= cityFilePath.stem();
+		destination += " ";
+		destination += GetFileNameTimeStamp();
+		destination += ".sc4.gz";
+
+		// The pruning is queued after the compressed file has been closed, so
+		// that it never reads the size of a partially written backup.
+		compressionPipeline.QueueFile(
+			savedFilePath,
+			destination,
+			[this, pruningTask = CreateBackupPruningTask(destination, GetCityName(pCity))]() mutable
+			{
+				backgroundTasks.QueueTask(std::move(pruningTask));
+			});
+	}
+}
+
+BackgroundTaskQueue::Task cGZAutoSaveService::CreateBackupPruningTask(
+	const std::filesystem::path& backupFilePath,
+	const std::string& cityName)
+{
+	const std::filesystem::path rootFolder = backupRootFolder;
+	const bool pruneGenerations = pruneCompressedBackups;
+	const uint64_t cityQuota = cityBackupQuota;
+	const uint64_t totalQuota = totalBackupQuota;
+	const int64_t backupTime = BackupRetention::GetFileSystemTime();
+
+	return [this, rootFolder, backupFilePath, cityName, pruneGenerations, cityQuota, totalQuota, backupTime](std::stop_token stopToken)
+		{
+			backupRetention.SetPolicy(pruneGenerations, cityQuota, totalQuota);
+
+			if (!backupRetention.IsEnabled())
+			{
+				// The backups that are made while the retention is disabled are not
+				// indexed, the backup folder is listed again when it is enabled.
+				backupRetention.Reset();
+				return;
+			}
+
+			Stopwatch stopwatch;
+			stopwatch.Start();
+
+			backupRetention.Load(rootFolder);
+			backupRetention.AddBackup(backupFilePath, backupTime);
+
+			const BackupPruneResult result = backupRetention.Prune(BackupRetention::GetFileSystemTime(), stopToken);
+
+			if (stopToken.stop_requested() || (result.deletedCount == 0 && result.failedCount == 0))
+			{
+				return;
+			}
+
+			Logger& logger = Logger::GetInstance();
+
+			logger.WriteLineFormatted(
+				LogLevel::Info,
+				"Deleted %zu old compressed backup(s), %llu MB. The compressed backups use %llu MB.",
+				result.deletedCount,
+				static_cast<unsigned long long>(result.deletedBytes / (1024 * 1024)),
+				static_cast<unsigned long long>(result.totalBytes / (1024 * 1024)));
+
+			if (result.failedCount > 0)
+			{
+				logger.WriteLineFormatted(
+					LogLevel::Error,
+					"Failed to delete %zu old compressed backup(s).",
+					result.failedCount);
+			}
+
+			EventRecord record;
+			record.event = "prune";
+			record.city = cityName;
+			record.durationMilliseconds = stopwatch.ElapsedMilliseconds();
+			record.bytes = static_cast<int64_t>(result.deletedBytes);
+			record.result = result.failedCount == 0 ? "ok" : "failed";
+			record.detail = std::to_string(result.deletedCount) + " deleted";
+
+			EventLog::GetInstance().Write(record);
+		};
+}
+
+std::filesystem::path cGZAutoSaveService::GetSaveTargetFolder(cISC4City* pCity) const
+{
+	// The save slots are written to the backup folder, otherwise
+	// the game overwrites the city's file in the region folder.
+	if (saveSlotCount > 0)
+	{
+		return backupRootFolder;
+	}
+
+	return GetCitySaveFilePath(pCity).parent_path();
+}
+
+std::filesystem::path cGZAutoSaveService::QueueSaveSnapshot(const std::filesystem::path& savedFilePath)
+{
+	if (savedFilePath.empty() || backupRootFolder.empty())
+	{
+		return std::filesystem::path();
+	}
+
+	const std::filesystem::path folder = backupRootFolder / SnapshotFolderName;
+
+	if (!CreateFolder(folder))
+	{
+		return std::filesystem::path();
+	}
+
+	std::filesystem::path snapshotFilePath = folder;
+	snapshotFilePath /= savedFilePath.stem();
+	snapshotFilePath += " ";
+	snapshotFilePath += GetFileNameTimeStamp();
+	snapshotFilePath += savedFilePath.extension();
+
+	// The city file can be hundreds of MB, it is copied on the background task thread
+	// before the tasks that read the snapshot run.
+	backgroundTasks.QueueTask(
+		[savedFilePath, snapshotFilePath](std::stop_token stopToken)
+		{
+			if (!CopySaveSnapshot(savedFilePath, snapshotFilePath))
+			{
+				std::error_code ec;
+				std::filesystem::remove(snapshotFilePath, ec);
+
+				if (!stopToken.stop_requested())
+				{
+					Logger::GetInstance().WriteLineFormatted(
+						LogLevel::Error,
+						"Failed to copy %s for the background tasks, it may have been saved over while it was copied.",
+						savedFilePath.filename().string().c_str());
+				}
+			}
+		});
+
+	return snapshotFilePath;
+}
+
+void cGZAutoSaveService::QueueSnapshotRemoval(const std::filesystem::path& snapshotFilePath)
+{
+	// The tasks run in the order that they were queued.
+	backgroundTasks.QueueTask(
+		[snapshotFilePath](std::stop_token)
+		{
+			std::error_code ec;
+			std::filesystem::remove(snapshotFilePath, ec);
+		});
+}
+
+void cGZAutoSaveService::QueueDeduplicatedBackup(
+	cISC4City* pCity,
+	const std::filesystem::path& savedFilePath,
+	const std::filesystem::path& sourceFilePath)
+{
+	const std::filesystem::path cityFilePath = GetCitySaveFilePath(pCity);
+
+	if (savedFilePath.empty() || cityFilePath.empty() || backupRootFolder.empty())
+	{
+		return;
+	}
+
+	std::filesystem::path storeFolder = GetCityBackupFolder(cityFilePath);
+	storeFolder /= "Store";
+
+	std::string generationName = GetFileNameTimeStamp();
+	const size_t maxGenerations = deduplicatedGenerationCount;
+	std::string cityName = GetCityName(pCity);
+
+	backgroundTasks.QueueTask(
+		[this, storeFolder, sourceFilePath, generationName, maxGenerations, cityName](std::stop_token stopToken)
+		{
+			if (!SourceFileExists(sourceFilePath))
+			{
+				return;
+			}
+
+			Stopwatch stopwatch;
+			stopwatch.Start();
+
+			const bool result = deduplicatingStore.AddGeneration(storeFolder, sourceFilePath, generationName, stopToken);
+
+			if (result)
+			{
+				deduplicatingStore.CollectGarbage(maxGenerations);
+			}
+
+			if (!stopToken.stop_requested())
+			{
+				EventRecord record;
+				record.event = "deduplicate";
+				record.city = cityName;
+				record.durationMilliseconds = stopwatch.ElapsedMilliseconds();
+				record.result = result ? "ok" : "failed";
+				record.detail = generationName;
+
+				EventLog::GetInstance().Write(record);
+			}
+		});
+}
+
+void cGZAutoSaveService::QueueCatalogRecord(
+	cISC4City* pCity,
+	const std::filesystem::path& savedFilePath,
+	const std::filesystem::path& sourceFilePath,
+	bool useFastSave,
+	std::shared_ptr<BackupVerificationStatus> verificationStatus)
+{
+	if (savedFilePath.empty() || backupRootFolder.empty() || !CreateFolder(backupRootFolder))
+	{
+		return;
+	}
+
+	// The city values are read on the main thread, the record is completed by the background task.
+	BackupCatalogRecord record{};
+	record.time = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	record.citySerialNumber = pCity->GetCitySerialNumber();
+	record.flags = useFastSave ? BackupCatalog::FastSaveFlag : 0;
+
+	cISC4RegionalCity* pRegionalCity = pSC4App->GetRegionalCity();
+
+	if (pRegionalCity)
+	{
+		record.population = pRegionalCity->GetPopulation();
+	}
+
+	const std::string cityName = GetCityName(pCity);
+
+	BackupCatalog::SetText(record.cityName, cityName);
+	BackupCatalog::SetText(record.regionName, GetCitySaveFilePath(pCity).parent_path().filename().string());
+	BackupCatalog::SetText(record.simDate, GetSimDateString(pCity));
+	BackupCatalog::SetText(record.fileName, savedFilePath.filename().string());
+
+	const std::filesystem::path catalogFolder = backupRootFolder;
+
+	backgroundTasks.QueueTask(
+		[catalogFolder, savedFilePath, sourceFilePath, record, cityName, verificationStatus](std::stop_token stopToken) mutable
+		{
+			if (!SourceFileExists(sourceFilePath))
+			{
+				return;
+			}
+
+			Stopwatch stopwatch;
+			stopwatch.Start();
+
+			std::error_code ec;
+			const uintmax_t fileSize = std::filesystem::file_size(sourceFilePath, ec);
+
+			if (ec || !ComputeFileHash(sourceFilePath, record.contentHash, stopToken))
+			{
+				if (!stopToken.stop_requested())
+				{
+					Logger::GetInstance().WriteLineFormatted(
+						LogLevel::Error,
+						"Failed to read %s for the backup catalog.",
+						savedFilePath.filename().string().c_str());
+				}
+				return;
+			}
+
+			record.fileSize = fileSize;
+
+			if (verificationStatus)
+			{
+				record.verificationStatus = *verificationStatus;
+			}
+
+			const bool result = BackupCatalog::Append(catalogFolder, record);
+
+			if (!result)
+			{
+				Logger::GetInstance().WriteLine(LogLevel::Error, "Failed to append the auto-save to the backup catalog.");
+			}
+
+			EventRecord eventRecord;
+			eventRecord.event = "catalog";
+			eventRecord.city = cityName;
+			eventRecord.simDate = std::string(BackupCatalog::GetText(record.simDate));
+			eventRecord.durationMilliseconds = stopwatch.ElapsedMilliseconds();
+			eventRecord.bytes = static_cast<int64_t>(fileSize);
+			eventRecord.result = result ? "ok" : "failed";
+			eventRecord.detail = record.contentHash.ToString();
+
+			EventLog::GetInstance().Write(eventRecord);
+		});
+}
+
+std::string cGZAutoSaveService::QueueDeduplicatedRestore()
+{
+	cISC4City* pCity = pSC4App ? pSC4App->GetCity() : nullptr;
+	const std::filesystem::path cityFilePath = pCity ? GetCitySaveFilePath(pCity) : std::filesystem::path();
+
+	if (cityFilePath.empty() || backupRootFolder.empty())
+	{
+		return "There is no city loaded.";
+	}
+
+	const std::filesystem::path folder = GetCityBackupFolder(cityFilePath);
+	const std::filesystem::path storeFolder = folder / "Store";
+
+	std::error_code ec;
+
+	if (!std::filesystem::is_directory(storeFolder, ec))
+	{
+		return "The city does not have any deduplicated backups, see DeduplicateBackups.";
+	}
+
+	std::filesystem::path destinationPrefix = folder;
+	destinationPrefix /= cityFilePath.stem();
+	destinationPrefix += " restored ";
+
+	// The store is only used on the background task thread.
+	backgroundTasks.Start();
+	backgroundTasks.QueueTask(
+		[this, storeFolder, destinationPrefix](std::stop_token stopToken)
+		{
+			Logger& logger = Logger::GetInstance();
+
+			const std::string generationName = deduplicatingStore.GetNewestGeneration(storeFolder);
+
+			if (generationName.empty() || stopToken.stop_requested())
+			{
+				logger.WriteLine(LogLevel::Error, "The deduplicating backup store does not have any generations to restore.");
+				return;
+			}
+
+			std::filesystem::path destination = destinationPrefix;
+			destination += generationName;
+			destination += ".sc4";
+
+			if (deduplicatingStore.RestoreGeneration(storeFolder, generationName, destination))
+			{
+				logger.WriteLineFormatted(LogLevel::Info, "Restored the deduplicated backup to %s.", destination.string().c_str());
+			}
+			else
+			{
+				logger.WriteLineFormatted(LogLevel::Error, "Failed to restore the deduplicated backup %s.", generationName.c_str());
+			}
+		});
+
+	std::string text = "The newest deduplicated backup is being restored to:\n";
+	text.append(folder.string());
+	text.append("\nThe result is written to the log.");
+
+	return text;
+}
+
+void cGZAutoSaveService::QueueSaveVerification(
+	cISC4City* pCity,
+	const std::filesystem::path& savedFilePath,
+	const std::filesystem::path& sourceFilePath,
+	std::shared_ptr<BackupVerificationStatus> verificationStatus)
+{
+	const std::filesystem::path cityFilePath = GetCitySaveFilePath(pCity);
+
+	if (savedFilePath.empty())
+	{
+		return;
+	}
+
+	std::filesystem::path recordFilePath;
+
+	if (!cityFilePath.empty() && !backupRootFolder.empty())
+	{
+		const std::filesystem::path folder = GetCityBackupFolder(cityFilePath);
+
+		if (CreateFolder(folder))
+		{
+			recordFilePath = folder / "Verification.log";
+		}
+	}
+
+	std::string generationName = GetFileNameTimeStamp();
+	const uint32_t threadCount = verificationThreadCount;
+	std::string cityName = GetCityName(pCity);
+	std::string simDate = GetSimDateString(pCity);
+
+	backgroundTasks.QueueTask(
+		[savedFilePath, sourceFilePath, recordFilePath, generationName, threadCount, cityName, simDate, verificationStatus](std::stop_token stopToken)
+		{
+			if (!SourceFileExists(sourceFilePath))
+			{
+				return;
+			}
+
+			const SaveVerifier verifier(threadCount);
+			const SaveVerificationResult result = verifier.Verify(sourceFilePath, stopToken);
+
+			if (stopToken.stop_requested())
+			{
+				return;
+			}
+
+			if (verificationStatus)
+			{
+				*verificationStatus = result.valid ? BackupVerificationStatus::Valid : BackupVerificationStatus::Invalid;
+			}
+
+			Logger& logger = Logger::GetInstance();
+
+			if (result.valid)
+			{
+				logger.WriteLineFormatted(
+					LogLevel::Info,
+					"Verified %s: %zu entries, %zu compressed, %lld ms.",
+					savedFilePath.filename().string().c_str(),
+					result.entryCount,
+					result.compressedEntryCount,
+					result.elapsedMilliseconds);
+			}
+			else
+			{
+				logger.WriteLineFormatted(
+					LogLevel::Error,
+					"The auto-save %s failed verification: %s",
+					savedFilePath.filename().string().c_str(),
+					result.errorMessage.c_str());
+			}
+
+			if (!recordFilePath.empty() && !SaveVerifier::AppendRecord(recordFilePath, generationName, savedFilePath, result))
+			{
+				logger.WriteLine(LogLevel::Error, "Failed to write the save verification record.");
+			}
+
+			EventRecord record;
+			record.event = "verify";
+			record.city = cityName;
+			record.simDate = simDate;
+			record.durationMilliseconds = result.elapsedMilliseconds;
+			record.bytes = static_cast<int64_t>(result.fileSize);
+			record.result = result.valid ? "ok" : "failed";
+			record.detail = result.valid ? savedFilePath.filename().string() : result.errorMessage;
+
+			EventLog::GetInstance().Write(record);
+		});
+}
+
+void cGZAutoSaveService::UpdateAdaptiveInterval(int64_t saveMilliseconds, int64_t now)
+{
+	adaptiveInterval.AddSample(saveMilliseconds);
+
+	const int64_t previousInterval = controller.GetScheduler().GetIntervalInMilliseconds();
+	const int64_t interval = adaptiveInterval.GetIntervalMilliseconds(
+		static_cast<int64_t>(saveIntervalInMinutes) * MillisecondsPerMinute);
+
+	SetSaveInterval(interval, now);
+
+	// Small changes are not logged to avoid filling the log with every save.
+	if (logSaveEvents && std::abs(interval - previousInterval) >= (MillisecondsPerMinute / 2))
+	{
+		Logger::GetInstance().WriteLineFormatted(
+			LogLevel::Info,
+			"The adaptive save interval is %.1f minutes, the estimated save time is %.1f seconds.",
+			static_cast<double>(interval) / static_cast<double>(MillisecondsPerMinute),
+			static_cast<double>(adaptiveInterval.GetEstimatedSaveMilliseconds()) / 1000.0);
+	}
+}
+
+void cGZAutoSaveService::RecordSaveMetrics(
+	cISC4City* pCity,
+	const std::filesystem::path& savedFilePath,
+	bool useFastSave,
+	int64_t saveMilliseconds,
+	int64_t deferredMilliseconds)
+{
+	const std::filesystem::path cityFilePath = GetCitySaveFilePath(pCity);
+
+	if (savedFilePath.empty() || cityFilePath.empty() || backupRootFolder.empty())
+	{
+		return;
+	}
+
+	const std::filesystem::path folder = GetCityBackupFolder(cityFilePath);
+	const std::filesystem::path historyFilePath = folder / "SaveHistory.bin";
+
+	if (saveMetrics.GetFilePath() != historyFilePath)
+	{
+		if (!CreateFolder(folder))
+		{
+			return;
+		}
+
+		// The summary for the previous city is written before its history is replaced.
+		WriteSaveMetricsSummary();
+		saveMetrics.Load(historyFilePath);
+
+		if (useAdaptiveInterval && !adaptiveInterval.HasSamples())
+		{
+			SeedAdaptiveInterval();
+		}
+	}
+
+	std::error_code ec;
+	const uintmax_t fileSize = std::filesystem::file_size(savedFilePath, ec);
+
+	SaveMetricsRecord record{};
+	record.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	record.fileSize = ec ? 0 : static_cast<uint64_t>(fileSize);
+	record.saveMilliseconds = static_cast<uint32_t>(std::clamp<int64_t>(saveMilliseconds, 0, UINT32_MAX));
+	record.deferredMilliseconds = static_cast<uint32_t>(std::clamp<int64_t>(deferredMilliseconds, 0, UINT32_MAX));
+	record.flags = useFastSave ? SaveMetricsRecord::FastSaveFlag : 0;
+
+	saveMetrics.Append(record);
+
+	if (logSaveEvents)
+	{
+		Logger::GetInstance().WriteLineFormatted(
+			LogLevel::Info,
+			"Save metrics: %lld ms, %.1f MB, %.1f MB/s.",
+			saveMilliseconds,
+			static_cast<double>(record.fileSize) / (1024.0 * 1024.0),
+			record.GetThroughput());
+	}
+}
+
+std::string cGZAutoSaveService::GetSlotFileName(cISC4City* pCity, int slotNumber) const
+{
+	std::string fileName = saveSlotNameFormat;
+
+	// Every slot must have a unique name, otherwise two slots could refer to the same file.
+	if (fileName.find("<Slot>") == std::string::npos)
+	{
+		fileName.append(" <Slot>");
+	}
+
+	cRZBaseString cityName;
+
+	if (pCity->GetCityName(cityName))
+	{
+		ReplaceToken(fileName, "<CityName>", std::string(cityName.ToChar()));
+	}
+	else
+	{
+		ReplaceToken(fileName, "<CityName>", "City");
+	}
+
+	if (fileName.find("<SimDate>") != std::string::npos)
+	{
+		ReplaceToken(fileName, "<SimDate>", GetSimDateString(pCity));
+	}
+
+	ReplaceToken(fileName, "<Slot>", std::to_string(slotNumber));
+
+	RemoveInvalidFileNameCharacters(fileName);
+	fileName.append(".sc4");
+
+	return fileName;
+}
+
+bool cGZAutoSaveService::Init()
+{
+	if (!addedSystemService)
+	{
+		addedSystemService = pFramework->AddSystemService(this);
+	}
+
+	return addedSystemService;
+}
+
+bool cGZAutoSaveService::Shutdown()
+{
+	bool result = true;
+
+	if (addedSystemService)
+	{
+		const SaveControllerState previous = controller.GetState();
+
+		controller.StopTimer(static_cast<int64_t>(GetTickCount64()));
+		ControllerStateChanged(previous);
+		pFramework->RemoveSystemService(this);
+		addedSystemService = false;
+	}
+
+	return true;
+}
+
+bool cGZAutoSaveService::OnIdle(uint32_t unknown1)
+{
+	// The service is only in the OnIdle callback while a save is due, unless
+	// the schedule timer could not be created.
+	const int64_t now = static_cast<int64_t>(GetTickCount64());
+	SaveReadiness& readiness = controller.GetReadiness();
+
+	if (GetSaveDueTime() <= now)
+	{
+		BeginSaveDue();
+
+		// The game state is polled at a throttled rate instead of every idle call,
+		// the focus and pause blockers are updated by the notification messages.
+		if (readiness.IsPollDue(now))
+		{
+			const uint32_t previousBlockers = readiness.GetBlockers();
+
+			UpdateLowDiskSpace(now);
+			readiness.SetPolledBlockers(PollSaveBlockers(), now);
+			LogSaveBlockersChanged(previousBlockers);
+		}
+
+		if (readiness.IsReady())
+		{
+			cISC4City* pCity = pSC4App->GetCity();
+
+			if (skipUnchangedSaves && !HasCityChanged(pCity))
+			{
+				SkipUnchangedSave(pCity, now);
+				return true;
+			}
+
+			SaveCity(pCity, UseFastSave(now), readiness.GetDeferredMilliseconds(now), now);
+
+			const int64_t saveCompletedTime = static_cast<int64_t>(GetTickCount64());
 
-			autoSaveTimer.Restart();
+			controller.SaveCompleted(saveCompletedTime);
+			triggers.SaveCompleted(saveCompletedTime);
+			UpdateSchedule();
 		}
 	}
 
@@ -12,13 +12,34 @@
 
 #pragma once
 #include "ServiceBase.h"
+#include "AutoSaveCommand.h"
+#include "AdaptiveSaveInterval.h"
+#include "BackgroundTaskQueue.h"
+#include "BackupCatalog.h"
+#include "BackupRetention.h"
+#include "CityChangeTracker.h"
+#include "CompressionPipeline.h"
+#include "DeduplicatingBackupStore.h"
 #include "Logger.h"
+#include "MemoryMonitor.h"
+#include "SaveSlotRing.h"
+#include "SaveMetricsHistory.h"
+#include "SaveController.h"
+#include "SaveTriggers.h"
 #include "Settings.h"
-#include "Stopwatch.h"
+#include "SettingsWatcher.h"
 #include "cIGZFrameWork.h"
 #include "cIGZWinMgr.h"
 #include "cISC4App.h"
 #include "cRZAutoRefCount.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <Windows.h>
+
+class cIGZMessageTarget2;
+class cISC4City;
 
 class cGZAutoSaveService final : private ServiceBase
 {
@@ -26,23 +47,204 @@ public:
 
 	cGZAutoSaveService();
 
-	bool PostAppInit(cIGZFrameWork* pFramework, const Settings& appSettings);
+	bool PostAppInit(
+		cIGZFrameWork* pFramework,
+		const Settings& appSettings,
+		const std::filesystem::path& settingsFilePath);
 
 	bool PreAppShutdown();
 
-	void StartTimer();
+	// Starts or stops the auto-save timer and updates the focus and pause blockers from a
+	// city, pause or focus message. The data1 value of kSC4MessagePostCityInit is 1 if the
+	// city has been established.
+	void HandleScheduleMessage(uint32_t messageType, uint32_t data1);
+
+	// Selects the save profile for the city and starts tracking its changes,
+	// this is called when a city is loaded.
+	void CityLoaded(cISC4City* pCity);
+
+	// Called when the game sends a message that shows the city was edited.
+	void CityChanged();
+
+	// Checks the event triggers that are evaluated at the start of each month.
+	void SimNewMonth();
+
+	// Registers the AutoSave cheat code, the target receives the cheat messages.
+	void RegisterCommands(cIGZMessageTarget2* pTarget);
+
+	void UnregisterCommands(cIGZMessageTarget2* pTarget);
+
+	// Runs a command from the AutoSave cheat code and returns the text to show to the user.
+	std::string ExecuteCommand(std::string_view cheatString);
+
+	// Writes the save metrics for the current city to the log and discards
+	// the per-city state, this is called when the city is closed.
+	void CityClosed();
+
+private:
+
+	// Applies the settings that can be changed while the game is running.
+	void ApplySettings(const Settings& settings);
+
+	void ApplyUpdatedSettings();
+
+	void SelectCityProfile(cISC4City* pCity);
+
+	// Gets the profile for the current city, or the default profile if it does not have one.
+	const SaveProfile& GetCityProfile() const;
+
+	// Sets the values that can be overridden by a save profile.
+	void ApplyProfile(const SaveProfile& profile);
+
+	static void CALLBACK SettingsTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time);
+
+	// Seeds the adaptive interval's save time estimate from the previous sessions.
+	void SeedAdaptiveInterval();
+
+	// Sets the scheduler interval from the configured or adaptive interval.
+	void UpdateSaveInterval(int64_t now);
+
+	void SetSaveInterval(int64_t interval, int64_t now);
+
+	// Updates the timers and the OnIdle callback after the controller state changed.
+	void ControllerStateChanged(const SaveControllerState& previous);
+
+	// Starts counting the deferral time for a save that is due.
+	void BeginSaveDue();
+
+	// Gets the time that the next interval or triggered save is due,
+	// or SaveScheduler::NotScheduled if the timer is stopped.
+	int64_t GetSaveDueTime() const;
+
+	void TriggerSave(SaveTrigger trigger, int64_t now);
+
+	// Starts the memory check timer while a city is running and a memory threshold is enabled.
+	void UpdateMemoryTimer();
+
+	// Saves the city early if the memory usage has crossed a threshold.
+	void CheckMemoryUsage();
+
+	static void CALLBACK MemoryTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time);
+
+	// Gets the text for the AutoSave stats command.
+	std::string GetStatsText(int64_t now) const;
+
+	// Gets the text for the AutoSave history command.
+	std::string GetHistoryText() const;
 
-	void StopTimer();
+	void SetPausedByCommand(bool value, int64_t now);
+
+	void CancelFocusLossTimer();
+
+	// Saves the city after the game has lost focus, the game is in the background so the stall is not noticed.
+	void SaveAfterFocusLoss();
+
+	static void CALLBACK FocusLossTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time);
 
 	void AddToOnIdle();
 
 	void RemoveFromOnIdle();
 
-	void SetAppHasFocus(bool value);
+	// Arms a one-shot timer for the next due time, or adds the service to
+	// the game's OnIdle callback if a save is already due.
+	void UpdateSchedule();
 
-private:
+	void CancelScheduleTimer();
+
+	static void CALLBACK ScheduleTimerProc(HWND hwnd, UINT message, UINT_PTR timerID, DWORD time);
+
+	// Checks the free space on the save drive when a save becomes due, and then at
+	// most once per minute while it is waiting. The check can block on a slow or
+	// network drive, so it is not part of every poll.
+	void UpdateLowDiskSpace(int64_t now);
+
+	// Reads the game state that does not have a notification message.
+	// This makes several virtual calls into the game, it is only called
+	// at a throttled rate while a save is due.
+	// The low disk space blocker is the result of the last UpdateLowDiskSpace call.
+	uint32_t PollSaveBlockers() const;
+
+	void LogSaveBlockersChanged(uint32_t previousBlockers) const;
+
+	// Sets the city's current simulation date and time as the unchanged state.
+	void ResetCityChanges(cISC4City* pCity);
+
+	// Returns true if the city has changed since it was loaded or last saved.
+	bool HasCityChanged(cISC4City* pCity);
+
+	// Completes a due save without saving the city.
+	void SkipUnchangedSave(cISC4City* pCity, int64_t now);
+
+	std::filesystem::path GetCityBackupFolder(const std::filesystem::path& cityFilePath) const;
+
+	bool SaveCityToNextSlot(cISC4City* pCity, bool useFastSave, std::filesystem::path& savedFilePath);
+
+	// Saves the city and queues the background tasks for the saved file.
+	bool SaveCity(cISC4City* pCity, bool useFastSave, int64_t deferredMilliseconds, int64_t now);
+
+	// Returns false when the next auto-save should be a full save.
+	bool UseFastSave(int64_t now) const;
+
+	// Makes a full save when the city is closed, if only fast saves were made since the last full save.
+	void SaveCityOnClose();
+
+	void QueueCompressedBackup(cISC4City* pCity, const std::filesystem::path& savedFilePath);
+
+	// Creates a task that adds the compressed backup to the retention index and deletes
+	// the backups that are no longer kept, the task runs on the background task thread.
+	BackgroundTaskQueue::Task CreateBackupPruningTask(const std::filesystem::path& backupFilePath, const std::string& cityName);
+
+	// Gets the folder that the next auto-save is written to, the free space is checked on its drive.
+	std::filesystem::path GetSaveTargetFolder(cISC4City* pCity) const;
+
+	// Queues a copy of the saved city file for the background tasks that map it into memory,
+	// the game cannot overwrite a file that is mapped. Returns the path of the copy, or an
+	// empty path if the snapshot folder could not be created.
+	std::filesystem::path QueueSaveSnapshot(const std::filesystem::path& savedFilePath);
+
+	// Deletes the snapshot after the background tasks that were queued before it have completed.
+	void QueueSnapshotRemoval(const std::filesystem::path& snapshotFilePath);
+
+	// The source file is the file that is read, it is a snapshot of the saved file
+	// when the game saves over the city's file in the region folder.
+	void QueueDeduplicatedBackup(
+		cISC4City* pCity,
+		const std::filesystem::path& savedFilePath,
+		const std::filesystem::path& sourceFilePath);
+
+	// Queues the restore of the newest deduplicated backup for the AutoSave restore command,
+	// returns the text to show to the user.
+	std::string QueueDeduplicatedRestore();
+
+	// The verification status is set when the verification has completed, it can be null.
+	void QueueSaveVerification(
+		cISC4City* pCity,
+		const std::filesystem::path& savedFilePath,
+		const std::filesystem::path& sourceFilePath,
+		std::shared_ptr<BackupVerificationStatus> verificationStatus);
+
+	// Appends a record for the saved file to the backup catalog, the record is written
+	// after the save verification task that was queued before it has completed.
+	void QueueCatalogRecord(
+		cISC4City* pCity,
+		const std::filesystem::path& savedFilePath,
+		const std::filesystem::path& sourceFilePath,
+		bool useFastSave,
+		std::shared_ptr<BackupVerificationStatus> verificationStatus);
+
+	void WriteSaveMetricsSummary();
+
+	// Updates the adaptive save interval after a save has completed.
+	void UpdateAdaptiveInterval(int64_t saveMilliseconds, int64_t now);
+
+	void RecordSaveMetrics(
+		cISC4City* pCity,
+		const std::filesystem::path& savedFilePath,
+		bool useFastSave,
+		int64_t saveMilliseconds,
+		int64_t deferredMilliseconds);
 
-	bool CanSaveCity() const;
+	std::string GetSlotFileName(cISC4City* pCity, int slotNumber) const;
 
 	bool Init() override;
 
@@ -52,12 +254,62 @@ private:
 
 	bool addedSystemService;
 	bool addedToOnIdle;
-	bool running;
 	int saveIntervalInMinutes;
 	bool fastSave;
+	bool ignoreTimePaused;
 	bool logSaveEvents;
-	bool appHasFocus;
-	Stopwatch autoSaveTimer;
+	bool saveOnFocusLoss;
+	int64_t focusLossMinimumAge;
+	UINT_PTR focusLossTimerID;
+	int64_t lastSaveTime;
+	int fullSaveIntervalInMinutes;
+	bool fullSaveOnCityClose;
+	int64_t lastFullSaveTime;
+	bool fastSavedSinceFullSave;
+	bool skipUnchangedSaves;
+	CityChangeTracker changeTracker;
+	int simIntervalInMonths;
+	int32_t monthAtLastSave;
+	bool saveOnNewYear;
+	int64_t fundsChangeTriggerAmount;
+	int64_t fundsAtLastSave;
+	SaveTriggers triggers;
+	MemoryMonitor memoryMonitor;
+	UINT_PTR memoryTimerID;
+	int saveSlotCount;
+	std::string saveSlotNameFormat;
+	SaveProfile defaultProfile;
+	SaveProfiles profiles;
+	std::string profileCityName;
+	std::string profileRegionName;
+	std::filesystem::path backupRootFolder;
+	SaveSlotRing saveSlotRing;
+	bool compressBackups;
+	CompressionPipeline compressionPipeline;
+	bool pruneCompressedBackups;
+	uint64_t cityBackupQuota;
+	uint64_t totalBackupQuota;
+	uint64_t minimumFreeDiskSpace;
+	bool lowDiskSpace;
+	int64_t nextDiskSpaceCheckTime;
+	bool deduplicateBackups;
+	size_t deduplicatedGenerationCount;
+	bool catalogBackups;
+	bool verifySaves;
+	uint32_t verificationThreadCount;
+	bool recordSaveMetrics;
+	SaveMetricsHistory saveMetrics;
+	bool useAdaptiveInterval;
+	AdaptiveSaveInterval adaptiveInterval;
+	// The backup store and retention index are only used on the background task
+	// thread, the task queue is declared after them so that the thread is stopped first.
+	DeduplicatingBackupStore deduplicatingStore;
+	BackupRetention backupRetention;
+	BackgroundTaskQueue backgroundTasks;
+	SaveController controller;
+	UINT_PTR scheduleTimerID;
+	SettingsWatcher settingsWatcher;
+	UINT_PTR settingsTimerID;
 	cRZAutoRefCount<cIGZFrameWork> pFramework;
 	cRZAutoRefCount<cISC4App> pSC4App;
 	cRZAutoRefCount<cIGZWinMgr> pWinMgr;